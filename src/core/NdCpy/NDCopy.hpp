@@ -8,23 +8,67 @@
 #define NDCOPY_HPP
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 //#include "NDCopy.h"
 #include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
 #include <vector>
 
+#include "core/NdCpy/NDCopyBlock.hpp"
+#include "core/NdCpy/NDCopyEndian.hpp"
+#include "core/NdCpy/NDCopyFused.hpp"
+#include "core/NdCpy/NDCopySimd.hpp"
+
 using Dims = std::vector<size_t>;
 using Buffer = std::vector<char>;
 
+// NdCopyMemOrder()
+// dims of a buffer listed in its memory order, slowest first. a col-major
+// buffer in memory order is a row-major one, which is how the transports
+// (NDCopyShm.hpp, NDCopyWire.hpp) do their same-major copies.
+inline Dims NdCopyMemOrder(const size_t *dims, size_t numDims,
+                           bool isRowMajor) {
+  typedef std::reverse_iterator<const size_t *> Rev;
+  return isRowMajor ? Dims(dims, dims + numDims)
+                    : Dims(Rev(dims + numDims), Rev(dims));
+}
+
+inline Dims NdCopyMemOrder(const Dims &dims, bool isRowMajor) {
+  return NdCopyMemOrder(dims.data(), dims.size(), isRowMajor);
+}
+
 template <class T>
 int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
            const bool inIsRowMajor, const bool inIsLittleEndian, char *out,
            const Dims &outStart, const Dims &outCount, const bool outIsRowMajor,
            const bool outIsLittleEndian, const Dims &inMemStart = Dims(),
            const Dims &inMemCount = Dims(), const Dims &outMemStart = Dims(),
-           const Dims &outMemCount = Dims(), const bool safeMode = false);
+           const Dims &outMemCount = Dims(), const bool safeMode = false,
+           const NdCopyOptions<T> &options = NdCopyOptions<T>());
 
-//***************Start of NdCopy() and its 8 helpers ***************
+// NdCopy() on whole buffers, e.g. Buffer or HugeBuffer (NDCopyBuffer.hpp),
+// so that any allocator can be passed in directly
+template <class T, class InAlloc, class OutAlloc>
+int NdCopy(const std::vector<char, InAlloc> &in, const Dims &inStart,
+           const Dims &inCount, const bool inIsRowMajor,
+           const bool inIsLittleEndian, std::vector<char, OutAlloc> &out,
+           const Dims &outStart, const Dims &outCount, const bool outIsRowMajor,
+           const bool outIsLittleEndian, const Dims &inMemStart = Dims(),
+           const Dims &inMemCount = Dims(), const Dims &outMemStart = Dims(),
+           const Dims &outMemCount = Dims(), const bool safeMode = false,
+           const NdCopyOptions<T> &options = NdCopyOptions<T>()) {
+  return NdCopy<T>(in.data(), inStart, inCount, inIsRowMajor, inIsLittleEndian,
+                   out.data(), outStart, outCount, outIsRowMajor,
+                   outIsLittleEndian, inMemStart, inMemCount, outMemStart,
+                   outMemCount, safeMode, options);
+}
+
+//***************Start of NdCopy() and its helpers ***************
 // Author:Shawn Yang, shawnyang610@gmail.com
 //
 // NdCopyRecurDFSeqPadding(): helper function
@@ -36,14 +80,17 @@ int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
 // calculation complexity for copying each block is minimized to O(1), which is
 // independent of the number of dimensions.
 static void NdCopyRecurDFSeqPadding(size_t curDim, const char *&inOvlpBase,
-                                    char *&outOvlpBase, Dims &inOvlpGapSize,
-                                    Dims &outOvlpGapSize, Dims &ovlpCount,
-                                    size_t &minContDim, size_t &blockSize) {
+                                    char *&outOvlpBase,
+                                    const Dims &inOvlpGapSize,
+                                    const Dims &outOvlpGapSize,
+                                    const Dims &ovlpCount,
+                                    const size_t &minContDim,
+                                    const size_t &blockSize) {
   // note: all elements in and below this node are contiguous on input and
   // output
   // copy the contiguous data block
   if (curDim == minContDim) {
-    std::memcpy(outOvlpBase, inOvlpBase, blockSize);
+    NdCopyBlock(outOvlpBase, inOvlpBase, blockSize);
     inOvlpBase += blockSize + inOvlpGapSize[curDim];
     outOvlpBase += blockSize + outOvlpGapSize[curDim];
   }
@@ -72,31 +119,30 @@ static void NdCopyRecurDFSeqPadding(size_t curDim, const char *&inOvlpBase,
 // Copys n-dimensional Data from input to output in the row major but in
 // reversed endianess. the memory address calculation complexity for copying
 // each element is minimized to average O(1), which is independent of
-// the number of dimensions.
+// the number of dimensions. elmDesc tells which bytes of an element are
+// swapped (see NDCopyEndian.hpp), so compound elements are converted in
+// the same pass.
 
-static void
-NdCopyRecurDFSeqPaddingRevEndian(size_t curDim, const char *&inOvlpBase,
-                                 char *&outOvlpBase, Dims &inOvlpGapSize,
-                                 Dims &outOvlpGapSize, Dims &ovlpCount,
-                                 size_t minCountDim, size_t blockSize,
-                                 size_t elmSize, size_t numElmsPerBlock) {
+static void NdCopyRecurDFSeqPaddingRevEndian(
+    size_t curDim, const char *&inOvlpBase, char *&outOvlpBase,
+    const Dims &inOvlpGapSize, const Dims &outOvlpGapSize,
+    const Dims &ovlpCount, size_t minCountDim, size_t blockSize, size_t elmSize,
+    size_t numElmsPerBlock, const NdCopyElmDesc &elmDesc) {
   if (curDim == minCountDim) {
-    // each byte of each element in the continuous block needs
-    // to be copied in reverse order
-    for (size_t i = 0; i < numElmsPerBlock; i++) {
-      for (size_t j = 0; j < elmSize; j++) {
-        outOvlpBase[j] = inOvlpBase[elmSize - 1 - j];
-      }
-      inOvlpBase += elmSize;
-      outOvlpBase += elmSize;
-    }
+    // each swap unit of each element in the continuous block needs
+    // to be copied in reverse byte order
+    NdCopyRevEndianElms(outOvlpBase, inOvlpBase, numElmsPerBlock, elmSize,
+                        elmDesc);
+    inOvlpBase += blockSize;
+    outOvlpBase += blockSize;
   }
   // case: curDim<minCountDim
   else {
     for (size_t i = 0; i < ovlpCount[curDim]; i++)
-      NdCopyRecurDFSeqPaddingRevEndian(
-          curDim + 1, inOvlpBase, outOvlpBase, inOvlpGapSize, outOvlpGapSize,
-          ovlpCount, minCountDim, blockSize, elmSize, numElmsPerBlock);
+      NdCopyRecurDFSeqPaddingRevEndian(curDim + 1, inOvlpBase, outOvlpBase,
+                                       inOvlpGapSize, outOvlpGapSize,
+                                       ovlpCount, minCountDim, blockSize,
+                                       elmSize, numElmsPerBlock, elmDesc);
   }
   inOvlpBase += inOvlpGapSize[curDim];
   outOvlpBase += outOvlpGapSize[curDim];
@@ -108,10 +154,12 @@ NdCopyRecurDFSeqPaddingRevEndian(size_t curDim, const char *&inOvlpBase,
 // the memory address calculation complexity for copying each element is
 // minimized to average O(1), which is independent of the number of dimensions.
 static void NdCopyRecurDFNonSeqDynamic(size_t curDim, const char *inBase,
-                                       char *outBase, Dims &inRltvOvlpSPos,
-                                       Dims &outRltvOvlpSPos, Dims &inStride,
-                                       Dims &outStride, Dims &ovlpCount,
-                                       size_t elmSize) {
+                                       char *outBase,
+                                       const Dims &inRltvOvlpSPos,
+                                       const Dims &outRltvOvlpSPos,
+                                       const Dims &inStride,
+                                       const Dims &outStride,
+                                       const Dims &ovlpCount, size_t elmSize) {
   if (curDim == inStride.size()) {
     std::memcpy(outBase, inBase, elmSize);
   } else {
@@ -131,26 +179,26 @@ static void NdCopyRecurDFNonSeqDynamic(size_t curDim, const char *inBase,
 // minimized to average O(1), which is independent of the number of dimensions.
 
 static void NdCopyRecurDFNonSeqDynamicRevEndian(
-    size_t curDim, const char *inBase, char *outBase, Dims &inRltvOvlpSPos,
-    Dims &outRltvOvlpSPos, Dims &inStride, Dims &outStride, Dims &ovlpCount,
-    size_t elmSize) {
+    size_t curDim, const char *inBase, char *outBase,
+    const Dims &inRltvOvlpSPos, const Dims &outRltvOvlpSPos,
+    const Dims &inStride, const Dims &outStride, const Dims &ovlpCount,
+    size_t elmSize, const NdCopyElmDesc &elmDesc) {
   if (curDim == inStride.size()) {
-    for (size_t i = 0; i < elmSize; i++) {
-      outBase[i] = inBase[elmSize - 1 - i];
-    }
+    NdCopyRevEndianElm(outBase, inBase, elmSize, elmDesc);
   } else {
     for (size_t i = 0; i < ovlpCount[curDim]; i++)
       NdCopyRecurDFNonSeqDynamicRevEndian(
           curDim + 1, inBase + (inRltvOvlpSPos[curDim] + i) * inStride[curDim],
           outBase + (outRltvOvlpSPos[curDim] + i) * outStride[curDim],
           inRltvOvlpSPos, outRltvOvlpSPos, inStride, outStride, ovlpCount,
-          elmSize);
+          elmSize, elmDesc);
   }
 }
 
 static void NdCopyIterDFSeqPadding(const char *&inOvlpBase, char *&outOvlpBase,
-                                   Dims &inOvlpGapSize, Dims &outOvlpGapSize,
-                                   Dims &ovlpCount, size_t minContDim,
+                                   const Dims &inOvlpGapSize,
+                                   const Dims &outOvlpGapSize,
+                                   const Dims &ovlpCount, size_t minContDim,
                                    size_t blockSize) {
   Dims pos(ovlpCount.size(), 0);
   size_t curDim = 0;
@@ -159,7 +207,7 @@ static void NdCopyIterDFSeqPadding(const char *&inOvlpBase, char *&outOvlpBase,
       pos[curDim]++;
       curDim++;
     }
-    std::memcpy(outOvlpBase, inOvlpBase, blockSize);
+    NdCopyBlock(outOvlpBase, inOvlpBase, blockSize);
     inOvlpBase += blockSize;
     outOvlpBase += blockSize;
     do {
@@ -174,9 +222,10 @@ static void NdCopyIterDFSeqPadding(const char *&inOvlpBase, char *&outOvlpBase,
 }
 
 static void NdCopyIterDFSeqPaddingRevEndian(
-    const char *&inOvlpBase, char *&outOvlpBase, Dims &inOvlpGapSize,
-    Dims &outOvlpGapSize, Dims &ovlpCount, size_t minContDim, size_t blockSize,
-    size_t elmSize, size_t numElmsPerBlock) {
+    const char *&inOvlpBase, char *&outOvlpBase, const Dims &inOvlpGapSize,
+    const Dims &outOvlpGapSize, const Dims &ovlpCount, size_t minContDim,
+    size_t blockSize, size_t elmSize, size_t numElmsPerBlock,
+    const NdCopyElmDesc &elmDesc) {
   Dims pos(ovlpCount.size(), 0);
   size_t curDim = 0;
   while (true) {
@@ -184,13 +233,10 @@ static void NdCopyIterDFSeqPaddingRevEndian(
       pos[curDim]++;
       curDim++;
     }
-    for (size_t i = 0; i < numElmsPerBlock; i++) {
-      for (size_t j = 0; j < elmSize; j++) {
-        outOvlpBase[j] = inOvlpBase[elmSize - 1 - j];
-      }
-      inOvlpBase += elmSize;
-      outOvlpBase += elmSize;
-    }
+    NdCopyRevEndianElms(outOvlpBase, inOvlpBase, numElmsPerBlock, elmSize,
+                        elmDesc);
+    inOvlpBase += blockSize;
+    outOvlpBase += blockSize;
     do {
       if (curDim == 0)
         return;
@@ -201,10 +247,117 @@ static void NdCopyIterDFSeqPaddingRevEndian(
     } while (pos[curDim] == ovlpCount[curDim]);
   }
 }
+// NdCopySmallBlockRows(): helper function
+// the innermost loop of NdCopyIterDFSeqPaddingSmall(): rows blocks of Bytes
+// bytes, inStep/outStep bytes apart. a fixed size memcpy compiles to a few
+// register moves, and the loop is unrolled by four.
+template <size_t Bytes>
+static inline void NdCopySmallBlockRows(char *out, const char *in,
+                                        size_t rows, size_t outStep,
+                                        size_t inStep) {
+  size_t r = 0;
+  for (; r + 4 <= rows; r += 4) {
+    std::memcpy(out, in, Bytes);
+    std::memcpy(out + outStep, in + inStep, Bytes);
+    std::memcpy(out + 2 * outStep, in + 2 * inStep, Bytes);
+    std::memcpy(out + 3 * outStep, in + 3 * inStep, Bytes);
+    in += 4 * inStep;
+    out += 4 * outStep;
+  }
+  for (; r < rows; r++) {
+    std::memcpy(out, in, Bytes);
+    in += inStep;
+    out += outStep;
+  }
+}
+
+// NdCopyIterDFSeqPaddingSmall(): helper function
+// NdCopyIterDFSeqPadding() for small contiguous blocks (Bytes of 4 to 64),
+// typically a thin slab cut out of the last dimension, where a library
+// memcpy and a traversal step per block would cost more than the copy.
+// the blocks under one index of dimension minContDim - 1 are one strided
+// row, copied by NdCopySmallBlockRows(); only the dimensions above it are
+// walked. minContDim has to be at least 1.
+template <size_t Bytes>
+static void NdCopyIterDFSeqPaddingSmall(const char *inOvlpBase,
+                                        char *outOvlpBase,
+                                        const Dims &inOvlpGapSize,
+                                        const Dims &outOvlpGapSize,
+                                        const Dims &ovlpCount,
+                                        size_t minContDim) {
+  const size_t rowDim = minContDim - 1;
+  const size_t rows = ovlpCount[rowDim];
+  const size_t inStep = Bytes + inOvlpGapSize[minContDim];
+  const size_t outStep = Bytes + outOvlpGapSize[minContDim];
+  Dims pos(rowDim, 0);
+  while (true) {
+    NdCopySmallBlockRows<Bytes>(outOvlpBase, inOvlpBase, rows, outStep,
+                                inStep);
+    inOvlpBase += rows * inStep + inOvlpGapSize[rowDim];
+    outOvlpBase += rows * outStep + outOvlpGapSize[rowDim];
+    // next index of the dimensions above the row
+    size_t d = rowDim;
+    while (true) {
+      if (d == 0)
+        return;
+      d--;
+      if (++pos[d] < ovlpCount[d])
+        break;
+      pos[d] = 0;
+      inOvlpBase += inOvlpGapSize[d];
+      outOvlpBase += outOvlpGapSize[d];
+    }
+  }
+}
+
+// NdCopyIsSmallBlock(): helper function
+// block sizes NdCopyIterDFSeqPaddingSmall() is instantiated for
+static inline bool NdCopyIsSmallBlock(size_t blockSize) {
+  return blockSize == 4 || blockSize == 8 || blockSize == 16 ||
+         blockSize == 32 || blockSize == 64;
+}
+
+// NdCopyIterDFSeqPaddingSmallDispatch(): helper function
+// NdCopyIterDFSeqPaddingSmall() for the block size, through the selected ISA
+// level's build in the library build (NDCopySimd.hpp)
+static void NdCopyIterDFSeqPaddingSmallDispatch(
+    const char *inOvlpBase, char *outOvlpBase, const Dims &inOvlpGapSize,
+    const Dims &outOvlpGapSize, const Dims &ovlpCount, size_t minContDim,
+    size_t blockSize) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  NdCopySimd().seqPaddingSmall(inOvlpBase, outOvlpBase, inOvlpGapSize,
+                               outOvlpGapSize, ovlpCount, minContDim,
+                               blockSize);
+#else
+  switch (blockSize) {
+  case 4:
+    NdCopyIterDFSeqPaddingSmall<4>(inOvlpBase, outOvlpBase, inOvlpGapSize,
+                                   outOvlpGapSize, ovlpCount, minContDim);
+    break;
+  case 8:
+    NdCopyIterDFSeqPaddingSmall<8>(inOvlpBase, outOvlpBase, inOvlpGapSize,
+                                   outOvlpGapSize, ovlpCount, minContDim);
+    break;
+  case 16:
+    NdCopyIterDFSeqPaddingSmall<16>(inOvlpBase, outOvlpBase, inOvlpGapSize,
+                                    outOvlpGapSize, ovlpCount, minContDim);
+    break;
+  case 32:
+    NdCopyIterDFSeqPaddingSmall<32>(inOvlpBase, outOvlpBase, inOvlpGapSize,
+                                    outOvlpGapSize, ovlpCount, minContDim);
+    break;
+  default:
+    NdCopyIterDFSeqPaddingSmall<64>(inOvlpBase, outOvlpBase, inOvlpGapSize,
+                                    outOvlpGapSize, ovlpCount, minContDim);
+  }
+#endif
+}
+
 static void NdCopyIterDFDynamic(const char *inBase, char *outBase,
-                                Dims &inRltvOvlpSPos, Dims &outRltvOvlpSPos,
-                                Dims &inStride, Dims &outStride,
-                                Dims &ovlpCount, size_t elmSize) {
+                                const Dims &inRltvOvlpSPos,
+                                const Dims &outRltvOvlpSPos,
+                                const Dims &inStride, const Dims &outStride,
+                                const Dims &ovlpCount, size_t elmSize) {
   size_t curDim = 0;
   Dims pos(ovlpCount.size() + 1, 0);
   std::vector<const char *> inAddr(ovlpCount.size() + 1);
@@ -233,10 +386,12 @@ static void NdCopyIterDFDynamic(const char *inBase, char *outBase,
 }
 
 static void NdCopyIterDFDynamicRevEndian(const char *inBase, char *outBase,
-                                         Dims &inRltvOvlpSPos,
-                                         Dims &outRltvOvlpSPos, Dims &inStride,
-                                         Dims &outStride, Dims &ovlpCount,
-                                         size_t elmSize) {
+                                         const Dims &inRltvOvlpSPos,
+                                         const Dims &outRltvOvlpSPos,
+                                         const Dims &inStride,
+                                         const Dims &outStride,
+                                         const Dims &ovlpCount, size_t elmSize,
+                                         const NdCopyElmDesc &elmDesc) {
   size_t curDim = 0;
   Dims pos(ovlpCount.size() + 1, 0);
   std::vector<const char *> inAddr(ovlpCount.size() + 1);
@@ -254,27 +409,135 @@ static void NdCopyIterDFDynamicRevEndian(const char *inBase, char *outBase,
       pos[curDim]++;
       curDim++;
     }
-    for (size_t i = 0; i < elmSize; i++) {
-      outAddr[curDim][i] = inAddr[curDim][elmSize - 1 - i];
+    NdCopyRevEndianElm(outAddr[curDim], inAddr[curDim], elmSize, elmDesc);
+    do {
+      if (curDim == 0)
+        return;
+      pos[curDim] = 0;
+      curDim--;
+    } while (pos[curDim] == ovlpCount[curDim]);
+  }
+}
+
+// NdCopyIterDFSeqPaddingOp(): helper function
+// NdCopyIterDFSeqPadding() with every contiguous block handed to blockOp
+// (e.g. NdCopyFusedOp) instead of being copied directly. used when work is
+// fused into the copy pass; iterative, so the stack usage does not depend on
+// the number of dimensions.
+template <class BlockOp>
+static void NdCopyIterDFSeqPaddingOp(const char *&inOvlpBase,
+                                     char *&outOvlpBase,
+                                     const Dims &inOvlpGapSize,
+                                     const Dims &outOvlpGapSize,
+                                     const Dims &ovlpCount, size_t minContDim,
+                                     size_t blockSize,
+                                     BlockOp &blockOp) {
+  Dims pos(ovlpCount.size(), 0);
+  size_t curDim = 0;
+  while (true) {
+    while (curDim != minContDim) {
+      pos[curDim]++;
+      curDim++;
     }
+    blockOp(outOvlpBase, inOvlpBase, blockSize);
+    inOvlpBase += blockSize;
+    outOvlpBase += blockSize;
     do {
       if (curDim == 0)
         return;
+      inOvlpBase += inOvlpGapSize[curDim];
+      outOvlpBase += outOvlpGapSize[curDim];
       pos[curDim] = 0;
       curDim--;
     } while (pos[curDim] == ovlpCount[curDim]);
   }
 }
 
-template <class T>
-int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
-           const bool inIsRowMajor, const bool inIsLittleEndian, char *out,
-           const Dims &outStart, const Dims &outCount, const bool outIsRowMajor,
-           const bool outIsLittleEndian, const Dims &inMemStart,
-           const Dims &inMemCount, const Dims &outMemStart,
-           const Dims &outMemCount, const bool safeMode)
+// NdCopyIterDFDynamicOp(): helper function
+// NdCopyIterDFDynamic() with every element handed to blockOp
+template <class BlockOp>
+static void NdCopyIterDFDynamicOp(const char *inBase, char *outBase,
+                                  const Dims &inRltvOvlpSPos,
+                                  const Dims &outRltvOvlpSPos,
+                                  const Dims &inStride, const Dims &outStride,
+                                  const Dims &ovlpCount, size_t elmSize,
+                                  BlockOp &blockOp) {
+  size_t curDim = 0;
+  Dims pos(ovlpCount.size() + 1, 0);
+  std::vector<const char *> inAddr(ovlpCount.size() + 1);
+  inAddr[0] = inBase;
+  std::vector<char *> outAddr(ovlpCount.size() + 1);
+  outAddr[0] = outBase;
+  while (true) {
+    while (curDim != inStride.size()) {
+      inAddr[curDim + 1] =
+          inAddr[curDim] +
+          (inRltvOvlpSPos[curDim] + pos[curDim]) * inStride[curDim];
+      outAddr[curDim + 1] =
+          outAddr[curDim] +
+          (outRltvOvlpSPos[curDim] + pos[curDim]) * outStride[curDim];
+      pos[curDim]++;
+      curDim++;
+    }
+    blockOp(outAddr[curDim], inAddr[curDim], elmSize);
+    do {
+      if (curDim == 0)
+        return;
+      pos[curDim] = 0;
+      curDim--;
+    } while (pos[curDim] == ovlpCount[curDim]);
+  }
+}
 
-{
+// NdCopyPlan
+// everything NdCopy() derives from the copy geometry alone, independent of
+// the buffers: overlap offsets, gaps, strides, the contiguous block and the
+// kernel to run. built by NdCopyMakePlan() and shared through
+// NdCopyPlanCache, so a recurring geometry is planned only once.
+struct NdCopyPlan {
+  enum Kernel {
+    RecurSeqPadding,
+    IterSeqPadding,
+    RecurSeqPaddingRevEndian,
+    IterSeqPaddingRevEndian,
+    IterSeqPaddingSmall,
+    RecurDynamic,
+    IterDynamic,
+    RecurDynamicRevEndian,
+    IterDynamicRevEndian
+  };
+  bool hasOvlp = false;
+  Kernel kernel = RecurSeqPadding;
+  // size of the whole output buffer, the extent of options.fill
+  size_t outBytes = 0;
+  // seq-padding kernels (row-major ==> row-major): byte offsets of the
+  // overlap in the buffers
+  size_t inOvlpOffset = 0;
+  size_t outOvlpOffset = 0;
+  Dims inOvlpGapSize;
+  Dims outOvlpGapSize;
+  size_t minContDim = 0;
+  size_t blockSize = 0;
+  // dynamic kernels (modes involving col-major)
+  Dims inRltvOvlpStartPos;
+  Dims outRltvOvlpStartPos;
+  Dims inStride;
+  Dims outStride;
+  Dims ovlpCount;
+
+  bool IsSeqPadding() const { return kernel <= IterSeqPaddingSmall; }
+};
+
+// NdCopyMakePlan(): helper function
+// the geometry part of NdCopy(), see there for the arguments
+static void NdCopyMakePlan(NdCopyPlan &plan, const Dims &inStart,
+                           const Dims &inCount, const bool inIsRowMajor,
+                           const bool inIsLittleEndian, const Dims &outStart,
+                           const Dims &outCount, const bool outIsRowMajor,
+                           const bool outIsLittleEndian,
+                           const Dims &inMemStart, const Dims &inMemCount,
+                           const Dims &outMemStart, const Dims &outMemCount,
+                           const bool safeMode, const size_t elmSize) {
   // use values of ioStart and ioCount if ioMemStart and ioMemCount are
   // left as default
   Dims inMemStartNC = inMemStart.empty() ? inStart : inMemStart;
@@ -286,16 +549,14 @@ int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
   Dims outEnd(inStart.size());
   Dims ovlpStart(inStart.size());
   Dims ovlpEnd(inStart.size());
-  Dims ovlpCount(inStart.size());
-  Dims inStride(inStart.size());
-  Dims outStride(inStart.size());
-  Dims inOvlpGapSize(inStart.size());
-  Dims outOvlpGapSize(inStart.size());
-  Dims inRltvOvlpStartPos(inStart.size());
-  Dims outRltvOvlpStartPos(inStart.size());
-  size_t minContDim, blockSize;
-  const char *inOvlpBase = nullptr;
-  char *outOvlpBase = nullptr;
+  Dims &ovlpCount = plan.ovlpCount;
+  Dims &inStride = plan.inStride;
+  Dims &outStride = plan.outStride;
+  Dims &inRltvOvlpStartPos = plan.inRltvOvlpStartPos;
+  Dims &outRltvOvlpStartPos = plan.outRltvOvlpStartPos;
+  ovlpCount.resize(inStart.size());
+  inStride.resize(inStart.size());
+  outStride.resize(inStart.size());
   auto GetInEnd = [](Dims &inEnd, const Dims &inStart, const Dims &inCount) {
     for (size_t i = 0; i < inStart.size(); i++)
       inEnd[i] = inStart[i] + inCount[i] - 1;
@@ -343,21 +604,16 @@ int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
     }
   };
 
-  auto GetInOvlpBase = [](const char *&inOvlpBase, const char *in,
-                          const Dims &inStart, Dims &inStride,
-                          Dims &ovlpStart) {
-    inOvlpBase = in;
-    for (size_t i = 0; i < inStart.size(); i++)
-      inOvlpBase = inOvlpBase + (ovlpStart[i] - inStart[i]) * inStride[i];
-  };
-  auto GetOutOvlpBase = [](char *&outOvlpBase, char *out, const Dims &outStart,
-                           Dims &outStride, Dims &ovlpStart) {
-    outOvlpBase = out;
-    for (size_t i = 0; i < outStart.size(); i++)
-      outOvlpBase = outOvlpBase + (ovlpStart[i] - outStart[i]) * outStride[i];
+  auto GetIoOvlpOffset = [](const Dims &ioStart, Dims &ioStride,
+                            Dims &ovlpStart) {
+    size_t offset = 0;
+    for (size_t i = 0; i < ioStart.size(); i++)
+      offset += (ovlpStart[i] - ioStart[i]) * ioStride[i];
+    return offset;
   };
   auto GetIoOvlpGapSize = [](Dims &ioOvlpGapSize, Dims &ioStride,
                              const Dims &ioCount, Dims &ovlpCount) {
+    ioOvlpGapSize.resize(ioStride.size());
     for (size_t i = 0; i < ioOvlpGapSize.size(); i++)
       ioOvlpGapSize[i] = (ioCount[i] - ovlpCount[i]) * ioStride[i];
   };
@@ -389,11 +645,15 @@ int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
 
   auto GetRltvOvlpStartPos = [](Dims &ioRltvOvlpStart, const Dims &ioStart,
                                 Dims &ovlpStart) {
+    ioRltvOvlpStart.resize(ioStart.size());
     for (size_t i = 0; i < ioStart.size(); i++)
       ioRltvOvlpStart[i] = ovlpStart[i] - ioStart[i];
   };
+  plan.outBytes =
+      std::accumulate(outMemCountNC.begin(), outMemCountNC.end(), elmSize,
+                      std::multiplies<size_t>());
+  const bool revEndian = inIsLittleEndian != outIsLittleEndian;
 
-  // main flow
   // row-major ==> row-major mode
   // algrithm optimizations:
   // 1. contigous data copying
@@ -405,161 +665,427 @@ int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
     GetOvlpEnd(ovlpEnd, inEnd, outEnd);
     GetOvlpCount(ovlpCount, ovlpStart, ovlpEnd);
     if (!HasOvlp(ovlpStart, ovlpEnd))
-      return 1; // no overlap found
-    GetIoStrides(inStride, inMemCountNC, sizeof(T));
-    GetIoStrides(outStride, outMemCountNC, sizeof(T));
-    GetIoOvlpGapSize(inOvlpGapSize, inStride, inMemCountNC, ovlpCount);
-    GetIoOvlpGapSize(outOvlpGapSize, outStride, outMemCountNC, ovlpCount);
-    GetInOvlpBase(inOvlpBase, in, inMemStartNC, inStride, ovlpStart);
-    GetOutOvlpBase(outOvlpBase, out, outMemStartNC, outStride, ovlpStart);
-    minContDim = GetMinContDim(inMemCountNC, outMemCountNC, ovlpCount);
-    blockSize = GetBlockSize(ovlpCount, minContDim, sizeof(T));
-    // same endianess mode: most optimized, contiguous data copying
-    // algorithm used.
-    if (inIsLittleEndian == outIsLittleEndian) {
-      // most efficient algm
-      // warning: number of function stacks used is number of dimensions
-      // of data.
-      if (!safeMode)
-        NdCopyRecurDFSeqPadding(0, inOvlpBase, outOvlpBase, inOvlpGapSize,
-                                outOvlpGapSize, ovlpCount, minContDim,
-                                blockSize);
-      else // safeMode
-        //      //alternative iterative version, 10% slower then
-        //      recursive
-        //      //use it when very high demension is used.
-        NdCopyIterDFSeqPadding(inOvlpBase, outOvlpBase, inOvlpGapSize,
-                               outOvlpGapSize, ovlpCount, minContDim,
-                               blockSize);
-    }
-    // different endianess mode
-    else {
-      if (!safeMode)
-        NdCopyRecurDFSeqPaddingRevEndian(
-            0, inOvlpBase, outOvlpBase, inOvlpGapSize, outOvlpGapSize,
-            ovlpCount, minContDim, blockSize, sizeof(T), blockSize / sizeof(T));
-      else
-        NdCopyIterDFSeqPaddingRevEndian(
-            inOvlpBase, outOvlpBase, inOvlpGapSize, outOvlpGapSize, ovlpCount,
-            minContDim, blockSize, sizeof(T), blockSize / sizeof(T));
-    }
+      return; // no overlap found
+    GetIoStrides(inStride, inMemCountNC, elmSize);
+    GetIoStrides(outStride, outMemCountNC, elmSize);
+    GetIoOvlpGapSize(plan.inOvlpGapSize, inStride, inMemCountNC, ovlpCount);
+    GetIoOvlpGapSize(plan.outOvlpGapSize, outStride, outMemCountNC,
+                     ovlpCount);
+    plan.inOvlpOffset = GetIoOvlpOffset(inMemStartNC, inStride, ovlpStart);
+    plan.outOvlpOffset = GetIoOvlpOffset(outMemStartNC, outStride, ovlpStart);
+    plan.minContDim = GetMinContDim(inMemCountNC, outMemCountNC, ovlpCount);
+    plan.blockSize = GetBlockSize(ovlpCount, plan.minContDim, elmSize);
+    // the recursive kernels are usually the most efficient; the iterative
+    // ones use no stack per dimension (safeMode), and are picked anyway where
+    // the tuning found them faster
+    const bool iter = safeMode || NdCopyGetTuning().iterSeqPadding;
+    if (!revEndian)
+      plan.kernel =
+          iter ? NdCopyPlan::IterSeqPadding : NdCopyPlan::RecurSeqPadding;
+    else
+      plan.kernel = iter ? NdCopyPlan::IterSeqPaddingRevEndian
+                         : NdCopyPlan::RecurSeqPaddingRevEndian;
+    // small blocks: the specialized kernel, iterative so fine in safeMode
+    if (!revEndian && plan.minContDim > 0 && NdCopyIsSmallBlock(plan.blockSize))
+      plan.kernel = NdCopyPlan::IterSeqPaddingSmall;
+    plan.hasOvlp = true;
+    return;
   }
 
   // Copying modes involing col-major
   // algorithm optimization:
   // 1. mem ptr arithmetics: O(1) overhead per block, dynamic/non-sequential
   // padding
+  // col-major ==> col-major mode
+  if (!inIsRowMajor && !outIsRowMajor) {
+
+    GetInEnd(inEnd, inStart, inCount);
+    GetOutEnd(outEnd, outStart, outCount);
+    GetOvlpStart(ovlpStart, inStart, outStart);
+    GetOvlpEnd(ovlpEnd, inEnd, outEnd);
+    GetOvlpCount(ovlpCount, ovlpStart, ovlpEnd);
+    if (!HasOvlp(ovlpStart, ovlpEnd))
+      return; // no overlap found
+
+    GetIoStrides(inStride, inCount, elmSize);
+    GetIoStrides(outStride, outCount, elmSize);
+
+    GetRltvOvlpStartPos(inRltvOvlpStartPos, inMemStartNC, ovlpStart);
+    GetRltvOvlpStartPos(outRltvOvlpStartPos, outMemStartNC, ovlpStart);
+  }
+  // row-major ==> col-major mode
+  else if (inIsRowMajor && !outIsRowMajor) {
+    Dims revOutStart(outStart);
+    Dims revOutCount(outCount);
+
+    std::reverse(outMemStartNC.begin(), outMemStartNC.end());
+    std::reverse(outMemCountNC.begin(), outMemCountNC.end());
+
+    GetInEnd(inEnd, inStart, inCount);
+    GetOutEnd(outEnd, revOutStart, revOutCount);
+    GetOvlpStart(ovlpStart, inStart, revOutStart);
+    GetOvlpEnd(ovlpEnd, inEnd, outEnd);
+    GetOvlpCount(ovlpCount, ovlpStart, ovlpEnd);
+    if (!HasOvlp(ovlpStart, ovlpEnd))
+      return; // no overlap found
+
+    // get normal order inStride
+    GetIoStrides(inStride, inMemCountNC, elmSize);
+
+    // calulate reversed order outStride
+    GetIoStrides(outStride, outMemCountNC, elmSize);
+    // reverse outStride so that outStride aligns to inStride
+    std::reverse(outStride.begin(), outStride.end());
+
+    // get normal order inOvlpStart
+    GetRltvOvlpStartPos(inRltvOvlpStartPos, inMemStartNC, ovlpStart);
+
+    // get reversed order outOvlpStart
+    Dims revOvlpStart(ovlpStart);
+    std::reverse(revOvlpStart.begin(), revOvlpStart.end());
+    GetRltvOvlpStartPos(outRltvOvlpStartPos, outMemStartNC, revOvlpStart);
+    // back to normal order, to line up with outStride
+    std::reverse(outRltvOvlpStartPos.begin(), outRltvOvlpStartPos.end());
+  }
+  // col-major ==> row-major mode
   else {
-    //        Dims revInCount(inCount);
-    //        Dims revOutCount(outCount);
-    //
-    // col-major ==> col-major mode
-    if (!inIsRowMajor && !outIsRowMajor) {
-
-      GetInEnd(inEnd, inStart, inCount);
-      GetOutEnd(outEnd, outStart, outCount);
-      GetOvlpStart(ovlpStart, inStart, outStart);
-      GetOvlpEnd(ovlpEnd, inEnd, outEnd);
-      GetOvlpCount(ovlpCount, ovlpStart, ovlpEnd);
-      if (!HasOvlp(ovlpStart, ovlpEnd))
-        return 1; // no overlap found
-
-      GetIoStrides(inStride, inCount, sizeof(T));
-      GetIoStrides(outStride, outCount, sizeof(T));
-
-      GetRltvOvlpStartPos(inRltvOvlpStartPos, inMemStartNC, ovlpStart);
-      GetRltvOvlpStartPos(outRltvOvlpStartPos, outMemStartNC, ovlpStart);
+    Dims revInStart(inStart);
+    Dims revInCount(inCount);
+    std::reverse(inMemStartNC.begin(), inMemStartNC.end());
+    std::reverse(inMemCountNC.begin(), inMemCountNC.end());
+
+    GetInEnd(inEnd, revInStart, revInCount);
+    GetOutEnd(outEnd, outStart, outCount);
+    GetOvlpStart(ovlpStart, revInStart, outStart);
+    GetOvlpEnd(ovlpEnd, inEnd, outEnd);
+    GetOvlpCount(ovlpCount, ovlpStart, ovlpEnd);
+    if (!HasOvlp(ovlpStart, ovlpEnd))
+      return; // no overlap found
+
+    // get normal order outStride
+    GetIoStrides(outStride, outMemCountNC, elmSize);
+
+    // calculate reversed inStride
+    GetIoStrides(inStride, inMemCountNC, elmSize);
+    // reverse inStride so that inStride aligns to outStride
+    std::reverse(inStride.begin(), inStride.end());
+
+    // get reversed order inOvlpStart
+    Dims revOvlpStart(ovlpStart);
+    std::reverse(revOvlpStart.begin(), revOvlpStart.end());
+    GetRltvOvlpStartPos(inRltvOvlpStartPos, inMemStartNC, revOvlpStart);
+    // back to normal order, to line up with inStride
+    std::reverse(inRltvOvlpStartPos.begin(), inRltvOvlpStartPos.end());
+    // get normal order outOvlpStart
+    GetRltvOvlpStartPos(outRltvOvlpStartPos, outMemStartNC, ovlpStart);
+  }
+  const bool iter = safeMode || NdCopyGetTuning().iterDynamic;
+  if (!revEndian)
+    plan.kernel = iter ? NdCopyPlan::IterDynamic : NdCopyPlan::RecurDynamic;
+  else
+    plan.kernel = iter ? NdCopyPlan::IterDynamicRevEndian
+                       : NdCopyPlan::RecurDynamicRevEndian;
+  plan.hasOvlp = true;
+}
+
+// NdCopyPlanKeyHash: helper class
+struct NdCopyPlanKeyHash {
+  size_t operator()(const Dims &key) const {
+    size_t h = 0;
+    for (size_t v : key)
+      h ^= std::hash<size_t>()(v) + 0x9e3779b97f4a7c15ull + (h << 6) +
+           (h >> 2);
+    return h;
+  }
+};
+
+// NdCopyPlanCache
+// bounded (least recently used entries are evicted) cache of NdCopyPlans,
+// keyed on everything a plan depends on: the rank, starts, counts, mem
+// boxes, majors, endianess, safeMode, element size and the tuning
+// generation (NDCopyTuning.hpp). every thread has its own, so concurrent
+// copies never wait on each other; Clear() and the stats act on the calling
+// thread's cache. the capacity is process wide and bounds every thread's
+// cache, SetCapacity(0) turns caching off. plans are handed out as
+// shared_ptr, so evicting one never affects a copy still running with it.
+class NdCopyPlanCache {
+public:
+  static const size_t DefaultCapacity = 256;
+
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t size = 0;
+  };
+
+  // the calling thread's cache
+  static NdCopyPlanCache &Instance() {
+    static thread_local NdCopyPlanCache cache;
+    return cache;
+  }
+
+  bool IsEnabled() const {
+    return Capacity().load(std::memory_order_relaxed) > 0;
+  }
+
+  // the plan cached under key, null on a miss
+  std::shared_ptr<const NdCopyPlan> Find(const Dims &key) {
+    auto it = m_Map.find(key);
+    if (it == m_Map.end()) {
+      m_Stats.misses++;
+      return nullptr;
     }
-    // row-major ==> col-major mode
-    else if (inIsRowMajor && !outIsRowMajor) {
-      Dims revOutStart(outStart);
-      Dims revOutCount(outCount);
-
-      std::reverse(outMemStartNC.begin(), outMemStartNC.end());
-      std::reverse(outMemCountNC.begin(), outMemCountNC.end());
-
-      GetInEnd(inEnd, inStart, inCount);
-      GetOutEnd(outEnd, revOutStart, revOutCount);
-      GetOvlpStart(ovlpStart, inStart, revOutStart);
-      GetOvlpEnd(ovlpEnd, inEnd, outEnd);
-      GetOvlpCount(ovlpCount, ovlpStart, ovlpEnd);
-      if (!HasOvlp(ovlpStart, ovlpEnd))
-        return 1; // no overlap found
-
-      // get normal order inStride
-      GetIoStrides(inStride, inMemCountNC, sizeof(T));
-
-      // calulate reversed order outStride
-      GetIoStrides(outStride, outMemCountNC, sizeof(T));
-      // reverse outStride so that outStride aligns to inStride
-      std::reverse(outStride.begin(), outStride.end());
-
-      // get normal order inOvlpStart
-      GetRltvOvlpStartPos(inRltvOvlpStartPos, inMemStartNC, ovlpStart);
-
-      // get reversed order outOvlpStart
-      Dims revOvlpStart(ovlpStart);
-      std::reverse(revOvlpStart.begin(), revOvlpStart.end());
-      GetRltvOvlpStartPos(outRltvOvlpStartPos, outMemStartNC, revOvlpStart);
+    m_Stats.hits++;
+    m_Lru.splice(m_Lru.begin(), m_Lru, it->second.lruPos);
+    return it->second.plan;
+  }
+
+  void Insert(const Dims &key, std::shared_ptr<const NdCopyPlan> plan) {
+    if (m_Map.count(key) > 0)
+      return;
+    auto it = m_Map.emplace(key, Entry()).first;
+    it->second.plan = std::move(plan);
+    m_Lru.push_front(&it->first);
+    it->second.lruPos = m_Lru.begin();
+    Evict();
+  }
+
+  // for all threads; the other threads' caches shrink on their next insert
+  void SetCapacity(size_t capacity) {
+    Capacity().store(capacity, std::memory_order_relaxed);
+    Evict();
+  }
+
+  void Clear() {
+    m_Map.clear();
+    m_Lru.clear();
+  }
+
+  Stats GetStats() const {
+    Stats stats = m_Stats;
+    stats.size = m_Map.size();
+    return stats;
+  }
+
+  void ResetStats() { m_Stats = Stats(); }
+
+private:
+  NdCopyPlanCache() = default;
+  NdCopyPlanCache(const NdCopyPlanCache &) = delete;
+  NdCopyPlanCache &operator=(const NdCopyPlanCache &) = delete;
+
+  struct Entry {
+    std::shared_ptr<const NdCopyPlan> plan;
+    std::list<const Dims *>::iterator lruPos;
+  };
+
+  static std::atomic<size_t> &Capacity() {
+    static std::atomic<size_t> capacity{DefaultCapacity};
+    return capacity;
+  }
+
+  // Evict(): drops least recently used entries down to the capacity
+  void Evict() {
+    while (m_Map.size() > Capacity().load(std::memory_order_relaxed)) {
+      m_Map.erase(*m_Lru.back());
+      m_Lru.pop_back();
+      m_Stats.evictions++;
     }
-    // col-major ==> row-major mode
-    else if (!inIsRowMajor && outIsRowMajor) {
-      Dims revInStart(inStart);
-      Dims revInCount(inCount);
-      std::reverse(inMemStartNC.begin(), inMemStartNC.end());
-      std::reverse(inMemCountNC.begin(), inMemCountNC.end());
-
-      GetInEnd(inEnd, revInStart, revInCount);
-      GetOutEnd(outEnd, outStart, outCount);
-      GetOvlpStart(ovlpStart, revInStart, outStart);
-      GetOvlpEnd(ovlpEnd, inEnd, outEnd);
-      GetOvlpCount(ovlpCount, ovlpStart, ovlpEnd);
-      if (!HasOvlp(ovlpStart, ovlpEnd))
-        return 1; // no overlap found
-
-      // get normal order outStride
-      GetIoStrides(outStride, outMemCountNC, sizeof(T));
-
-      // calculate reversed inStride
-      GetIoStrides(inStride, inMemCountNC, sizeof(T));
-      // reverse inStride so that inStride aligns to outStride
-      std::reverse(inStride.begin(), inStride.end());
-
-      // get reversed order inOvlpStart
-      Dims revOvlpStart(ovlpStart);
-      std::reverse(revOvlpStart.begin(), revOvlpStart.end());
-      GetRltvOvlpStartPos(inRltvOvlpStartPos, inMemStartNC, revOvlpStart);
-      // get normal order outOvlpStart
-      GetRltvOvlpStartPos(outRltvOvlpStartPos, outMemStartNC, ovlpStart);
+  }
+
+  std::unordered_map<Dims, Entry, NdCopyPlanKeyHash> m_Map;
+  // keys of m_Map, most recently used first
+  std::list<const Dims *> m_Lru;
+  Stats m_Stats;
+};
+
+// NdCopyGetPlan(): helper function
+// the plan for a geometry: from NdCopyPlanCache if it is there, otherwise
+// built and cached (cached keeps it alive for the call). with the cache off
+// it is built into local.
+static const NdCopyPlan &
+NdCopyGetPlan(std::shared_ptr<const NdCopyPlan> &cached, NdCopyPlan &local,
+              const Dims &inStart, const Dims &inCount,
+              const bool inIsRowMajor, const bool inIsLittleEndian,
+              const Dims &outStart, const Dims &outCount,
+              const bool outIsRowMajor, const bool outIsLittleEndian,
+              const Dims &inMemStart, const Dims &inMemCount,
+              const Dims &outMemStart, const Dims &outMemCount,
+              const bool safeMode, const size_t elmSize) {
+  NdCopyPlanCache &cache = NdCopyPlanCache::Instance();
+  if (!cache.IsEnabled()) {
+    NdCopyMakePlan(local, inStart, inCount, inIsRowMajor, inIsLittleEndian,
+                   outStart, outCount, outIsRowMajor, outIsLittleEndian,
+                   inMemStart, inMemCount, outMemStart, outMemCount,
+                   safeMode, elmSize);
+    return local;
+  }
+  // the key is built in a per thread buffer, so a hit does not allocate
+  static thread_local Dims key;
+  key.clear();
+  key.push_back(elmSize);
+  key.push_back((inIsRowMajor ? 1 : 0) | (inIsLittleEndian ? 2 : 0) |
+                (outIsRowMajor ? 4 : 0) | (outIsLittleEndian ? 8 : 0) |
+                (safeMode ? 16 : 0));
+  key.push_back(NdCopyTuningGeneration());
+  for (const Dims *dims : {&inStart, &inCount, &outStart, &outCount,
+                           &inMemStart, &inMemCount, &outMemStart,
+                           &outMemCount}) {
+    key.push_back(dims->size());
+    key.insert(key.end(), dims->begin(), dims->end());
+  }
+  cached = cache.Find(key);
+  if (!cached) {
+    std::shared_ptr<NdCopyPlan> plan = std::make_shared<NdCopyPlan>();
+    NdCopyMakePlan(*plan, inStart, inCount, inIsRowMajor, inIsLittleEndian,
+                   outStart, outCount, outIsRowMajor, outIsLittleEndian,
+                   inMemStart, inMemCount, outMemStart, outMemCount,
+                   safeMode, elmSize);
+    cached = plan;
+    cache.Insert(key, cached);
+  }
+  return *cached;
+}
+
+template <class T>
+int NdCopy(const char *in, const Dims &inStart, const Dims &inCount,
+           const bool inIsRowMajor, const bool inIsLittleEndian, char *out,
+           const Dims &outStart, const Dims &outCount, const bool outIsRowMajor,
+           const bool outIsLittleEndian, const Dims &inMemStart,
+           const Dims &inMemCount, const Dims &outMemStart,
+           const Dims &outMemCount, const bool safeMode,
+           const NdCopyOptions<T> &options)
+
+{
+  std::shared_ptr<const NdCopyPlan> cached;
+  NdCopyPlan local;
+  const NdCopyPlan &plan =
+      NdCopyGetPlan(cached, local, inStart, inCount, inIsRowMajor,
+                    inIsLittleEndian, outStart, outCount, outIsRowMajor,
+                    outIsLittleEndian, inMemStart, inMemCount, outMemStart,
+                    outMemCount, safeMode, sizeof(T));
+  // which bytes of T to swap in the different endianess modes
+  const NdCopyElmDesc elmDesc = NdCopyElmTraits<T>::Desc();
+  if (!plan.hasOvlp) {
+    // no overlap: the fill still covers the whole output
+    if (options.fill) {
+      char value[sizeof(T)];
+      NdCopyFillValue(value, *options.fill, outIsLittleEndian);
+      NdCopyFillBytes(out, plan.outBytes, value, sizeof(T));
     }
+    return 1; // no overlap found
+  }
 
-    inOvlpBase = in;
-    outOvlpBase = out;
-    // Same Endian"
-    if (inIsLittleEndian == outIsLittleEndian) {
-      if (!safeMode)
-        NdCopyRecurDFNonSeqDynamic(0, inOvlpBase, outOvlpBase,
-                                   inRltvOvlpStartPos, outRltvOvlpStartPos,
-                                   inStride, outStride, ovlpCount, sizeof(T));
-      else
-        NdCopyIterDFDynamic(inOvlpBase, outOvlpBase, inRltvOvlpStartPos,
-                            outRltvOvlpStartPos, inStride, outStride, ovlpCount,
-                            sizeof(T));
+  // main flow
+  // row-major ==> row-major mode
+  if (plan.IsSeqPadding()) {
+    const char *inOvlpBase = in + plan.inOvlpOffset;
+    char *outOvlpBase = out + plan.outOvlpOffset;
+    // fused mode: every contiguous block is copied and reduced in one pass,
+    // and the output gaps between blocks are filled on the way
+    if (options.IsFused()) {
+      NdCopyFusedOp<T> blockOp(
+          options, inIsLittleEndian != outIsLittleEndian ? &elmDesc : nullptr,
+          inIsLittleEndian, outIsLittleEndian, out, plan.outBytes);
+      NdCopyIterDFSeqPaddingOp(inOvlpBase, outOvlpBase, plan.inOvlpGapSize,
+                               plan.outOvlpGapSize, plan.ovlpCount,
+                               plan.minContDim, plan.blockSize, blockOp);
+      blockOp.FillRest();
+      return 0;
+    }
+    switch (plan.kernel) {
+    // same endianess mode: most optimized, contiguous data copying
+    // algorithm used.
+    // warning: number of function stacks used is number of dimensions
+    // of data.
+    case NdCopyPlan::RecurSeqPadding:
+      NdCopyRecurDFSeqPadding(0, inOvlpBase, outOvlpBase, plan.inOvlpGapSize,
+                              plan.outOvlpGapSize, plan.ovlpCount,
+                              plan.minContDim, plan.blockSize);
+      break;
+    case NdCopyPlan::IterSeqPadding:
+      NdCopyIterDFSeqPadding(inOvlpBase, outOvlpBase, plan.inOvlpGapSize,
+                             plan.outOvlpGapSize, plan.ovlpCount,
+                             plan.minContDim, plan.blockSize);
+      break;
+    // small contiguous blocks, same endianess
+    case NdCopyPlan::IterSeqPaddingSmall:
+      NdCopyIterDFSeqPaddingSmallDispatch(
+          inOvlpBase, outOvlpBase, plan.inOvlpGapSize, plan.outOvlpGapSize,
+          plan.ovlpCount, plan.minContDim, plan.blockSize);
+      break;
+    // different endianess mode
+    case NdCopyPlan::RecurSeqPaddingRevEndian:
+      NdCopyRecurDFSeqPaddingRevEndian(
+          0, inOvlpBase, outOvlpBase, plan.inOvlpGapSize, plan.outOvlpGapSize,
+          plan.ovlpCount, plan.minContDim, plan.blockSize, sizeof(T),
+          plan.blockSize / sizeof(T), elmDesc);
+      break;
+    default:
+      NdCopyIterDFSeqPaddingRevEndian(
+          inOvlpBase, outOvlpBase, plan.inOvlpGapSize, plan.outOvlpGapSize,
+          plan.ovlpCount, plan.minContDim, plan.blockSize, sizeof(T),
+          plan.blockSize / sizeof(T), elmDesc);
     }
-    // different Endian"
-    else {
-      if (!safeMode)
-        NdCopyRecurDFNonSeqDynamicRevEndian(
-            0, inOvlpBase, outOvlpBase, inRltvOvlpStartPos, outRltvOvlpStartPos,
-            inStride, outStride, ovlpCount, sizeof(T));
-      else
-        NdCopyIterDFDynamicRevEndian(inOvlpBase, outOvlpBase,
-                                     inRltvOvlpStartPos, outRltvOvlpStartPos,
-                                     inStride, outStride, ovlpCount, sizeof(T));
+    return 0;
+  }
+
+  // Copying modes involing col-major
+  // fused mode
+  if (options.IsFused()) {
+    // row-major ==> col-major walks the input's order; a checksum or a
+    // fill has to see the output in its own memory order, so walk the
+    // dimensions the other way round (the kernel treats both sides alike)
+    const NdCopyPlan *walk = &plan;
+    NdCopyPlan revPlan;
+    if (options.NeedsOutOrder() && inIsRowMajor && !outIsRowMajor) {
+      revPlan = plan;
+      std::reverse(revPlan.inRltvOvlpStartPos.begin(),
+                   revPlan.inRltvOvlpStartPos.end());
+      std::reverse(revPlan.outRltvOvlpStartPos.begin(),
+                   revPlan.outRltvOvlpStartPos.end());
+      std::reverse(revPlan.inStride.begin(), revPlan.inStride.end());
+      std::reverse(revPlan.outStride.begin(), revPlan.outStride.end());
+      std::reverse(revPlan.ovlpCount.begin(), revPlan.ovlpCount.end());
+      walk = &revPlan;
     }
+    NdCopyFusedOp<T> blockOp(
+        options, inIsLittleEndian != outIsLittleEndian ? &elmDesc : nullptr,
+        inIsLittleEndian, outIsLittleEndian, out, plan.outBytes);
+    NdCopyIterDFDynamicOp(in, out, walk->inRltvOvlpStartPos,
+                          walk->outRltvOvlpStartPos, walk->inStride,
+                          walk->outStride, walk->ovlpCount, sizeof(T),
+                          blockOp);
+    blockOp.FillRest();
+    return 0;
+  }
+  switch (plan.kernel) {
+  // Same Endian"
+  case NdCopyPlan::RecurDynamic:
+    NdCopyRecurDFNonSeqDynamic(0, in, out, plan.inRltvOvlpStartPos,
+                               plan.outRltvOvlpStartPos, plan.inStride,
+                               plan.outStride, plan.ovlpCount, sizeof(T));
+    break;
+  case NdCopyPlan::IterDynamic:
+    NdCopyIterDFDynamic(in, out, plan.inRltvOvlpStartPos,
+                        plan.outRltvOvlpStartPos, plan.inStride,
+                        plan.outStride, plan.ovlpCount, sizeof(T));
+    break;
+  // different Endian"
+  case NdCopyPlan::RecurDynamicRevEndian:
+    NdCopyRecurDFNonSeqDynamicRevEndian(
+        0, in, out, plan.inRltvOvlpStartPos, plan.outRltvOvlpStartPos,
+        plan.inStride, plan.outStride, plan.ovlpCount, sizeof(T), elmDesc);
+    break;
+  default:
+    NdCopyIterDFDynamicRevEndian(in, out, plan.inRltvOvlpStartPos,
+                                 plan.outRltvOvlpStartPos, plan.inStride,
+                                 plan.outStride, plan.ovlpCount, sizeof(T),
+                                 elmDesc);
   }
   return 0;
 }
-//*************** End of NdCopy() and its 8 helpers ***************
+//*************** End of NdCopy() and its helpers ***************
 
 #endif
\ No newline at end of file
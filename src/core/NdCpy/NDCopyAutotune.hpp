@@ -0,0 +1,356 @@
+//
+//  NDCopyAutotune.hpp
+//  src
+//
+
+#ifndef NDCOPYAUTOTUNE_HPP
+#define NDCOPYAUTOTUNE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyLayout.hpp"
+#include "core/NdCpy/NDCopyPack.hpp"
+#include "core/NdCpy/NDCopyTuning.hpp"
+
+// NdCopyAutotuneConfig
+// repeats: runs per candidate, the fastest one counts.
+// maxPackBytes: largest message tried for the NdCopyPack() threading, which
+//   also bounds the memory the tuning uses (about twice this).
+struct NdCopyAutotuneConfig {
+  size_t repeats = 5;
+  size_t maxPackBytes = size_t(32) << 20;
+};
+
+NdCopyTuning
+NdCopyAutotune(const NdCopyAutotuneConfig &config = NdCopyAutotuneConfig());
+int NdCopyTuneAtStartup(
+    const char *path,
+    const NdCopyAutotuneConfig &config = NdCopyAutotuneConfig());
+
+//***************Start of NdCopyAutotune() and its helpers ***************
+// NdCopyAutotune() micro-benchmarks the candidates of every NdCopyTuning
+// choice on a few representative shape classes and keeps the fastest:
+// 1. recursive vs iterative kernels, for row-major ==> row-major with medium
+//    and with large contiguous blocks, and for row-major <==> col-major,
+// 2. the block size range where NdCopyAlignedBlock() beats memcpy (only
+//    when NdCopyBlock() can use it, i.e. with 32/64 byte vectors),
+// 3. the number of threads NdCopyPack() uses and the message size from
+//    which they pay off,
+// 4. the tile of the strided transposition kernel, or no tiling at all, on
+//    a 2d float and double transposition and an NHWC ==> NCHW permutation.
+// a candidate has to win by NdCopyAutotuneMargin to replace the default, so
+// that noise does not flip choices from run to run.
+
+const double NdCopyAutotuneMargin = 0.05;
+
+// NdCopyAutotuneTime(): helper function
+// seconds of the fastest of repeats runs of fn
+template <class Fn>
+static double NdCopyAutotuneTime(size_t repeats, Fn fn) {
+  double best = std::numeric_limits<double>::max();
+  for (size_t r = 0; r < std::max<size_t>(repeats, 1); r++) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+// NdCopyAutotuneWins(): helper function
+static inline bool NdCopyAutotuneWins(double candidate, double current) {
+  return candidate < current * (1 - NdCopyAutotuneMargin);
+}
+
+// NdCopyAutotuneKernels(): helper function
+// total time of the shape classes with the recursive and the iterative
+// kernel. the kernels are run straight on the copy's plan rather than
+// through NdCopy(), so the process wide tuning is neither consulted for the
+// choice nor changed while other threads may be copying.
+template <class T>
+static void NdCopyAutotuneKernels(size_t repeats, const Dims &inCount,
+                                  const Dims &outStart, const Dims &outCount,
+                                  bool inIsRowMajor, bool outIsRowMajor,
+                                  double &recur, double &iter) {
+  const Dims inStart(inCount.size(), 0);
+  const size_t inElms = std::accumulate(inCount.begin(), inCount.end(),
+                                        size_t(1), std::multiplies<size_t>());
+  const size_t outElms =
+      std::accumulate(outCount.begin(), outCount.end(), size_t(1),
+                      std::multiplies<size_t>());
+  std::vector<char> in(inElms * sizeof(T), 1), out(outElms * sizeof(T));
+  NdCopyPlan plan;
+  NdCopyMakePlan(plan, inStart, inCount, inIsRowMajor, true, outStart,
+                 outCount, outIsRowMajor, true, Dims(), Dims(), Dims(),
+                 Dims(), true, sizeof(T));
+  if (!plan.hasOvlp)
+    return;
+  if (plan.IsSeqPadding()) {
+    recur += NdCopyAutotuneTime(repeats, [&]() {
+      const char *inBase = in.data() + plan.inOvlpOffset;
+      char *outBase = out.data() + plan.outOvlpOffset;
+      NdCopyRecurDFSeqPadding(0, inBase, outBase, plan.inOvlpGapSize,
+                              plan.outOvlpGapSize, plan.ovlpCount,
+                              plan.minContDim, plan.blockSize);
+    });
+    iter += NdCopyAutotuneTime(repeats, [&]() {
+      const char *inBase = in.data() + plan.inOvlpOffset;
+      char *outBase = out.data() + plan.outOvlpOffset;
+      NdCopyIterDFSeqPadding(inBase, outBase, plan.inOvlpGapSize,
+                             plan.outOvlpGapSize, plan.ovlpCount,
+                             plan.minContDim, plan.blockSize);
+    });
+    return;
+  }
+  recur += NdCopyAutotuneTime(repeats, [&]() {
+    NdCopyRecurDFNonSeqDynamic(0, in.data(), out.data(),
+                               plan.inRltvOvlpStartPos,
+                               plan.outRltvOvlpStartPos, plan.inStride,
+                               plan.outStride, plan.ovlpCount, sizeof(T));
+  });
+  iter += NdCopyAutotuneTime(repeats, [&]() {
+    NdCopyIterDFDynamic(in.data(), out.data(), plan.inRltvOvlpStartPos,
+                        plan.outRltvOvlpStartPos, plan.inStride,
+                        plan.outStride, plan.ovlpCount, sizeof(T));
+  });
+}
+
+// NdCopyAutotuneAlignedBlock(): helper function
+// the block sizes (powers of two) where NdCopyAlignedBlock() beats memcpy,
+// with the destination misaligned the way gaps usually leave it. every size
+// is compared NdCopyAutotuneTrials times: it is a win if the aligned copy
+// wins every trial, a loss if it is never faster, and a tie otherwise. the
+// range is the longest run from a win to a win without a loss in between,
+// so that a size near the margin neither breaks a run nor a single noisy
+// size makes one. without any win the range is emptied if every size lost,
+// and left as it was if the timings could not tell.
+const size_t NdCopyAutotuneTrials = 5;
+
+static void NdCopyAutotuneAlignedBlock(size_t repeats, NdCopyTuning &tuning) {
+  const NdCopyBlockFn wide = NdCopyWideBlock();
+  if (wide == nullptr)
+    return;
+  const size_t bufBytes = 64 * 1024;
+  std::vector<char> in(bufBytes + 64, 1), out(bufBytes + 64);
+  enum Result { Loss, Tie, Win };
+  std::vector<size_t> sizes;
+  std::vector<Result> results;
+  for (size_t size = 64; size <= 16384; size *= 2) {
+    const size_t numBlocks = bufBytes / size;
+    auto Run = [&](bool aligned) {
+      return NdCopyAutotuneTime(repeats, [&]() {
+        for (size_t rep = 0; rep < 16; rep++)
+          for (size_t b = 0; b < numBlocks; b++) {
+            char *o = out.data() + 8 + b * size;
+            const char *i = in.data() + 24 + b * size;
+            if (aligned)
+              wide(o, i, size);
+            else
+              std::memcpy(o, i, size);
+          }
+      });
+    };
+    size_t wins = 0, faster = 0;
+    for (size_t t = 0; t < NdCopyAutotuneTrials; t++) {
+      const double plain = Run(false);
+      const double aligned = Run(true);
+      wins += NdCopyAutotuneWins(aligned, plain);
+      faster += aligned < plain;
+    }
+    sizes.push_back(size);
+    results.push_back(wins == NdCopyAutotuneTrials ? Win
+                      : faster == 0                ? Loss
+                                                   : Tie);
+  }
+  size_t bestFirst = 0, bestLast = 0;
+  bool found = false, allLost = true;
+  for (size_t first = 0; first < sizes.size(); first++) {
+    allLost = allLost && results[first] == Loss;
+    if (results[first] != Win)
+      continue;
+    for (size_t last = first; last < sizes.size() && results[last] != Loss;
+         last++)
+      if (results[last] == Win &&
+          (!found || last - first > bestLast - bestFirst)) {
+        bestFirst = first;
+        bestLast = last;
+        found = true;
+      }
+  }
+  if (found) {
+    tuning.alignedBlockMin = sizes[bestFirst];
+    tuning.alignedBlockMax = sizes[bestLast];
+  } else if (allLost) {
+    // an empty range when memcpy always wins
+    tuning.alignedBlockMin = std::numeric_limits<size_t>::max();
+    tuning.alignedBlockMax = 0;
+  }
+}
+
+// NdCopyAutotunePack(): helper function
+// the best number of threads for the biggest message, then the smallest
+// message size from which that many threads beat one
+static void NdCopyAutotunePack(size_t repeats, size_t maxPackBytes,
+                               NdCopyTuning &tuning) {
+  const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+  tuning.packMaxThreads = 1;
+  tuning.packParallelMinBytes = std::numeric_limits<size_t>::max();
+  if (hw == 1)
+    return;
+  // the buffer is slabs of 512 x 128 doubles, the box leaves out 8 columns
+  const size_t slabBytes = 512 * 128 * sizeof(double);
+  std::vector<size_t> sizes;
+  for (size_t bytes = size_t(1) << 20; bytes <= maxPackBytes; bytes *= 4)
+    sizes.push_back(bytes);
+  if (sizes.empty())
+    return;
+  std::vector<char> buf(sizes.back() + slabBytes), packed(buf.size());
+  auto Time = [&](size_t bytes, size_t numThreads) {
+    const size_t numSlabs = std::max<size_t>(bytes / slabBytes, 1);
+    NdCopyPackType type({0, 0, 0}, {numSlabs, 512, 128}, {0, 0, 4},
+                        {numSlabs, 512, 120}, sizeof(double));
+    return NdCopyAutotuneTime(repeats, [&]() {
+      NdCopyPack(type, buf.data(), packed.data(), numThreads);
+    });
+  };
+  const double one = Time(sizes.back(), 1);
+  double best = one;
+  for (size_t t = 2; t <= std::min<size_t>(hw, 64); t *= 2) {
+    const double time = Time(sizes.back(), t);
+    if (NdCopyAutotuneWins(time, best)) {
+      best = time;
+      tuning.packMaxThreads = t;
+    }
+  }
+  if (tuning.packMaxThreads == 1)
+    return;
+  for (size_t bytes : sizes)
+    if (NdCopyAutotuneWins(Time(bytes, tuning.packMaxThreads),
+                           Time(bytes, 1))) {
+      tuning.packParallelMinBytes = bytes;
+      break;
+    }
+}
+
+// NdCopyAutotuneStrided(): helper function
+// tile row bytes (0: untiled) and then tile area of the transposition
+// kernel. the candidates are passed to NdCopyStridedExec() directly.
+static void NdCopyAutotuneStrided(size_t repeats, NdCopyTuning &tuning) {
+  struct Case {
+    Dims count;
+    Strides inStride, outStride;
+    size_t elmSize;
+    std::vector<char> in, out;
+  };
+  // logical dims and output axis order; the input is row major
+  const Dims counts[3] = {{1024, 1024}, {512, 512}, {4, 128, 128, 3}};
+  const Dims orders[3] = {{1, 0}, {1, 0}, {0, 3, 1, 2}};
+  const size_t elmSizes[3] = {sizeof(float), sizeof(double), sizeof(float)};
+  std::vector<Case> cases(3);
+  for (size_t i = 0; i < cases.size(); i++) {
+    Case &c = cases[i];
+    Dims rowMajor(counts[i].size());
+    std::iota(rowMajor.begin(), rowMajor.end(), size_t(0));
+    NdCopyGetLayoutStrides(c.inStride, counts[i], rowMajor, elmSizes[i]);
+    NdCopyGetLayoutStrides(c.outStride, counts[i], orders[i], elmSizes[i]);
+    c.count = counts[i];
+    NdCopyOrderLoops(c.count, c.inStride, c.outStride);
+    c.elmSize = elmSizes[i];
+    const size_t bytes =
+        std::accumulate(counts[i].begin(), counts[i].end(), c.elmSize,
+                        std::multiplies<size_t>());
+    c.in.assign(bytes, 1);
+    c.out.resize(bytes);
+  }
+  auto Time = [&](const NdCopyTuning &candidate) {
+    double total = 0;
+    for (Case &c : cases)
+      total += NdCopyAutotuneTime(repeats, [&]() {
+        NdCopyStridedExec(c.in.data(), c.out.data(), c.count, c.inStride,
+                          c.outStride, c.elmSize, nullptr, candidate);
+      });
+    return total;
+  };
+  NdCopyTuning candidate = tuning;
+  double best = Time(candidate);
+  for (size_t tileBytes : {size_t(0), size_t(32), size_t(128), size_t(256)}) {
+    candidate.stridedTileBytes = tileBytes;
+    const double time = Time(candidate);
+    if (NdCopyAutotuneWins(time, best)) {
+      best = time;
+      tuning.stridedTileBytes = tileBytes;
+    }
+  }
+  if (tuning.stridedTileBytes == 0)
+    return;
+  candidate.stridedTileBytes = tuning.stridedTileBytes;
+  for (size_t area : {size_t(2048), size_t(8192), size_t(16384)}) {
+    candidate.stridedTileArea = area;
+    const double time = Time(candidate);
+    if (NdCopyAutotuneWins(time, best)) {
+      best = time;
+      tuning.stridedTileArea = area;
+    }
+  }
+}
+
+// NdCopyAutotune()
+// measures and returns the best tuning for this machine. every candidate is
+// timed against the local tuning, the process wide one is never touched, so
+// other threads may copy meanwhile (they only skew the timings). takes in
+// the order of a second.
+inline NdCopyTuning NdCopyAutotune(const NdCopyAutotuneConfig &config) {
+  NdCopyTuning tuning; // defaults
+
+  double recur = 0, iter = 0;
+  // row-major ==> row-major, medium blocks (128 bytes) and large ones.
+  // blocks of 4 to 64 bytes always run NdCopyIterDFSeqPaddingSmall(), so
+  // they do not take part in this choice
+  NdCopyAutotuneKernels<double>(config.repeats, {64, 64, 64}, {0, 0, 24},
+                                {64, 64, 16}, true, true, recur, iter);
+  NdCopyAutotuneKernels<double>(config.repeats, {64, 64, 64}, {1, 1, 1},
+                                {62, 62, 62}, true, true, recur, iter);
+  tuning.iterSeqPadding = NdCopyAutotuneWins(iter, recur);
+
+  recur = iter = 0;
+  // row-major ==> col-major and back, a 3d and a 2d class
+  NdCopyAutotuneKernels<float>(config.repeats, {64, 64, 64}, {0, 0, 0},
+                               {64, 64, 64}, true, false, recur, iter);
+  NdCopyAutotuneKernels<float>(config.repeats, {512, 512}, {0, 0},
+                               {512, 512}, false, true, recur, iter);
+  tuning.iterDynamic = NdCopyAutotuneWins(iter, recur);
+
+  NdCopyAutotuneAlignedBlock(config.repeats, tuning);
+  NdCopyAutotunePack(config.repeats, config.maxPackBytes, tuning);
+  NdCopyAutotuneStrided(config.repeats, tuning);
+  return tuning;
+}
+
+// NdCopyTuneAtStartup()
+// loads the profile at path into the process wide tuning; if there is none
+// for this cpu (or it is unreadable), tunes and writes it, so that only the
+// first run on a kind of machine pays for the tuning. returns 0 if the
+// profile was loaded, 1 if it was tuned and written, -1 if it was tuned but
+// could not be written. like NdCopySetTuning(), it has to run before other
+// threads start copying.
+inline int NdCopyTuneAtStartup(const char *path,
+                               const NdCopyAutotuneConfig &config) {
+  if (NdCopyLoadTuning(path) == 0)
+    return 0;
+  const NdCopyTuning tuning = NdCopyAutotune(config);
+  NdCopySetTuning(tuning);
+  return NdCopySaveTuning(path, tuning) == 0 ? 1 : -1;
+}
+//*************** End of NdCopyAutotune() and its helpers ***************
+
+#endif
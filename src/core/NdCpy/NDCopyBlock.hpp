@@ -0,0 +1,181 @@
+//
+//  NDCopyBlock.hpp
+//  src
+//
+
+#ifndef NDCOPYBLOCK_HPP
+#define NDCOPYBLOCK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "core/NdCpy/NDCopySimd.hpp"
+#include "core/NdCpy/NDCopyTuning.hpp"
+
+//***************Start of NdCopyAlignedBlock() and its helpers ***************
+// NdCopyAlignedBlock()
+// Copies a medium sized contiguous block with aligned wide stores.
+// contiguous blocks inside NdCopy() start wherever the gaps put them, so
+// source and destination are usually misaligned relative to each other.
+// the routine:
+// 1. stores the first vector unaligned and moves on to the first aligned
+//    destination address (the peeled head is written twice, which is cheaper
+//    than a byte loop),
+// 2. copies the bulk with aligned stores, and aligned loads too when source
+//    and destination share the same misalignment,
+// 3. stores the last vector unaligned, ending exactly at the block end.
+// so no store in the bulk ever splits a cache line.
+// blocks shorter than one vector fall back to memcpy. there is no 16 byte
+// vector variant: memcpy wins there (see NdCopyBlock()).
+#if defined(__AVX512F__)
+static inline void NdCopyAlignedBlock(char *out, const char *in, size_t size) {
+  const size_t W = 64;
+  if (size < W) {
+    std::memcpy(out, in, size);
+    return;
+  }
+  const __m512i head =
+      _mm512_loadu_si512(reinterpret_cast<const __m512i *>(in));
+  const __m512i tail =
+      _mm512_loadu_si512(reinterpret_cast<const __m512i *>(in + size - W));
+  const size_t peel = (W - (reinterpret_cast<uintptr_t>(out) & (W - 1))) & (W - 1);
+  char *o = out + peel;
+  const char *i = in + peel;
+  char *const oEnd = out + size - W;
+  _mm512_storeu_si512(reinterpret_cast<__m512i *>(out), head);
+  if ((reinterpret_cast<uintptr_t>(i) & (W - 1)) == 0) {
+    for (; o + 4 * W <= oEnd; o += 4 * W, i += 4 * W) {
+      __m512i a = _mm512_load_si512(reinterpret_cast<const __m512i *>(i));
+      __m512i b = _mm512_load_si512(reinterpret_cast<const __m512i *>(i + W));
+      __m512i c =
+          _mm512_load_si512(reinterpret_cast<const __m512i *>(i + 2 * W));
+      __m512i d =
+          _mm512_load_si512(reinterpret_cast<const __m512i *>(i + 3 * W));
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o), a);
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o + W), b);
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o + 2 * W), c);
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o + 3 * W), d);
+    }
+  } else {
+    for (; o + 4 * W <= oEnd; o += 4 * W, i += 4 * W) {
+      __m512i a = _mm512_loadu_si512(reinterpret_cast<const __m512i *>(i));
+      __m512i b = _mm512_loadu_si512(reinterpret_cast<const __m512i *>(i + W));
+      __m512i c =
+          _mm512_loadu_si512(reinterpret_cast<const __m512i *>(i + 2 * W));
+      __m512i d =
+          _mm512_loadu_si512(reinterpret_cast<const __m512i *>(i + 3 * W));
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o), a);
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o + W), b);
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o + 2 * W), c);
+      _mm512_store_si512(reinterpret_cast<__m512i *>(o + 3 * W), d);
+    }
+  }
+  for (; o < oEnd; o += W, i += W)
+    _mm512_store_si512(
+        reinterpret_cast<__m512i *>(o),
+        _mm512_loadu_si512(reinterpret_cast<const __m512i *>(i)));
+  _mm512_storeu_si512(reinterpret_cast<__m512i *>(oEnd), tail);
+}
+#elif defined(__AVX__)
+static inline void NdCopyAlignedBlock(char *out, const char *in, size_t size) {
+  const size_t W = 32;
+  if (size < W) {
+    std::memcpy(out, in, size);
+    return;
+  }
+  const __m256i head =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+  const __m256i tail =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + size - W));
+  const size_t peel = (W - (reinterpret_cast<uintptr_t>(out) & (W - 1))) & (W - 1);
+  char *o = out + peel;
+  const char *i = in + peel;
+  char *const oEnd = out + size - W;
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), head);
+  if ((reinterpret_cast<uintptr_t>(i) & (W - 1)) == 0) {
+    for (; o + 4 * W <= oEnd; o += 4 * W, i += 4 * W) {
+      __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(i));
+      __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i *>(i + W));
+      __m256i c =
+          _mm256_load_si256(reinterpret_cast<const __m256i *>(i + 2 * W));
+      __m256i d =
+          _mm256_load_si256(reinterpret_cast<const __m256i *>(i + 3 * W));
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o), a);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o + W), b);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o + 2 * W), c);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o + 3 * W), d);
+    }
+  } else {
+    for (; o + 4 * W <= oEnd; o += 4 * W, i += 4 * W) {
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(i));
+      __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(i + W));
+      __m256i c =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(i + 2 * W));
+      __m256i d =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(i + 3 * W));
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o), a);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o + W), b);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o + 2 * W), c);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(o + 3 * W), d);
+    }
+  }
+  for (; o < oEnd; o += W, i += W)
+    _mm256_store_si256(
+        reinterpret_cast<__m256i *>(o),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(i)));
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(oEnd), tail);
+}
+#else
+static inline void NdCopyAlignedBlock(char *out, const char *in, size_t size) {
+  std::memcpy(out, in, size);
+}
+#endif
+
+typedef void (*NdCopyBlockFn)(char *out, const char *in, size_t size);
+
+// NdCopyWideBlock(): helper function
+// the aligned block copy NdCopyBlock() uses, null when it uses memcpy only:
+// the selected ISA level's in the library build, else the compiled in one
+// if it has 32/64 byte vectors
+static inline NdCopyBlockFn NdCopyWideBlock() {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  return NdCopySimd().alignedBlock;
+#elif defined(__AVX__)
+  return NdCopyAlignedBlock;
+#else
+  return nullptr;
+#endif
+}
+
+// NdCopyBlock(): helper function
+// copies one contiguous block of the overlap, picking the block copy routine
+// by block size. with 16 byte vectors the library memcpy wins on every
+// alignment class (see performance_test_block_copy_alignment() in main.cpp),
+// so the aligned routine is only used when 32/64 byte vectors are available,
+// for the block sizes NdCopyGetTuning() gives.
+static inline void NdCopyBlock(char *out, const char *in, size_t size) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  const NdCopyTuning &tuning = NdCopyGetTuning();
+  const NdCopyBlockFn wide = NdCopySimd().alignedBlock;
+  if (wide != nullptr && size >= tuning.alignedBlockMin &&
+      size <= tuning.alignedBlockMax) {
+    wide(out, in, size);
+    return;
+  }
+#elif defined(__AVX__)
+  const NdCopyTuning &tuning = NdCopyGetTuning();
+  if (size >= tuning.alignedBlockMin && size <= tuning.alignedBlockMax) {
+    NdCopyAlignedBlock(out, in, size);
+    return;
+  }
+#endif
+  std::memcpy(out, in, size);
+}
+//*************** End of NdCopyAlignedBlock() and its helpers ***************
+
+#endif
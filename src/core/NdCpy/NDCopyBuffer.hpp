@@ -0,0 +1,231 @@
+//
+//  NDCopyBuffer.hpp
+//  src
+//
+
+#ifndef NDCOPYBUFFER_HPP
+#define NDCOPYBUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+//***************Start of HugeBuffer and its allocator ***************
+// HugeBuffer is a drop-in replacement of Buffer for copy destinations:
+// 1. resize() leaves new elements uninitialized instead of zero-filling
+//    memory that NdCopy() overwrites right after,
+// 2. large buffers are 2MB aligned and backed by huge pages (transparent huge
+//    pages via madvise(MADV_HUGEPAGE) by default, or explicit hugetlbfs pages
+//    when asked for), which takes most of the TLB pressure off strided copies,
+// 3. freed buffers are kept in a pool by size class and handed out again,
+//    so repeated resize/free cycles do not go back to the kernel.
+
+// NdCopyBufferPool
+// process wide, thread safe pool behind NdCopyAllocator. size classes are
+// powers of two starting at MinClassSize. at most MaxCachedBytes of freed
+// memory is kept; anything beyond that is returned to the system.
+class NdCopyBufferPool {
+public:
+  enum HugePagePolicy { NoHugePages, TransparentHugePages, ExplicitHugePages };
+
+  static const size_t MinClassSize = 4096;
+  static const size_t HugePageSize = 2 * 1024 * 1024;
+
+  // never destroyed, so that buffers with static storage duration can still
+  // be released at exit
+  static NdCopyBufferPool &Instance() {
+    static NdCopyBufferPool *pool = new NdCopyBufferPool();
+    return *pool;
+  }
+
+  void *Allocate(size_t bytes) {
+    const size_t classSize = GetClassSize(bytes);
+    HugePagePolicy policy;
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      policy = m_Policy;
+      std::vector<void *> &freeList = m_Free[classSize];
+      if (!freeList.empty()) {
+        void *p = freeList.back();
+        freeList.pop_back();
+        m_CachedBytes -= classSize;
+        return p;
+      }
+    }
+    return Map(classSize, policy);
+  }
+
+  void Deallocate(void *p, size_t bytes) {
+    if (p == nullptr)
+      return;
+    const size_t classSize = GetClassSize(bytes);
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      if (m_CachedBytes + classSize <= m_MaxCachedBytes) {
+        m_Free[classSize].push_back(p);
+        m_CachedBytes += classSize;
+        return;
+      }
+    }
+    Unmap(p, classSize);
+  }
+
+  // returns all cached buffers to the system
+  void Trim() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto &kv : m_Free)
+      for (void *p : kv.second)
+        Unmap(p, kv.first);
+    m_Free.clear();
+    m_CachedBytes = 0;
+  }
+
+  void SetMaxCachedBytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_MaxCachedBytes = bytes;
+  }
+
+  // to be set before the first large buffer is allocated
+  void SetHugePagePolicy(HugePagePolicy policy) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Policy = policy;
+  }
+
+  size_t GetCachedBytes() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_CachedBytes;
+  }
+
+private:
+  NdCopyBufferPool() = default;
+  NdCopyBufferPool(const NdCopyBufferPool &) = delete;
+  NdCopyBufferPool &operator=(const NdCopyBufferPool &) = delete;
+
+  static size_t GetClassSize(size_t bytes) {
+    size_t classSize = MinClassSize;
+    while (classSize < bytes)
+      classSize <<= 1;
+    return classSize;
+  }
+
+  // Map()/Unmap(): get a size class worth of memory from the system and give
+  // it back. buffers of at least one huge page are mapped 2MB aligned so that
+  // the kernel can back them with huge pages from the first byte on. policy
+  // is m_Policy as read under the lock.
+  void *Map(size_t classSize, HugePagePolicy policy) {
+#if defined(__unix__) || defined(__APPLE__)
+    if (classSize < HugePageSize || policy == NoHugePages) {
+      void *p = mmap(nullptr, classSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED)
+        throw std::bad_alloc();
+      return p;
+    }
+#if defined(MAP_HUGETLB)
+    if (policy == ExplicitHugePages) {
+      void *p = mmap(nullptr, classSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED)
+        return p;
+      // no hugetlbfs pages reserved: fall back to transparent huge pages
+    }
+#endif
+    const size_t mapSize = classSize + HugePageSize;
+    char *raw = static_cast<char *>(mmap(nullptr, mapSize,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == reinterpret_cast<char *>(MAP_FAILED))
+      throw std::bad_alloc();
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(raw);
+    const size_t lead =
+        (HugePageSize - (addr & (HugePageSize - 1))) & (HugePageSize - 1);
+    char *p = raw + lead;
+    if (lead > 0)
+      munmap(raw, lead);
+    if (mapSize - lead - classSize > 0)
+      munmap(p + classSize, mapSize - lead - classSize);
+#if defined(MADV_HUGEPAGE)
+    madvise(p, classSize, MADV_HUGEPAGE);
+#endif
+    return p;
+#else
+    void *p = std::malloc(classSize);
+    if (p == nullptr)
+      throw std::bad_alloc();
+    return p;
+#endif
+  }
+
+  static void Unmap(void *p, size_t classSize) {
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(p, classSize);
+#else
+    std::free(p);
+#endif
+  }
+
+  std::mutex m_Mutex;
+  std::map<size_t, std::vector<void *>> m_Free;
+  size_t m_CachedBytes = 0;
+  size_t m_MaxCachedBytes = size_t(1) << 30;
+  HugePagePolicy m_Policy = TransparentHugePages;
+};
+
+// NdCopyAllocator
+// std allocator on top of NdCopyBufferPool. construct() without arguments
+// default-initializes, i.e. leaves trivial types uninitialized, which is what
+// makes HugeBuffer::resize() skip the zero fill.
+template <class T>
+class NdCopyAllocator {
+public:
+  using value_type = T;
+
+  NdCopyAllocator() = default;
+  template <class U>
+  NdCopyAllocator(const NdCopyAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(
+        NdCopyBufferPool::Instance().Allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    NdCopyBufferPool::Instance().Deallocate(p, n * sizeof(T));
+  }
+
+  template <class U>
+  void construct(U *p) {
+    ::new (static_cast<void *>(p)) U;
+  }
+  template <class U, class... Args>
+  void construct(U *p, Args &&... args) {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  struct rebind {
+    using other = NdCopyAllocator<U>;
+  };
+};
+
+template <class T, class U>
+bool operator==(const NdCopyAllocator<T> &, const NdCopyAllocator<U> &) {
+  return true;
+}
+template <class T, class U>
+bool operator!=(const NdCopyAllocator<T> &, const NdCopyAllocator<U> &) {
+  return false;
+}
+
+using HugeBuffer = std::vector<char, NdCopyAllocator<char>>;
+//*************** End of HugeBuffer and its allocator ***************
+
+#endif
@@ -0,0 +1,163 @@
+//
+//  NDCopyChecksum.hpp
+//  src
+//
+
+#ifndef NDCOPYCHECKSUM_HPP
+#define NDCOPYCHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NDCOPY_HAVE_CRC32C_HW 1
+#endif
+
+//***************Start of NdCopyCrc32c() and its helpers ***************
+// CRC32C (Castagnoli), the checksum of iSCSI/ext4/SSE4.2. streaming: pass 0
+// for the first piece and the previous result for every following one, the
+// result over the concatenated pieces is the same as over one buffer.
+
+// NdCopyCrc32cTable(): helper function
+// slicing-by-8 tables of the software fallback, built on first use
+static const uint32_t *NdCopyCrc32cTable() {
+  static uint32_t table[8][256];
+  static bool init = [] {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1u)));
+      table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+      for (int t = 1; t < 8; t++)
+        table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+    return true;
+  }();
+  (void)init;
+  return &table[0][0];
+}
+
+// NdCopyCrc32cSw(): helper function
+// software CRC32C over the raw (non inverted) crc state, little endian hosts
+// process 8 bytes per step, anything else one byte per step
+static uint32_t NdCopyCrc32cSw(uint32_t crc, const char *data, size_t size) {
+  const uint32_t *t = NdCopyCrc32cTable();
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; size >= 8; size -= 8, p += 8) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    v ^= crc;
+    crc = t[7 * 256 + (v & 0xFF)] ^ t[6 * 256 + ((v >> 8) & 0xFF)] ^
+          t[5 * 256 + ((v >> 16) & 0xFF)] ^ t[4 * 256 + ((v >> 24) & 0xFF)] ^
+          t[3 * 256 + ((v >> 32) & 0xFF)] ^ t[2 * 256 + ((v >> 40) & 0xFF)] ^
+          t[1 * 256 + ((v >> 48) & 0xFF)] ^ t[0 * 256 + (v >> 56)];
+  }
+#endif
+  for (; size > 0; size--, p++)
+    crc = (crc >> 8) ^ t[(crc ^ *p) & 0xFF];
+  return crc;
+}
+
+#if defined(NDCOPY_HAVE_CRC32C_HW)
+// NdCopyCrc32cHw(): helper function
+// SSE4.2 crc32 instruction, 8 bytes per instruction. compiled for SSE4.2
+// regardless of the build flags and only called when the CPU has it.
+__attribute__((target("sse4.2"))) static uint32_t
+NdCopyCrc32cHw(uint32_t crc, const char *data, size_t size) {
+#if defined(__x86_64__)
+  uint64_t c = crc;
+  for (; size >= 8; size -= 8, data += 8) {
+    uint64_t v;
+    std::memcpy(&v, data, 8);
+    c = _mm_crc32_u64(c, v);
+  }
+  crc = static_cast<uint32_t>(c);
+#endif
+  for (; size >= 4; size -= 4, data += 4) {
+    uint32_t v;
+    std::memcpy(&v, data, 4);
+    crc = _mm_crc32_u32(crc, v);
+  }
+  for (; size > 0; size--, data++)
+    crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+  return crc;
+}
+#endif
+
+typedef uint32_t (*NdCopyCrc32cFunc)(uint32_t, const char *, size_t);
+
+// NdCopyCrc32cSelect(): helper function
+// picks the hardware implementation once, when the CPU supports it
+static NdCopyCrc32cFunc NdCopyCrc32cSelect() {
+#if defined(NDCOPY_HAVE_CRC32C_HW)
+  if (__builtin_cpu_supports("sse4.2"))
+    return NdCopyCrc32cHw;
+#endif
+  return NdCopyCrc32cSw;
+}
+
+// NdCopyCrc32c()
+// updates crc with size bytes of data
+static inline uint32_t NdCopyCrc32c(uint32_t crc, const char *data, size_t size) {
+  static const NdCopyCrc32cFunc impl = NdCopyCrc32cSelect();
+  return ~impl(~crc, data, size);
+}
+//*************** End of NdCopyCrc32c() and its helpers ***************
+
+//***************Start of NdCopyChecksumBox() ***************
+// NdCopyChecksumBox()
+// CRC32C of the elements of box boxStart/boxCount inside the dense buffer
+// holding bufStart/bufCount, taken over the bytes as stored and in memory
+// order. dimensions are listed slowest varying first, i.e. the way NdCopy()
+// walks the buffer: pass column-major dimensions reversed. this is what the
+// receiver runs over its copy to check NdCopyOptions::crc32c. the boxes are
+// Dims, spelled out as NDCopy.hpp includes this header before defining it.
+template <class T>
+uint32_t NdCopyChecksumBox(const char *buf,
+                           const std::vector<size_t> &bufStart,
+                           const std::vector<size_t> &bufCount,
+                           const std::vector<size_t> &boxStart,
+                           const std::vector<size_t> &boxCount,
+                           uint32_t crc = 0) {
+  const size_t numDims = bufCount.size();
+  if (numDims == 0)
+    return crc;
+  for (size_t i = 0; i < numDims; i++)
+    if (boxCount[i] == 0)
+      return crc;
+  std::vector<size_t> stride(numDims);
+  stride[numDims - 1] = sizeof(T);
+  for (size_t i = numDims - 1; i-- > 0;)
+    stride[i] = stride[i + 1] * bufCount[i + 1];
+  // the trailing dimensions that span the whole buffer make up one block
+  size_t blockDim = numDims - 1;
+  size_t blockSize = boxCount[blockDim] * sizeof(T);
+  while (blockDim > 0 && boxCount[blockDim] == bufCount[blockDim]) {
+    blockDim--;
+    blockSize *= boxCount[blockDim];
+  }
+  const char *base = buf;
+  for (size_t i = 0; i < numDims; i++)
+    base += (boxStart[i] - bufStart[i]) * stride[i];
+  std::vector<size_t> pos(blockDim, 0);
+  while (true) {
+    const char *block = base;
+    for (size_t i = 0; i < blockDim; i++)
+      block += pos[i] * stride[i];
+    crc = NdCopyCrc32c(crc, block, blockSize);
+    size_t d = blockDim;
+    while (d > 0 && ++pos[d - 1] == boxCount[d - 1])
+      pos[--d] = 0;
+    if (d == 0)
+      return crc;
+  }
+}
+//*************** End of NdCopyChecksumBox() ***************
+
+#endif
@@ -0,0 +1,239 @@
+//
+//  NDCopyDelta.hpp
+//  src
+//
+
+#ifndef NDCOPYDELTA_HPP
+#define NDCOPYDELTA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+
+// NdCopyDeltaRange
+// a byte range of the output buffer
+struct NdCopyDeltaRange {
+  size_t offset;
+  size_t size;
+};
+
+//***************Start of NdCopyDeltaHash() and its helpers ***************
+// The fingerprint of a delta block: 64 bits over 8 byte words, four words in
+// flight so that the multiplies overlap. every step is a bijection of the
+// lane state, so a block that differs in a single word always gets another
+// fingerprint; blocks that differ in several words collide with a chance of
+// about 2^-64. not a checksum for data at rest (see NdCopyCrc32c() for that).
+
+// NdCopyDeltaMix(): helper function
+static inline uint64_t NdCopyDeltaMix(uint64_t h, uint64_t w) {
+  h = (h ^ w) * 0x9E3779B97F4A7C15ull;
+  return (h << 29) | (h >> 35);
+}
+
+// NdCopyDeltaHash(): helper function
+// the fingerprint of size bytes of data, chained onto seed
+static uint64_t NdCopyDeltaHash(uint64_t seed, const char *data, size_t size) {
+  uint64_t h0 = seed ^ size, h1 = seed + 1, h2 = seed + 2, h3 = seed + 3;
+  uint64_t w[4];
+  for (; size >= 32; size -= 32, data += 32) {
+    std::memcpy(w, data, 32);
+    h0 = NdCopyDeltaMix(h0, w[0]);
+    h1 = NdCopyDeltaMix(h1, w[1]);
+    h2 = NdCopyDeltaMix(h2, w[2]);
+    h3 = NdCopyDeltaMix(h3, w[3]);
+  }
+  for (; size >= 8; size -= 8, data += 8) {
+    std::memcpy(w, data, 8);
+    h0 = NdCopyDeltaMix(h0, w[0]);
+  }
+  if (size > 0) {
+    w[0] = 0;
+    std::memcpy(w, data, size);
+    h1 = NdCopyDeltaMix(h1, w[0]);
+  }
+  uint64_t h = NdCopyDeltaMix(NdCopyDeltaMix(h0, h1), NdCopyDeltaMix(h2, h3));
+  h ^= h >> 32;
+  return h * 0xD6E8FEB86659FD93ull;
+}
+//*************** End of NdCopyDeltaHash() and its helpers ***************
+
+// NdCopyDelta
+// repeated NdCopy<T>() of one geometry into the same output buffer, e.g. a
+// field copied into a staging area every output step, that copies only what
+// changed since the previous step. the contiguous blocks of the copy are cut
+// (or, if small, grouped) into delta blocks of about blockBytes bytes, and
+// every step keeps a fingerprint of each delta block's input. a delta block
+// whose input has the fingerprint of the previous step is skipped, so only
+// the changed ones are read twice and written, and GetDirty() lists where in
+// the output they went.
+// the output buffer has to hold the result of the previous Copy() of this
+// handle: the skipped blocks are left as they are. the first Copy(), and the
+// first after Reset(), copies everything. deltas are tracked for row-major
+// ==> row-major copies (either endianess); copies involving col-major are
+// done in full and report the whole output dirty. a handle is not thread
+// safe.
+template <class T>
+class NdCopyDelta {
+public:
+  NdCopyDelta(const Dims &inStart, const Dims &inCount, bool inIsRowMajor,
+              bool inIsLittleEndian, const Dims &outStart,
+              const Dims &outCount, bool outIsRowMajor, bool outIsLittleEndian,
+              const Dims &inMemStart = Dims(), const Dims &inMemCount = Dims(),
+              const Dims &outMemStart = Dims(),
+              const Dims &outMemCount = Dims(), size_t blockBytes = 4096)
+      : m_InStart(inStart), m_InCount(inCount), m_InIsRowMajor(inIsRowMajor),
+        m_InIsLittleEndian(inIsLittleEndian), m_OutStart(outStart),
+        m_OutCount(outCount), m_OutIsRowMajor(outIsRowMajor),
+        m_OutIsLittleEndian(outIsLittleEndian), m_InMemStart(inMemStart),
+        m_InMemCount(inMemCount), m_OutMemStart(outMemStart),
+        m_OutMemCount(outMemCount) {
+    NdCopyMakePlan(m_Plan, inStart, inCount, inIsRowMajor, inIsLittleEndian,
+                   outStart, outCount, outIsRowMajor, outIsLittleEndian,
+                   inMemStart, inMemCount, outMemStart, outMemCount, false,
+                   sizeof(T));
+    // a delta block is a whole number of elements, a piece of a contiguous
+    // block or a group of whole ones
+    const size_t elms = std::max<size_t>(blockBytes / sizeof(T), 1);
+    m_PieceSize = elms * sizeof(T);
+    m_GroupSize = 1;
+    if (m_Plan.hasOvlp && m_Plan.IsSeqPadding() &&
+        m_Plan.blockSize < m_PieceSize) {
+      m_GroupSize = m_PieceSize / m_Plan.blockSize;
+      m_PieceSize = m_Plan.blockSize;
+    }
+  }
+
+  // Copy()
+  // one step: copies the delta blocks of in that changed since the previous
+  // step into out. returns what NdCopy() returns: 0, or 1 if the boxes do not
+  // overlap.
+  int Copy(const char *in, char *out) {
+    m_Dirty.clear();
+    m_NumBlocks = 0;
+    m_NumDirtyBlocks = 0;
+    if (!m_Plan.hasOvlp)
+      return 1;
+    if (!m_Plan.IsSeqPadding()) {
+      const int res =
+          NdCopy<T>(in, m_InStart, m_InCount, m_InIsRowMajor,
+                    m_InIsLittleEndian, out, m_OutStart, m_OutCount,
+                    m_OutIsRowMajor, m_OutIsLittleEndian, m_InMemStart,
+                    m_InMemCount, m_OutMemStart, m_OutMemCount);
+      m_Dirty.push_back(NdCopyDeltaRange{0, m_Plan.outBytes});
+      return res;
+    }
+    const NdCopyElmDesc elmDesc = NdCopyElmTraits<T>::Desc();
+    m_RevEndian =
+        m_InIsLittleEndian != m_OutIsLittleEndian ? &elmDesc : nullptr;
+    m_Out = out;
+    m_Group.clear();
+    m_GroupPrint = 0;
+    const char *inOvlpBase = in + m_Plan.inOvlpOffset;
+    char *outOvlpBase = out + m_Plan.outOvlpOffset;
+    NdCopyIterDFSeqPaddingOp(inOvlpBase, outOvlpBase, m_Plan.inOvlpGapSize,
+                             m_Plan.outOvlpGapSize, m_Plan.ovlpCount,
+                             m_Plan.minContDim, m_Plan.blockSize, *this);
+    if (!m_Group.empty())
+      EndGroup();
+    m_HasPrints = true;
+    return 0;
+  }
+
+  // the output ranges the last Copy() wrote, in ascending order with
+  // adjacent ranges merged
+  const std::vector<NdCopyDeltaRange> &GetDirty() const { return m_Dirty; }
+  size_t GetDirtyBytes() const {
+    size_t bytes = 0;
+    for (const NdCopyDeltaRange &range : m_Dirty)
+      bytes += range.size;
+    return bytes;
+  }
+  // delta blocks of the last Copy(), all and changed ones
+  size_t GetNumBlocks() const { return m_NumBlocks; }
+  size_t GetNumDirtyBlocks() const { return m_NumDirtyBlocks; }
+
+  // Reset()
+  // forgets the fingerprints, e.g. when the output buffer was overwritten;
+  // the next Copy() copies everything
+  void Reset() {
+    m_HasPrints = false;
+    m_Prints.clear();
+  }
+
+  // the walk of NdCopyIterDFSeqPaddingOp() hands every contiguous block here
+  void operator()(char *out, const char *in, size_t size) {
+    for (size_t done = 0; done < size; done += m_PieceSize) {
+      const size_t piece = std::min(m_PieceSize, size - done);
+      m_Group.push_back(Piece{out + done, in + done, piece});
+      m_GroupPrint = NdCopyDeltaHash(m_GroupPrint, in + done, piece);
+      if (m_Group.size() == m_GroupSize)
+        EndGroup();
+    }
+  }
+
+private:
+  struct Piece {
+    char *out;
+    const char *in;
+    size_t size;
+  };
+
+  // EndGroup(): helper function
+  // compares the fingerprint of the collected delta block with the previous
+  // step's and copies the block if it changed
+  void EndGroup() {
+    const size_t k = m_NumBlocks++;
+    if (m_Prints.size() <= k)
+      m_Prints.resize(k + 1);
+    if (!m_HasPrints || m_Prints[k] != m_GroupPrint) {
+      m_Prints[k] = m_GroupPrint;
+      m_NumDirtyBlocks++;
+      for (const Piece &piece : m_Group) {
+        if (m_RevEndian)
+          NdCopyRevEndianElms(piece.out, piece.in, piece.size / sizeof(T),
+                              sizeof(T), *m_RevEndian);
+        else
+          NdCopyBlock(piece.out, piece.in, piece.size);
+        MarkDirty(static_cast<size_t>(piece.out - m_Out), piece.size);
+      }
+    }
+    m_Group.clear();
+    m_GroupPrint = 0;
+  }
+
+  // MarkDirty(): helper function
+  void MarkDirty(size_t offset, size_t size) {
+    if (!m_Dirty.empty() &&
+        m_Dirty.back().offset + m_Dirty.back().size == offset)
+      m_Dirty.back().size += size;
+    else
+      m_Dirty.push_back(NdCopyDeltaRange{offset, size});
+  }
+
+  const Dims m_InStart, m_InCount;
+  const bool m_InIsRowMajor, m_InIsLittleEndian;
+  const Dims m_OutStart, m_OutCount;
+  const bool m_OutIsRowMajor, m_OutIsLittleEndian;
+  const Dims m_InMemStart, m_InMemCount, m_OutMemStart, m_OutMemCount;
+
+  NdCopyPlan m_Plan;
+  size_t m_PieceSize;
+  size_t m_GroupSize;
+
+  bool m_HasPrints = false;
+  std::vector<uint64_t> m_Prints;
+  std::vector<NdCopyDeltaRange> m_Dirty;
+  size_t m_NumBlocks = 0;
+  size_t m_NumDirtyBlocks = 0;
+
+  // state of the running Copy()
+  const NdCopyElmDesc *m_RevEndian = nullptr;
+  char *m_Out = nullptr;
+  std::vector<Piece> m_Group;
+  uint64_t m_GroupPrint = 0;
+};
+
+#endif
@@ -0,0 +1,187 @@
+//
+//  NDCopyEndian.hpp
+//  src
+//
+
+#ifndef NDCOPYENDIAN_HPP
+#define NDCOPYENDIAN_HPP
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "core/NdCpy/NDCopySimd.hpp"
+
+//***************Start of element descriptors and rev-endian kernels *********
+// NdCopyElmDesc
+// describes which bytes of an element have to be reversed when the element
+// is copied between different endianesses.
+// - fields empty: the element is a sequence of swapUnit sized scalars, e.g.
+//   sizeof(T) for plain numbers, sizeof(double) for std::complex<double>.
+// - otherwise: every (offset, width) field is reversed on its own, bytes not
+//   covered by any field (chars, padding) are copied as they are.
+struct NdCopyElmDesc {
+  size_t swapUnit;
+  std::vector<std::pair<size_t, size_t>> fields;
+
+  explicit NdCopyElmDesc(size_t swapUnit_ = 1) : swapUnit(swapUnit_) {}
+  NdCopyElmDesc(std::vector<std::pair<size_t, size_t>> fields_)
+      : swapUnit(0), fields(std::move(fields_)) {}
+};
+
+// NdCopyElmTraits
+// element descriptor used by NdCopy<T>() and friends. specialize it for
+// structs, e.g. for struct P { float x; int32_t id; char tag[4]; }:
+//   template <> struct NdCopyElmTraits<P> {
+//     static NdCopyElmDesc Desc() {
+//       return NdCopyElmDesc({{offsetof(P, x), 4}, {offsetof(P, id), 4}});
+//     }
+//   };
+template <class T>
+struct NdCopyElmTraits {
+  static NdCopyElmDesc Desc() { return NdCopyElmDesc(sizeof(T)); }
+};
+
+template <class T>
+struct NdCopyElmTraits<std::complex<T>> {
+  static NdCopyElmDesc Desc() { return NdCopyElmDesc(sizeof(T)); }
+};
+
+// NdCopyRevUnits(): helper function
+// copies numUnits Unit sized scalars with the bytes of each one reversed.
+// written as load/bswap/store so that the compiler vectorizes it; with SSSE3
+// the bulk is done explicitly with one byte shuffle per 16 bytes, with AVX2
+// and AVX-512BW per 32 and 64 bytes (the shuffles work within 16 byte lanes,
+// which a unit never crosses).
+template <size_t Unit>
+static inline void NdCopyRevUnits(char *out, const char *in, size_t numUnits) {
+  size_t i = 0;
+#if defined(__SSSE3__)
+  const size_t unitsPerVec = 16 / Unit;
+  // the same 16 byte pattern in every lane
+  alignas(64) char mask[64];
+  for (size_t b = 0; b < 64; b++)
+    mask[b] = static_cast<char>((b % 16 / Unit) * Unit + Unit - 1 - b % Unit);
+  const __m128i shuffle = _mm_load_si128(reinterpret_cast<__m128i *>(mask));
+#if defined(__AVX512BW__)
+  const __m512i shuffle512 =
+      _mm512_load_si512(reinterpret_cast<const __m512i *>(mask));
+  for (; i + 4 * unitsPerVec <= numUnits; i += 4 * unitsPerVec) {
+    __m512i v =
+        _mm512_loadu_si512(reinterpret_cast<const __m512i *>(in + i * Unit));
+    _mm512_storeu_si512(reinterpret_cast<__m512i *>(out + i * Unit),
+                        _mm512_shuffle_epi8(v, shuffle512));
+  }
+#elif defined(__AVX2__)
+  const __m256i shuffle256 =
+      _mm256_load_si256(reinterpret_cast<const __m256i *>(mask));
+  for (; i + 2 * unitsPerVec <= numUnits; i += 2 * unitsPerVec) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i * Unit));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * Unit),
+                        _mm256_shuffle_epi8(v, shuffle256));
+  }
+#endif
+  for (; i + unitsPerVec <= numUnits; i += unitsPerVec) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * Unit));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * Unit),
+                     _mm_shuffle_epi8(v, shuffle));
+  }
+#endif
+  for (; i < numUnits; i++) {
+    if (Unit == 2) {
+      uint16_t v;
+      std::memcpy(&v, in + i * 2, 2);
+      v = static_cast<uint16_t>((v >> 8) | (v << 8));
+      std::memcpy(out + i * 2, &v, 2);
+    } else if (Unit == 4) {
+      uint32_t v;
+      std::memcpy(&v, in + i * 4, 4);
+      v = __builtin_bswap32(v);
+      std::memcpy(out + i * 4, &v, 4);
+    } else {
+      uint64_t v;
+      std::memcpy(&v, in + i * 8, 8);
+      v = __builtin_bswap64(v);
+      std::memcpy(out + i * 8, &v, 8);
+    }
+  }
+}
+
+// NdCopyRevBytes(): helper function
+// reverses the bytes of one field of any width
+static inline void NdCopyRevBytes(char *out, const char *in, size_t width) {
+  for (size_t j = 0; j < width; j++)
+    out[j] = in[width - 1 - j];
+}
+
+// NdCopyRevEndianElms(): helper function
+// copies numElms contiguous elements converting them to the other endianess
+// according to elmDesc, in a single pass. the byte swaps of the library
+// build come from the selected ISA level (NDCopySimd.hpp).
+static void NdCopyRevEndianElms(char *out, const char *in, size_t numElms,
+                                size_t elmSize, const NdCopyElmDesc &elmDesc) {
+  if (elmDesc.fields.empty()) {
+    const size_t numBytes = numElms * elmSize;
+    switch (elmDesc.swapUnit) {
+    case 1:
+      std::memcpy(out, in, numBytes);
+      break;
+#if defined(NDCOPY_SIMD_DISPATCH)
+    case 2:
+      NdCopySimd().revUnits2(out, in, numBytes / 2);
+      break;
+    case 4:
+      NdCopySimd().revUnits4(out, in, numBytes / 4);
+      break;
+    case 8:
+      NdCopySimd().revUnits8(out, in, numBytes / 8);
+      break;
+#else
+    case 2:
+      NdCopyRevUnits<2>(out, in, numBytes / 2);
+      break;
+    case 4:
+      NdCopyRevUnits<4>(out, in, numBytes / 4);
+      break;
+    case 8:
+      NdCopyRevUnits<8>(out, in, numBytes / 8);
+      break;
+#endif
+    default:
+      for (size_t i = 0; i < numBytes; i += elmDesc.swapUnit)
+        NdCopyRevBytes(out + i, in + i, elmDesc.swapUnit);
+    }
+    return;
+  }
+  for (size_t i = 0; i < numElms; i++) {
+    std::memcpy(out, in, elmSize);
+    for (const auto &field : elmDesc.fields)
+      NdCopyRevBytes(out + field.first, in + field.first, field.second);
+    in += elmSize;
+    out += elmSize;
+  }
+}
+
+// NdCopyRevEndianElm(): helper function
+// single element version of NdCopyRevEndianElms() for the kernels that move
+// one element at a time
+static inline void NdCopyRevEndianElm(char *out, const char *in,
+                                      size_t elmSize,
+                                      const NdCopyElmDesc &elmDesc) {
+  if (elmDesc.fields.empty() && elmDesc.swapUnit == elmSize)
+    NdCopyRevBytes(out, in, elmSize);
+  else
+    NdCopyRevEndianElms(out, in, 1, elmSize, elmDesc);
+}
+//*************** End of element descriptors and rev-endian kernels *********
+
+#endif
@@ -0,0 +1,272 @@
+//
+//  NDCopyFused.hpp
+//  src
+//
+
+#ifndef NDCOPYFUSED_HPP
+#define NDCOPYFUSED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "core/NdCpy/NDCopyBlock.hpp"
+#include "core/NdCpy/NDCopyChecksum.hpp"
+#include "core/NdCpy/NDCopyEndian.hpp"
+
+//***************Start of work fused into the copy pass ***************
+// Everything in here is computed over the copied elements while they are
+// being copied, chunk by chunk, so each chunk is still in L1 when it is
+// looked at again and the data is only streamed through memory once.
+
+// NdCopyHostIsLittleEndian(): helper function
+inline bool NdCopyHostIsLittleEndian() {
+#if defined(__BYTE_ORDER__)
+  return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+#else
+  const unsigned short one = 1;
+  return *reinterpret_cast<const unsigned char *>(&one) == 1;
+#endif
+}
+
+// NdCopyStats
+// per-block characteristics of the copied elements, taken over the values
+// as seen in host byte order, whatever the input and output endianess.
+// NaNs are counted but left out of min, max and sum; min/max are only
+// meaningful when count > nanCount. Computed for arithmetic types only,
+// for other element types only count is filled in.
+template <class T>
+struct NdCopyStats {
+  T min;
+  T max;
+  double sum;
+  size_t count;
+  size_t nanCount;
+
+  NdCopyStats() { Reset(); }
+  void Reset() {
+    ResetMinMax(std::integral_constant<bool, std::is_arithmetic<T>::value>());
+    sum = 0;
+    count = 0;
+    nanCount = 0;
+  }
+
+private:
+  void ResetMinMax(std::true_type) {
+    typedef std::numeric_limits<T> limits;
+    min = limits::has_infinity ? limits::infinity() : limits::max();
+    max = limits::has_infinity ? -limits::infinity() : limits::lowest();
+  }
+  void ResetMinMax(std::false_type) {}
+};
+
+// NdCopyOptions
+// optional work fused into the copy pass of NdCopy(). every member left
+// null is skipped at no cost.
+template <class T>
+struct NdCopyOptions {
+  // accumulates statistics of the copied elements (not reset by NdCopy(),
+  // so it can be carried over several copies)
+  NdCopyStats<T> *stats = nullptr;
+  // CRC32C of the written overlap, over its bytes as stored in the output
+  // and in output memory order, so the receiver can verify it on its own
+  // copy with NdCopyChecksumBox(). streaming like NdCopyCrc32c(): set it to
+  // 0 before the first copy.
+  uint32_t *crc32c = nullptr;
+  // value (in host byte order) written to every element of the output
+  // buffer that the overlap does not cover, in the same pass as the copy,
+  // so each output byte is written once. the output is filled even when
+  // there is no overlap at all.
+  const T *fill = nullptr;
+
+  bool IsFused() const {
+    return stats != nullptr || crc32c != nullptr || fill != nullptr;
+  }
+  // whether the fused work has to see the output in its memory order
+  bool NeedsOutOrder() const { return crc32c != nullptr || fill != nullptr; }
+};
+
+// NdCopyFillValue(): helper function
+// the bytes of fill as stored in an output buffer of the given endianess
+template <class T>
+static void NdCopyFillValue(char *value, const T &fill,
+                            bool outIsLittleEndian) {
+  if (outIsLittleEndian == NdCopyHostIsLittleEndian())
+    std::memcpy(value, &fill, sizeof(T));
+  else
+    NdCopyRevEndianElms(value, reinterpret_cast<const char *>(&fill), 1,
+                        sizeof(T), NdCopyElmTraits<T>::Desc());
+}
+
+// NdCopyFillBytes(): helper function
+// fills bytes (a whole number of elements) with copies of value. a value made
+// of one repeated byte is a memset; anything else is laid out once and then
+// repeated from a pattern of up to 4KB at the start of the range, which stays
+// in L1 while the rest is written.
+static inline void NdCopyFillBytes(char *out, size_t bytes,
+                                   const char *value, size_t elmSize) {
+  if (bytes == 0)
+    return;
+  bool isByte = true;
+  for (size_t i = 1; i < elmSize; i++)
+    isByte = isByte && value[i] == value[0];
+  if (isByte) {
+    std::memset(out, value[0], bytes);
+    return;
+  }
+  std::memcpy(out, value, elmSize);
+  size_t pattern = elmSize;
+  while (pattern < bytes && pattern * 2 <= 4096) {
+    const size_t n = pattern < bytes - pattern ? pattern : bytes - pattern;
+    std::memcpy(out + pattern, out, n);
+    pattern += n;
+  }
+  for (size_t done = pattern; done < bytes; done += pattern) {
+    const size_t n = pattern < bytes - done ? pattern : bytes - done;
+    std::memcpy(out + done, out, n);
+  }
+}
+
+// NdCopyReduceStats(): helper function
+// min/max/sum/NaN count over numElms contiguous host order values. written
+// branch free with four independent lanes, so that the compiler turns it into
+// SIMD min/max/add reductions. a NaN fails every comparison, which keeps it
+// out of min and max without a branch.
+template <class T>
+static void NdCopyReduceStats(const char *data, size_t numElms,
+                              NdCopyStats<T> &stats, std::true_type) {
+  const size_t L = 4;
+  T mn[L], mx[L];
+  double sm[L];
+  size_t nan[L];
+  for (size_t l = 0; l < L; l++) {
+    mn[l] = stats.min;
+    mx[l] = stats.max;
+    sm[l] = 0;
+    nan[l] = 0;
+  }
+  size_t i = 0;
+  for (; i + L <= numElms; i += L) {
+    T v[L];
+    std::memcpy(v, data + i * sizeof(T), sizeof(v));
+    for (size_t l = 0; l < L; l++) {
+      const bool isNum = v[l] == v[l];
+      mn[l] = v[l] < mn[l] ? v[l] : mn[l];
+      mx[l] = v[l] > mx[l] ? v[l] : mx[l];
+      sm[l] += isNum ? static_cast<double>(v[l]) : 0.0;
+      nan[l] += !isNum;
+    }
+  }
+  for (; i < numElms; i++) {
+    T v;
+    std::memcpy(&v, data + i * sizeof(T), sizeof(T));
+    const bool isNum = v == v;
+    mn[0] = v < mn[0] ? v : mn[0];
+    mx[0] = v > mx[0] ? v : mx[0];
+    sm[0] += isNum ? static_cast<double>(v) : 0.0;
+    nan[0] += !isNum;
+  }
+  for (size_t l = 0; l < L; l++) {
+    stats.min = mn[l] < stats.min ? mn[l] : stats.min;
+    stats.max = mx[l] > stats.max ? mx[l] : stats.max;
+    stats.sum += sm[l];
+    stats.nanCount += nan[l];
+  }
+  stats.count += numElms;
+}
+
+template <class T>
+static void NdCopyReduceStats(const char *, size_t numElms,
+                              NdCopyStats<T> &stats, std::false_type) {
+  stats.count += numElms;
+}
+
+// NdCopyFusedOp
+// block operation used by the fused kernels of NdCopy(): copies (or converts
+// the endianess of) a contiguous block and runs the requested reductions
+// over it. the reductions read whichever side of the block is in host byte
+// order.
+template <class T>
+class NdCopyFusedOp {
+public:
+  // chunk size in bytes: small enough to stay in L1 between the copy and
+  // the reductions, and a whole number of elements
+  static const size_t ChunkSize =
+      sizeof(T) < 4096 ? 4096 / sizeof(T) * sizeof(T) : sizeof(T);
+
+  // out/outBytes: the whole output buffer, only used by the fill
+  NdCopyFusedOp(const NdCopyOptions<T> &options,
+                const NdCopyElmDesc *revEndian, bool inIsLittleEndian,
+                bool outIsLittleEndian, char *out = nullptr,
+                size_t outBytes = 0)
+      : m_Options(options), m_RevEndian(revEndian),
+        m_InIsHost(inIsLittleEndian == NdCopyHostIsLittleEndian()),
+        m_OutIsHost(outIsLittleEndian == NdCopyHostIsLittleEndian()),
+        m_FillPos(out), m_FillEnd(out + outBytes) {
+    if (options.fill)
+      NdCopyFillValue(m_FillValue, *options.fill, outIsLittleEndian);
+  }
+
+  // blocks arrive in output memory order when a fill is requested; whatever
+  // lies between the end of the previous block and this one is not covered
+  // by the overlap (the output gaps of the traversal) and is filled first
+  void operator()(char *out, const char *in, size_t bytes) {
+    if (m_Options.fill) {
+      NdCopyFillBytes(m_FillPos, out - m_FillPos, m_FillValue, sizeof(T));
+      m_FillPos = out + bytes;
+    }
+    while (bytes > 0) {
+      const size_t n = bytes < ChunkSize ? bytes : ChunkSize;
+      if (m_RevEndian)
+        NdCopyRevEndianElms(out, in, n / sizeof(T), sizeof(T), *m_RevEndian);
+      else
+        NdCopyBlock(out, in, n);
+      if (m_Options.stats)
+        NdCopyReduceStats<T>(HostOrder(out, in, n), n / sizeof(T),
+                             *m_Options.stats,
+                             std::integral_constant<bool,
+                                 std::is_arithmetic<T>::value>());
+      if (m_Options.crc32c)
+        *m_Options.crc32c = NdCopyCrc32c(*m_Options.crc32c, out, n);
+      out += n;
+      in += n;
+      bytes -= n;
+    }
+  }
+
+  // fills the output after the last block, to be called once the traversal
+  // is done
+  void FillRest() {
+    if (m_Options.fill)
+      NdCopyFillBytes(m_FillPos, m_FillEnd - m_FillPos, m_FillValue,
+                      sizeof(T));
+  }
+
+private:
+  // HostOrder(): the chunk in host byte order, swapped into m_Scratch when
+  // neither side is
+  const char *HostOrder(const char *out, const char *in, size_t n) {
+    if (m_OutIsHost)
+      return out;
+    if (m_InIsHost)
+      return in;
+    NdCopyRevEndianElms(m_Scratch, out, n / sizeof(T), sizeof(T),
+                        m_ElmDesc);
+    return m_Scratch;
+  }
+
+  const NdCopyOptions<T> &m_Options;
+  const NdCopyElmDesc *m_RevEndian;
+  const NdCopyElmDesc m_ElmDesc = NdCopyElmTraits<T>::Desc();
+  const bool m_InIsHost;
+  const bool m_OutIsHost;
+  char *m_FillPos;
+  char *const m_FillEnd;
+  char m_FillValue[sizeof(T)];
+  char m_Scratch[ChunkSize];
+};
+//*************** End of work fused into the copy pass ***************
+
+#endif
@@ -0,0 +1,206 @@
+//
+//  NDCopyHalo.hpp
+//  src
+//
+
+#ifndef NDCOPYHALO_HPP
+#define NDCOPYHALO_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyPack.hpp"
+#include "core/NdCpy/NDCopyTuning.hpp"
+
+// a neighbour of a block of a domain decomposed grid, as the direction it
+// lies in: -1, 0 or +1 per logical dimension. one nonzero entry is a face
+// neighbour, two an edge neighbour, three a corner neighbour (in 3D).
+using NdCopyHaloDir = std::vector<int>;
+
+// NdCopyHaloNeighbors()
+// all directions of a block of numDims dimensions with at most maxNonZero
+// nonzero entries, in lexicographic order: 1 for the faces only, 2 for faces
+// and edges, numDims for everything. callers drop the directions that lead
+// out of a non periodic domain.
+inline std::vector<NdCopyHaloDir> NdCopyHaloNeighbors(size_t numDims,
+                                                      size_t maxNonZero) {
+  std::vector<NdCopyHaloDir> dirs;
+  NdCopyHaloDir dir(numDims, -1);
+  while (numDims > 0) {
+    size_t nonZero = 0;
+    for (int v : dir)
+      nonZero += v != 0;
+    if (nonZero > 0 && nonZero <= maxNonZero)
+      dirs.push_back(dir);
+    size_t d = numDims;
+    while (d > 0 && dir[d - 1] == 1)
+      dir[--d] = -1;
+    if (d == 0)
+      break;
+    dir[d - 1]++;
+  }
+  return dirs;
+}
+
+// NdCopyHaloPlan
+// the halo exchange of one block of a domain decomposed grid, built once and
+// reused for every exchange. the buffer holds the block's count interior
+// elements per dimension with ghost[d] ghost layers on both sides of
+// dimension d, i.e. count[d] + 2 * ghost[d] elements, in local coordinates
+// (the interior starts at ghost). for every neighbour direction the plan
+// holds the interior region the neighbour needs (the send region: the
+// ghost[d] layers next to the face, edge or corner) and the ghost region it
+// fills (the recv region: the ghost layers beyond it), as NdCopyPackType.
+// NdCopyHaloPack() packs all send regions into one message buffer,
+// neighbour i's part contiguous at GetOffset(i), ready to be sent on its
+// own; NdCopyHaloUnpack() scatters a buffer of the same layout, neighbour
+// i's part being what that neighbour sent towards us, into the ghost
+// regions. the send and recv regions of a direction have the same shape, so
+// both buffers share the offsets; blocks of equal count exchange messages
+// of matching size. the plan is invalid if a direction is malformed, leads
+// along a dimension without ghost layers, or ghost layers are wider than
+// the interior.
+class NdCopyHaloPlan {
+public:
+  NdCopyHaloPlan(const Dims &count, const Dims &ghost,
+                 const std::vector<NdCopyHaloDir> &neighbors, size_t elmSize,
+                 bool isRowMajor = true)
+      : m_Neighbors(neighbors) {
+    const size_t numDims = count.size();
+    if (numDims == 0 || ghost.size() != numDims || elmSize == 0)
+      return;
+    Dims bufStart(numDims, 0), bufCount(numDims);
+    for (size_t d = 0; d < numDims; d++) {
+      if (count[d] == 0 || ghost[d] > count[d])
+        return;
+      bufCount[d] = count[d] + 2 * ghost[d];
+    }
+    Dims sendStart(numDims), recvStart(numDims), regionCount(numDims);
+    size_t offset = 0;
+    for (const NdCopyHaloDir &dir : neighbors) {
+      if (dir.size() != numDims)
+        return;
+      for (size_t d = 0; d < numDims; d++) {
+        if (dir[d] < -1 || dir[d] > 1 || (dir[d] != 0 && ghost[d] == 0))
+          return;
+        regionCount[d] = dir[d] == 0 ? count[d] : ghost[d];
+        sendStart[d] = dir[d] > 0 ? count[d] : ghost[d];
+        recvStart[d] = dir[d] < 0 ? 0 : dir[d] > 0 ? ghost[d] + count[d]
+                                                   : ghost[d];
+      }
+      m_Send.emplace_back(bufStart, bufCount, sendStart, regionCount, elmSize,
+                          isRowMajor);
+      m_Recv.emplace_back(bufStart, bufCount, recvStart, regionCount, elmSize,
+                          isRowMajor);
+      m_Offsets.push_back(offset);
+      offset += m_Send.back().GetPackedBytes();
+    }
+    m_TotalBytes = offset;
+    m_Valid = true;
+  }
+
+  bool IsValid() const { return m_Valid; }
+  size_t GetNumNeighbors() const { return m_Neighbors.size(); }
+  const NdCopyHaloDir &GetNeighbor(size_t i) const { return m_Neighbors[i]; }
+
+  // layout of the message buffers
+  size_t GetOffset(size_t i) const { return m_Offsets[i]; }
+  size_t GetBytes(size_t i) const { return m_Send[i].GetPackedBytes(); }
+  size_t GetTotalBytes() const { return m_TotalBytes; }
+
+  // the regions of neighbour i, e.g. to pack or unpack a single message
+  // with NdCopyPack()/NdCopyUnpack() as it arrives
+  const NdCopyPackType &GetSendType(size_t i) const { return m_Send[i]; }
+  const NdCopyPackType &GetRecvType(size_t i) const { return m_Recv[i]; }
+
+private:
+  bool m_Valid = false;
+  std::vector<NdCopyHaloDir> m_Neighbors;
+  std::vector<NdCopyPackType> m_Send;
+  std::vector<NdCopyPackType> m_Recv;
+  std::vector<size_t> m_Offsets;
+  size_t m_TotalBytes = 0;
+};
+
+int NdCopyHaloPack(const NdCopyHaloPlan &plan, const char *buf, char *send,
+                   size_t numThreads = 0);
+int NdCopyHaloUnpack(const NdCopyHaloPlan &plan, const char *recv, char *buf,
+                     size_t numThreads = 0);
+
+//***************Start of NdCopyHaloPack(), NdCopyHaloUnpack() and their helpers ***************
+// Both run the pack kernels of NDCopyPack.hpp over every region of the plan.
+// exchanges of NdCopyTuning::packParallelMinBytes and more are split over
+// several threads by bytes of the whole message buffer rather than region by
+// region, so that the few big face regions and the many small edge and
+// corner regions spread evenly; a thread takes the outermost loop indices of
+// every region whose first byte falls into its share.
+
+// NdCopyHaloUnits(): helper function
+// outermost loop indices of a region, as NdCopyPackRange() counts them
+static size_t NdCopyHaloUnits(const NdCopyPackType &type) {
+  return type.GetNumOuter() == 0 ? type.GetPackedBytes()
+                                 : type.GetOuterCount(0);
+}
+
+// NdCopyHaloRange(): helper function
+// packs/unpacks bytes [lo, hi) of the message buffer, rounded to outermost
+// loop indices of the regions
+template <bool Pack>
+static void NdCopyHaloRange(const NdCopyHaloPlan &plan, char *buf, char *msg,
+                            size_t lo, size_t hi) {
+  for (size_t i = 0; i < plan.GetNumNeighbors(); i++) {
+    const size_t offset = plan.GetOffset(i);
+    const size_t bytes = plan.GetBytes(i);
+    if (offset + bytes <= lo || offset >= hi)
+      continue;
+    const NdCopyPackType &type =
+        Pack ? plan.GetSendType(i) : plan.GetRecvType(i);
+    const size_t units = NdCopyHaloUnits(type);
+    const size_t unitBytes = bytes / units;
+    const size_t first =
+        lo <= offset ? 0 : (lo - offset + unitBytes - 1) / unitBytes;
+    const size_t last = hi >= offset + bytes
+                            ? units
+                            : (hi - offset + unitBytes - 1) / unitBytes;
+    NdCopyPackRange<Pack>(type, buf, msg + offset, first, last);
+  }
+}
+
+// NdCopyHaloRun(): helper function
+// runs NdCopyHaloRange() over the bytes of the message buffer
+template <bool Pack>
+static int NdCopyHaloRun(const NdCopyHaloPlan &plan, char *buf, char *msg,
+                         size_t numThreads) {
+  if (!plan.IsValid())
+    return -1;
+  const size_t total = plan.GetTotalBytes();
+  NdCopyParallelFor(total, total, numThreads, [&](size_t lo, size_t hi) {
+    NdCopyHaloRange<Pack>(plan, buf, msg, lo, hi);
+  });
+  return 0;
+}
+
+// NdCopyHaloPack()
+// copies the send regions of all neighbours of plan out of buf into send
+// (plan.GetTotalBytes() bytes), neighbour i's message at plan.GetOffset(i).
+// numThreads 0 picks one thread for small exchanges and several for big
+// ones. returns 0, or -1 for an invalid plan.
+inline int NdCopyHaloPack(const NdCopyHaloPlan &plan, const char *buf,
+                          char *send, size_t numThreads) {
+  return NdCopyHaloRun<true>(plan, const_cast<char *>(buf), send,
+                             numThreads);
+}
+
+// NdCopyHaloUnpack()
+// fills the ghost regions of buf from recv, laid out like the send buffer,
+// neighbour i's message at plan.GetOffset(i)
+inline int NdCopyHaloUnpack(const NdCopyHaloPlan &plan, const char *recv,
+                            char *buf, size_t numThreads) {
+  return NdCopyHaloRun<false>(plan, buf, const_cast<char *>(recv),
+                              numThreads);
+}
+//*************** End of NdCopyHaloPack(), NdCopyHaloUnpack() and their helpers ***************
+
+#endif
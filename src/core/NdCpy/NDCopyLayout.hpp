@@ -0,0 +1,477 @@
+//
+//  NDCopyLayout.hpp
+//  src
+//
+
+#ifndef NDCOPYLAYOUT_HPP
+#define NDCOPYLAYOUT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyEndian.hpp"
+#include "core/NdCpy/NDCopySimd.hpp"
+#include "core/NdCpy/NDCopyTuning.hpp"
+
+// signed byte strides, one per dimension
+using Strides = std::vector<std::ptrdiff_t>;
+
+template <class T>
+int NdCopyPermute(const char *in, const Dims &inStart, const Dims &inCount,
+                  const Dims &inAxisOrder, const bool inIsLittleEndian,
+                  char *out, const Dims &outStart, const Dims &outCount,
+                  const Dims &outAxisOrder, const bool outIsLittleEndian,
+                  const Dims &inMemStart = Dims(),
+                  const Dims &inMemCount = Dims(),
+                  const Dims &outMemStart = Dims(),
+                  const Dims &outMemCount = Dims());
+
+template <class T>
+int NdCopyStrided(const char *in, const Dims &inStart, const Dims &inCount,
+                  const Strides &inByteStride, const bool inIsLittleEndian,
+                  char *out, const Dims &outStart, const Dims &outCount,
+                  const Strides &outByteStride, const bool outIsLittleEndian);
+
+//***************Start of NdCopyPermute(), NdCopyStrided() and their helpers ***************
+// An axis order lists the logical dimensions in the order they are laid out
+// in memory, slowest varying first. {0,1,...,n-1} is row major,
+// {n-1,...,1,0} is column major, {0,3,1,2} stores a logical NHWC array as
+// NCHW. Start and count values are always given in logical order, so both
+// sides of a copy share the same coordinate system.
+
+// NdCopyRowMajorOrder()/NdCopyColMajorOrder(): axis orders of the two
+// classic layouts, for callers that mix them with permuted ones
+inline Dims NdCopyRowMajorOrder(size_t numDims) {
+  Dims order(numDims);
+  for (size_t i = 0; i < numDims; i++)
+    order[i] = i;
+  return order;
+}
+
+inline Dims NdCopyColMajorOrder(size_t numDims) {
+  Dims order(numDims);
+  for (size_t i = 0; i < numDims; i++)
+    order[i] = numDims - 1 - i;
+  return order;
+}
+
+// NdCopyIsAxisOrder(): helper function
+// true if axisOrder is a permutation of 0..numDims-1
+static bool NdCopyIsAxisOrder(const Dims &axisOrder, size_t numDims) {
+  if (axisOrder.size() != numDims)
+    return false;
+  std::vector<bool> seen(numDims, false);
+  for (size_t i = 0; i < numDims; i++) {
+    if (axisOrder[i] >= numDims || seen[axisOrder[i]])
+      return false;
+    seen[axisOrder[i]] = true;
+  }
+  return true;
+}
+
+// NdCopyCopyElm(): helper function
+// copy one element as is
+static inline void NdCopyCopyElm(char *out, const char *in, size_t elmSize) {
+  std::memcpy(out, in, elmSize);
+}
+
+// NdCopyFlipNegStrides(): helper function
+// a dimension walked backwards on both sides holds the same elements in the
+// same relative order as when it is walked forwards from its other end.
+// flipping it lets the contiguous block detection see through views that
+// are mirrored identically on input and output.
+static void NdCopyFlipNegStrides(const char *&inBase, char *&outBase,
+                                 const Dims &count, Strides &inStride,
+                                 Strides &outStride) {
+  for (size_t i = 0; i < count.size(); i++) {
+    if (inStride[i] < 0 && outStride[i] < 0) {
+      const std::ptrdiff_t back = static_cast<std::ptrdiff_t>(count[i] - 1);
+      inBase += back * inStride[i];
+      outBase += back * outStride[i];
+      inStride[i] = -inStride[i];
+      outStride[i] = -outStride[i];
+    }
+  }
+}
+
+// NdCopyOrderLoops(): helper function
+// Turns the overlap of a strided copy into the cheapest loop nest:
+// 1. drops dimensions with a count of 1,
+// 2. sorts dimensions by output stride so that the output is written in its
+//    own memory order (sequential stores),
+// 3. merges neighbouring dimensions that are contiguous on both sides, which
+//    recovers the largest contiguous block whenever the strides are dense.
+static void NdCopyOrderLoops(Dims &count, Strides &inStride,
+                             Strides &outStride) {
+  auto absStride = [](std::ptrdiff_t s) { return s < 0 ? -s : s; };
+  Dims order;
+  for (size_t i = 0; i < count.size(); i++)
+    if (count[i] != 1)
+      order.push_back(i);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (absStride(outStride[a]) != absStride(outStride[b]))
+      return absStride(outStride[a]) > absStride(outStride[b]);
+    return absStride(inStride[a]) > absStride(inStride[b]);
+  });
+
+  Dims newCount;
+  Strides newInStride, newOutStride;
+  for (size_t k = 0; k < order.size(); k++) {
+    size_t d = order[k];
+    if (!newCount.empty() &&
+        newInStride.back() ==
+            static_cast<std::ptrdiff_t>(count[d]) * inStride[d] &&
+        newOutStride.back() ==
+            static_cast<std::ptrdiff_t>(count[d]) * outStride[d]) {
+      // previous (outer) dimension steps exactly over this one on both
+      // sides: fold it in
+      newCount.back() *= count[d];
+      newInStride.back() = inStride[d];
+      newOutStride.back() = outStride[d];
+    } else {
+      newCount.push_back(count[d]);
+      newInStride.push_back(inStride[d]);
+      newOutStride.push_back(outStride[d]);
+    }
+  }
+  count.swap(newCount);
+  inStride.swap(newInStride);
+  outStride.swap(newOutStride);
+}
+
+// NdCopyStridedTileSize()/NdCopyStridedColTileSize(): helper functions
+// tile edges of the tiled transposition kernel, in elements. a tile row is
+// NdCopyTuning::stridedTileBytes (about one cache line) but never less than
+// 8 elements; when the input's fast dimension is short (e.g. 3 channels) the
+// tile is widened so that a tile still covers stridedTileArea bytes and the
+// per tile overhead stays small.
+static inline size_t NdCopyStridedTileSize(size_t elmSize, size_t tileBytes) {
+  size_t tile = tileBytes / elmSize;
+  return tile < 8 ? 8 : tile;
+}
+
+static inline size_t NdCopyStridedColTileSize(size_t elmSize, size_t rows,
+                                              size_t rowTile,
+                                              size_t tileArea) {
+  size_t tileRows = rows < rowTile ? rows : rowTile;
+  size_t tile = tileArea / (tileRows * elmSize);
+  return tile < rowTile ? rowTile : tile;
+}
+
+// NdCopyTileT(): helper function
+// moves one rows x cols tile: rows follow the input's contiguous dimension,
+// columns the output's, so the stores of each row are sequential.
+template <size_t ElmBytes, bool RevEndian>
+static inline void NdCopyTileT(const char *in, char *out, size_t rows,
+                               size_t cols, std::ptrdiff_t inRowStride,
+                               std::ptrdiff_t outRowStride,
+                               std::ptrdiff_t inColStride, size_t elmSizeRT,
+                               const NdCopyElmDesc *elmDesc) {
+  const size_t elmSize = ElmBytes ? ElmBytes : elmSizeRT;
+  for (size_t r = 0; r < rows; r++) {
+    const char *inPtr = in;
+    char *outPtr = out;
+    for (size_t c = 0; c < cols; c++) {
+      if (RevEndian)
+        NdCopyRevEndianElm(outPtr, inPtr, elmSize, *elmDesc);
+      else
+        NdCopyCopyElm(outPtr, inPtr, elmSize);
+      inPtr += inColStride;
+      outPtr += elmSize;
+    }
+    in += inRowStride;
+    out += outRowStride;
+  }
+}
+
+// NdCopyStridedExecT(): helper function
+// Copies count[0]x...xcount[n-1] elements between two strided layouts.
+// the loop nest is expected to come from NdCopyOrderLoops(), i.e. the last
+// dimension is the fastest one on the output. Three kernels are used:
+// 1. contiguous on both sides: the innermost dimension is moved as one block,
+// 2. the input's fastest dimension is not the output's: the two fastest
+//    dimensions are tiled so that every cache line that is loaded or stored
+//    is fully used before it is evicted,
+// 3. otherwise, or for transpositions when tuning.stridedTileBytes is 0: one
+//    element at a time along the innermost dimension.
+// the outer dimensions are walked iteratively, so the stack usage does not
+// depend on the number of dimensions. ElmBytes is the element size when it is
+// known at compile time (0 otherwise), which turns every element move into a
+// single load and store.
+template <size_t ElmBytes>
+static void NdCopyStridedExecT(const char *in, char *out, const Dims &count,
+                               const Strides &inStride,
+                               const Strides &outStride, size_t elmSizeRT,
+                               const NdCopyElmDesc *revEndian,
+                               const NdCopyTuning &tuning) {
+  const size_t elmSize = ElmBytes ? ElmBytes : elmSizeRT;
+  const size_t numDims = count.size();
+  if (numDims == 0) {
+    if (revEndian)
+      NdCopyRevEndianElm(out, in, elmSize, *revEndian);
+    else
+      NdCopyCopyElm(out, in, elmSize);
+    return;
+  }
+  const std::ptrdiff_t elm = static_cast<std::ptrdiff_t>(elmSize);
+  const size_t last = numDims - 1;
+
+  // find the dimension that is contiguous on the input
+  size_t inFastDim = numDims;
+  for (size_t i = 0; i < numDims; i++)
+    if (inStride[i] == elm)
+      inFastDim = i;
+
+  // choose the kernel. the odometer below walks all dimensions but the last,
+  // and also skips inFastDim when the tiled kernel owns it
+  enum { Block, Tiled, Element } kernel = Element;
+  const size_t numOuterDims = last;
+  if (inStride[last] == elm && outStride[last] == elm)
+    kernel = Block;
+  else if (inFastDim < last && outStride[last] == elm &&
+           count[inFastDim] > 1 && count[last] > 1 &&
+           tuning.stridedTileBytes > 0)
+    kernel = Tiled;
+
+  const size_t blockSize = count[last] * elmSize;
+  const size_t rowTile =
+      NdCopyStridedTileSize(elmSize, tuning.stridedTileBytes);
+  const size_t colTile =
+      kernel == Tiled
+          ? NdCopyStridedColTileSize(elmSize, count[inFastDim], rowTile,
+                                     tuning.stridedTileArea)
+          : 0;
+  Dims pos(numDims, 0);
+  const char *inBase = in;
+  char *outBase = out;
+  while (true) {
+    if (kernel == Block) {
+      if (revEndian) {
+        NdCopyRevEndianElms(outBase, inBase, count[last], elmSize, *revEndian);
+      } else {
+        NdCopyBlock(outBase, inBase, blockSize);
+      }
+    } else if (kernel == Tiled) {
+      const size_t rows = count[inFastDim];
+      const size_t cols = count[last];
+      for (size_t r0 = 0; r0 < rows; r0 += rowTile) {
+        const size_t r1 = std::min(rows, r0 + rowTile);
+        for (size_t c0 = 0; c0 < cols; c0 += colTile) {
+          const size_t c1 = std::min(cols, c0 + colTile);
+          const std::ptrdiff_t ir0 = static_cast<std::ptrdiff_t>(r0);
+          const std::ptrdiff_t ic0 = static_cast<std::ptrdiff_t>(c0);
+          const char *tileIn =
+              inBase + ir0 * inStride[inFastDim] + ic0 * inStride[last];
+          char *tileOut = outBase + ir0 * outStride[inFastDim] + ic0 * elm;
+          if (revEndian)
+            NdCopyTileT<ElmBytes, true>(tileIn, tileOut, r1 - r0, c1 - c0,
+                                        inStride[inFastDim],
+                                        outStride[inFastDim], inStride[last],
+                                        elmSize, revEndian);
+          else
+            NdCopyTileT<ElmBytes, false>(tileIn, tileOut, r1 - r0, c1 - c0,
+                                         inStride[inFastDim],
+                                         outStride[inFastDim], inStride[last],
+                                         elmSize, revEndian);
+        }
+      }
+    } else {
+      for (size_t i = 0; i < count[last]; i++) {
+        const std::ptrdiff_t ii = static_cast<std::ptrdiff_t>(i);
+        if (revEndian)
+          NdCopyRevEndianElm(outBase + ii * outStride[last],
+                             inBase + ii * inStride[last], elmSize,
+                             *revEndian);
+        else
+          NdCopyCopyElm(outBase + ii * outStride[last],
+                        inBase + ii * inStride[last], elmSize);
+      }
+    }
+
+    // advance the odometer over the outer dimensions, moving both base
+    // pointers along: O(1) average overhead per block
+    size_t curDim = numOuterDims;
+    while (true) {
+      if (curDim == 0)
+        return;
+      curDim--;
+      if (kernel == Tiled && curDim == inFastDim)
+        continue;
+      if (++pos[curDim] < count[curDim]) {
+        inBase += inStride[curDim];
+        outBase += outStride[curDim];
+        break;
+      }
+      const std::ptrdiff_t back = static_cast<std::ptrdiff_t>(count[curDim] - 1);
+      inBase -= back * inStride[curDim];
+      outBase -= back * outStride[curDim];
+      pos[curDim] = 0;
+    }
+  }
+}
+
+// NdCopyStridedExec(): helper function
+// NdCopyStridedExecT() for the element size, through the selected ISA level's
+// build in the library build (NDCopySimd.hpp). tuning supplies the tile
+// sizes; NdCopyAutotune() passes its candidates here.
+static void NdCopyStridedExec(const char *in, char *out, const Dims &count,
+                              const Strides &inStride, const Strides &outStride,
+                              size_t elmSize, const NdCopyElmDesc *revEndian,
+                              const NdCopyTuning &tuning = NdCopyGetTuning()) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  NdCopySimd().stridedExec(in, out, count, inStride, outStride, elmSize,
+                           revEndian, tuning);
+#else
+  switch (elmSize) {
+  case 1:
+    NdCopyStridedExecT<1>(in, out, count, inStride, outStride, 1, revEndian,
+                          tuning);
+    break;
+  case 2:
+    NdCopyStridedExecT<2>(in, out, count, inStride, outStride, 2, revEndian,
+                          tuning);
+    break;
+  case 4:
+    NdCopyStridedExecT<4>(in, out, count, inStride, outStride, 4, revEndian,
+                          tuning);
+    break;
+  case 8:
+    NdCopyStridedExecT<8>(in, out, count, inStride, outStride, 8, revEndian,
+                          tuning);
+    break;
+  default:
+    NdCopyStridedExecT<0>(in, out, count, inStride, outStride, elmSize,
+                          revEndian, tuning);
+  }
+#endif
+}
+
+// NdCopyGetLayoutStrides(): helper function
+// byte stride of every logical dimension of a dense buffer whose dimensions
+// are laid out in axisOrder
+static void NdCopyGetLayoutStrides(Strides &stride, const Dims &memCount,
+                                   const Dims &axisOrder, size_t elmSize) {
+  stride.resize(memCount.size());
+  std::ptrdiff_t s = static_cast<std::ptrdiff_t>(elmSize);
+  for (size_t k = axisOrder.size(); k-- > 0;) {
+    stride[axisOrder[k]] = s;
+    s *= static_cast<std::ptrdiff_t>(memCount[axisOrder[k]]);
+  }
+}
+
+// NdCopyStridedOvlp(): helper function
+// intersects the input and output boxes and copies the overlap between the
+// two strided buffers. ioBase points to the element at ioMemStart.
+// revEndian is null when both sides have the same endianess.
+static int NdCopyStridedOvlp(const char *in, const Dims &inMemStart,
+                             const Dims &inStart, const Dims &inCount,
+                             Strides &inStride, char *out,
+                             const Dims &outMemStart, const Dims &outStart,
+                             const Dims &outCount, Strides &outStride,
+                             size_t elmSize, const NdCopyElmDesc *revEndian) {
+  const size_t numDims = inStart.size();
+  Dims ovlpCount(numDims);
+  const char *inOvlpBase = in;
+  char *outOvlpBase = out;
+  for (size_t i = 0; i < numDims; i++) {
+    size_t ovlpStart = std::max(inStart[i], outStart[i]);
+    size_t ovlpEnd =
+        std::min(inStart[i] + inCount[i], outStart[i] + outCount[i]);
+    if (ovlpEnd <= ovlpStart)
+      return 1; // no overlap found
+    ovlpCount[i] = ovlpEnd - ovlpStart;
+    inOvlpBase +=
+        static_cast<std::ptrdiff_t>(ovlpStart - inMemStart[i]) * inStride[i];
+    outOvlpBase +=
+        static_cast<std::ptrdiff_t>(ovlpStart - outMemStart[i]) * outStride[i];
+  }
+
+  NdCopyFlipNegStrides(inOvlpBase, outOvlpBase, ovlpCount, inStride,
+                       outStride);
+  NdCopyOrderLoops(ovlpCount, inStride, outStride);
+  NdCopyStridedExec(inOvlpBase, outOvlpBase, ovlpCount, inStride, outStride,
+                    elmSize, revEndian);
+  return 0;
+}
+
+// NdCopyPermute()
+// Copies n-dimensional data between two buffers whose dimensions are stored
+// in arbitrary orders (see axis order above), either can be of any
+// endianess. An empty axis order means row major.
+// Return 1 if no overlap is found, -1 if an axis order is not a permutation
+// of the dimensions.
+// Optimizations: the loop nest follows the output's memory order, dimensions
+// contiguous on both sides are merged into blocks, and when the fastest
+// input and output dimensions differ the copy is tiled over those two.
+template <class T>
+int NdCopyPermute(const char *in, const Dims &inStart, const Dims &inCount,
+                  const Dims &inAxisOrder, const bool inIsLittleEndian,
+                  char *out, const Dims &outStart, const Dims &outCount,
+                  const Dims &outAxisOrder, const bool outIsLittleEndian,
+                  const Dims &inMemStart, const Dims &inMemCount,
+                  const Dims &outMemStart, const Dims &outMemCount) {
+  const size_t numDims = inStart.size();
+  const Dims &inMemStartNC = inMemStart.empty() ? inStart : inMemStart;
+  const Dims &inMemCountNC = inMemCount.empty() ? inCount : inMemCount;
+  const Dims &outMemStartNC = outMemStart.empty() ? outStart : outMemStart;
+  const Dims &outMemCountNC = outMemCount.empty() ? outCount : outMemCount;
+  const Dims inOrder =
+      inAxisOrder.empty() ? NdCopyRowMajorOrder(numDims) : inAxisOrder;
+  const Dims outOrder =
+      outAxisOrder.empty() ? NdCopyRowMajorOrder(numDims) : outAxisOrder;
+  if (!NdCopyIsAxisOrder(inOrder, numDims) ||
+      !NdCopyIsAxisOrder(outOrder, numDims))
+    return -1;
+
+  Strides inStride, outStride;
+  NdCopyGetLayoutStrides(inStride, inMemCountNC, inOrder, sizeof(T));
+  NdCopyGetLayoutStrides(outStride, outMemCountNC, outOrder, sizeof(T));
+  const NdCopyElmDesc elmDesc = NdCopyElmTraits<T>::Desc();
+  return NdCopyStridedOvlp(
+      in, inMemStartNC, inStart, inCount, inStride, out, outMemStartNC,
+      outStart, outCount, outStride, sizeof(T),
+      inIsLittleEndian != outIsLittleEndian ? &elmDesc : nullptr);
+}
+
+// NdCopyStrided()
+// Copies n-dimensional data between two strided views, either can be of any
+// endianess. in/out point to the element at inStart/outStart, and the byte
+// strides give the distance between neighbouring elements of every logical
+// dimension, so padded rows (aligned pitch), elements embedded in larger
+// structs and numpy style views with negative (flipped) strides are all
+// described directly. An empty stride list means densely packed row major.
+// Return 1 if no overlap is found, -1 if there are no dimensions, a start or
+// count has another number of dimensions than inStart, or a stride list is
+// neither empty nor one stride per dimension.
+// Optimizations: the same as NdCopyPermute(); whenever the strides happen to
+// be dense the largest contiguous block is still found and moved as a whole.
+template <class T>
+int NdCopyStrided(const char *in, const Dims &inStart, const Dims &inCount,
+                  const Strides &inByteStride, const bool inIsLittleEndian,
+                  char *out, const Dims &outStart, const Dims &outCount,
+                  const Strides &outByteStride, const bool outIsLittleEndian) {
+  const size_t numDims = inStart.size();
+  if (numDims == 0 || inCount.size() != numDims ||
+      outStart.size() != numDims || outCount.size() != numDims ||
+      (!inByteStride.empty() && inByteStride.size() != numDims) ||
+      (!outByteStride.empty() && outByteStride.size() != numDims))
+    return -1;
+  const Dims rowMajor = NdCopyRowMajorOrder(numDims);
+  Strides inStride(inByteStride), outStride(outByteStride);
+  if (inStride.empty())
+    NdCopyGetLayoutStrides(inStride, inCount, rowMajor, sizeof(T));
+  if (outStride.empty())
+    NdCopyGetLayoutStrides(outStride, outCount, rowMajor, sizeof(T));
+  const NdCopyElmDesc elmDesc = NdCopyElmTraits<T>::Desc();
+  return NdCopyStridedOvlp(
+      in, inStart, inStart, inCount, inStride, out, outStart, outStart,
+      outCount, outStride, sizeof(T),
+      inIsLittleEndian != outIsLittleEndian ? &elmDesc : nullptr);
+}
+//*************** End of NdCopyPermute(), NdCopyStrided() and their helpers ***************
+
+#endif
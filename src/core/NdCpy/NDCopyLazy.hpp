@@ -0,0 +1,185 @@
+//
+//  NDCopyLazy.hpp
+//  src
+//
+
+#ifndef NDCOPYLAZY_HPP
+#define NDCOPYLAZY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+
+// NdCopyLazy
+// a deferred NdCopy<T>(): records the source, the input and output geometry
+// and the layout conversion, but copies nothing until data is asked for.
+// then it copies only what is asked for, the whole output box or a sub-box
+// of it, and keeps the result, so repeated requests are free. selections
+// that are never read cost neither bandwidth nor memory.
+// the source is not copied: it has to stay valid and unchanged until the
+// last request. elements of the output box that the input does not cover
+// read as zero bytes. a handle is not thread safe.
+template <class T>
+class NdCopyLazy {
+public:
+  NdCopyLazy(const char *in, const Dims &inStart, const Dims &inCount,
+             bool inIsRowMajor, bool inIsLittleEndian, const Dims &outStart,
+             const Dims &outCount, bool outIsRowMajor, bool outIsLittleEndian,
+             const Dims &inMemStart = Dims(), const Dims &inMemCount = Dims())
+      : m_In(in), m_InStart(inStart), m_InCount(inCount),
+        m_InIsRowMajor(inIsRowMajor), m_InIsLittleEndian(inIsLittleEndian),
+        m_OutStart(outStart), m_OutCount(outCount),
+        m_OutIsRowMajor(outIsRowMajor),
+        m_OutIsLittleEndian(outIsLittleEndian), m_InMemStart(inMemStart),
+        m_InMemCount(inMemCount) {}
+
+  // Materialize()
+  // copies the whole output box on the first call, later calls are free.
+  // returns what NdCopy() returned: 0, 1 if the boxes do not overlap, -1
+  // for an invalid geometry.
+  int Materialize() {
+    if (!m_IsMaterialized) {
+      m_Data.assign(NdCopyLazyBytes(m_OutCount), 0);
+      m_Status = NdCopy<T>(m_In, m_InStart, m_InCount, m_InIsRowMajor,
+                           m_InIsLittleEndian, m_Data.data(), m_OutStart,
+                           m_OutCount, m_OutIsRowMajor, m_OutIsLittleEndian,
+                           m_InMemStart, m_InMemCount);
+      m_IsMaterialized = true;
+    }
+    return m_Status;
+  }
+
+  // Materialize()
+  // the sub-box subStart/subCount of the output box, dense in the output
+  // layout. copied on its first request, out of the whole output box when
+  // that is materialized and else straight from the source, and kept. data
+  // stays valid until Release(). returns 0, 1 if the sub-box does not
+  // overlap the input, -1 if it does not lie inside the output box.
+  int Materialize(const Dims &subStart, const Dims &subCount,
+                  const char *&data) {
+    data = nullptr;
+    if (subStart == m_OutStart && subCount == m_OutCount) {
+      const int res = Materialize();
+      data = m_Data.data();
+      return res;
+    }
+    if (!NdCopyLazyInside(subStart, subCount))
+      return -1;
+    const std::pair<Dims, Dims> key(subStart, subCount);
+    auto it = m_Parts.find(key);
+    if (it == m_Parts.end()) {
+      Part part;
+      part.data.assign(NdCopyLazyBytes(subCount), 0);
+      if (m_IsMaterialized) {
+        NdCopyLazyCut(subStart, subCount, part.data.data());
+        part.status = m_Status != 0 ? m_Status
+                                    : NdCopyLazyOverlaps(subStart, subCount);
+      } else
+        part.status =
+            NdCopy<T>(m_In, m_InStart, m_InCount, m_InIsRowMajor,
+                      m_InIsLittleEndian, part.data.data(), subStart,
+                      subCount, m_OutIsRowMajor, m_OutIsLittleEndian,
+                      m_InMemStart, m_InMemCount);
+      it = m_Parts.insert(std::make_pair(key, std::move(part))).first;
+    }
+    data = it->second.data.data();
+    return it->second.status;
+  }
+
+  // Data()
+  // the whole output box, null until Materialize()
+  const char *Data() const {
+    return m_IsMaterialized ? m_Data.data() : nullptr;
+  }
+  bool IsMaterialized() const { return m_IsMaterialized; }
+
+  // bytes held by the materialized output box and sub-boxes
+  size_t GetCachedBytes() const {
+    size_t bytes = m_Data.size();
+    for (const auto &part : m_Parts)
+      bytes += part.second.data.size();
+    return bytes;
+  }
+
+  // Release()
+  // drops everything materialized; the next request copies again
+  void Release() {
+    std::vector<char>().swap(m_Data);
+    m_Parts.clear();
+    m_IsMaterialized = false;
+  }
+
+private:
+  struct Part {
+    std::vector<char> data;
+    int status;
+  };
+
+  // NdCopyLazyBytes(): helper function
+  static size_t NdCopyLazyBytes(const Dims &count) {
+    return std::accumulate(count.begin(), count.end(), sizeof(T),
+                           std::multiplies<size_t>());
+  }
+
+  // NdCopyLazyInside(): helper function
+  bool NdCopyLazyInside(const Dims &subStart, const Dims &subCount) const {
+    if (subStart.size() != m_OutStart.size() ||
+        subCount.size() != m_OutCount.size())
+      return false;
+    for (size_t i = 0; i < subStart.size(); i++)
+      if (subCount[i] == 0 || subStart[i] < m_OutStart[i] ||
+          subStart[i] + subCount[i] > m_OutStart[i] + m_OutCount[i])
+        return false;
+    return true;
+  }
+
+  // NdCopyLazyCut(): helper function
+  // copies the sub-box out of the materialized output box, a plain copy as
+  // the conversion is done. NdCopy() reads the dims of a col-major output
+  // written from a row-major input fastest first, of one written from a
+  // col-major input in the same order as the input's, so the cut is made as
+  // a row-major ==> row-major copy over the matching dim order.
+  void NdCopyLazyCut(const Dims &subStart, const Dims &subCount,
+                     char *out) const {
+    Dims start(m_OutStart), count(m_OutCount), cutStart(subStart),
+        cutCount(subCount);
+    if (m_InIsRowMajor && !m_OutIsRowMajor) {
+      std::reverse(start.begin(), start.end());
+      std::reverse(count.begin(), count.end());
+      std::reverse(cutStart.begin(), cutStart.end());
+      std::reverse(cutCount.begin(), cutCount.end());
+    }
+    NdCopy<T>(m_Data.data(), start, count, true, m_OutIsLittleEndian, out,
+              cutStart, cutCount, true, m_OutIsLittleEndian);
+  }
+
+  // NdCopyLazyOverlaps(): helper function
+  // 0 if the sub-box overlaps the input box, 1 if not, as NdCopy() returns
+  int NdCopyLazyOverlaps(const Dims &subStart, const Dims &subCount) const {
+    for (size_t i = 0; i < subStart.size(); i++)
+      if (subStart[i] >= m_InStart[i] + m_InCount[i] ||
+          m_InStart[i] >= subStart[i] + subCount[i])
+        return 1;
+    return 0;
+  }
+
+  const char *m_In;
+  const Dims m_InStart, m_InCount;
+  const bool m_InIsRowMajor, m_InIsLittleEndian;
+  const Dims m_OutStart, m_OutCount;
+  const bool m_OutIsRowMajor, m_OutIsLittleEndian;
+  const Dims m_InMemStart, m_InMemCount;
+
+  bool m_IsMaterialized = false;
+  int m_Status = 0;
+  std::vector<char> m_Data;
+  std::map<std::pair<Dims, Dims>, Part> m_Parts;
+};
+
+#endif
@@ -0,0 +1,352 @@
+//
+//  NDCopyPack.hpp
+//  src
+//
+
+#ifndef NDCOPYPACK_HPP
+#define NDCOPYPACK_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+
+const size_t NdCopyPackMaxDims = 16;
+
+// NdCopyPackType
+// datatype-like description of a sub-box of a buffer, built once and reused
+// for any number of NdCopyPack()/NdCopyUnpack() calls. the buffer holds the
+// box bufStart/bufCount, the packed message the box boxStart/boxCount (which
+// has to lie inside the buffer) densely in the same major. dims are logical.
+// construction reduces the box to a few outer loops around a contiguous
+// block: trailing dims the box spans completely are folded into the block,
+// count 1 dims are dropped and dims that stay contiguous are merged.
+class NdCopyPackType {
+public:
+  NdCopyPackType(const Dims &bufStart, const Dims &bufCount,
+                 const Dims &boxStart, const Dims &boxCount, size_t elmSize,
+                 bool isRowMajor = true) {
+    const size_t numDims = bufCount.size();
+    if (numDims == 0 || bufStart.size() != numDims ||
+        boxStart.size() != numDims || boxCount.size() != numDims ||
+        elmSize == 0)
+      return;
+    // memory order, slowest first
+    Dims c(bufCount), s(numDims), b(boxCount);
+    for (size_t i = 0; i < numDims; i++) {
+      if (boxStart[i] < bufStart[i] || boxCount[i] == 0 ||
+          boxStart[i] + boxCount[i] > bufStart[i] + bufCount[i])
+        return;
+      s[i] = boxStart[i] - bufStart[i];
+    }
+    if (!isRowMajor) {
+      std::reverse(c.begin(), c.end());
+      std::reverse(s.begin(), s.end());
+      std::reverse(b.begin(), b.end());
+    }
+    Dims stride(numDims);
+    stride[numDims - 1] = elmSize;
+    for (size_t k = numDims - 1; k-- > 0;)
+      stride[k] = stride[k + 1] * c[k + 1];
+    for (size_t k = 0; k < numDims; k++)
+      m_BaseOffset += s[k] * stride[k];
+    // contiguous block: innermost dim plus the dims it spans completely
+    size_t k = numDims - 1;
+    m_BlockSize = b[k] * elmSize;
+    while (k > 0 && b[k] == c[k]) {
+      k--;
+      m_BlockSize *= b[k];
+    }
+    // outer loops, innermost last, with count 1 dims dropped and dims that
+    // are contiguous with the next one merged into it
+    size_t numOuter = 0;
+    size_t outerCount[NdCopyPackMaxDims], outerStride[NdCopyPackMaxDims];
+    for (size_t i = 0; i < k; i++) {
+      if (b[i] == 1)
+        continue;
+      if (numOuter == NdCopyPackMaxDims)
+        return;
+      outerCount[numOuter] = b[i];
+      outerStride[numOuter] = stride[i];
+      numOuter++;
+    }
+    size_t merged = 0;
+    for (size_t i = 0; i < numOuter; i++) {
+      if (merged > 0 &&
+          m_OuterStride[merged - 1] == outerCount[i] * outerStride[i]) {
+        m_OuterCount[merged - 1] *= outerCount[i];
+        m_OuterStride[merged - 1] = outerStride[i];
+        continue;
+      }
+      m_OuterCount[merged] = outerCount[i];
+      m_OuterStride[merged] = outerStride[i];
+      merged++;
+    }
+    m_NumOuter = merged;
+    m_PackedBytes = m_BlockSize;
+    for (size_t i = 0; i < m_NumOuter; i++)
+      m_PackedBytes *= m_OuterCount[i];
+    m_Valid = true;
+  }
+
+  bool IsValid() const { return m_Valid; }
+  size_t GetPackedBytes() const { return m_PackedBytes; }
+
+  // reduced form, used by the pack kernels
+  size_t GetNumOuter() const { return m_NumOuter; }
+  size_t GetOuterCount(size_t i) const { return m_OuterCount[i]; }
+  size_t GetOuterStride(size_t i) const { return m_OuterStride[i]; }
+  size_t GetBlockSize() const { return m_BlockSize; }
+  size_t GetBaseOffset() const { return m_BaseOffset; }
+
+private:
+  bool m_Valid = false;
+  size_t m_NumOuter = 0;
+  size_t m_OuterCount[NdCopyPackMaxDims];
+  size_t m_OuterStride[NdCopyPackMaxDims];
+  size_t m_BlockSize = 0;
+  size_t m_BaseOffset = 0;
+  size_t m_PackedBytes = 0;
+};
+
+int NdCopyPack(const NdCopyPackType &type, const char *buf, char *packed,
+               size_t numThreads = 0);
+int NdCopyUnpack(const NdCopyPackType &type, const char *packed, char *buf,
+                 size_t numThreads = 0);
+
+//***************Start of NdCopyPack(), NdCopyUnpack() and their helpers *****
+// Both run the reduced loops of an NdCopyPackType directly, without the
+// general NdCopy() planner and without allocating: small blocks of 1 to 64
+// bytes are copied with fixed size moves, others with NdCopyBlock().
+// messages of NdCopyTuning::packParallelMinBytes and more are split along
+// the outermost loop over several threads.
+
+// NdCopyPackRows(): helper function
+// the innermost loop: rows blocks, stride bytes apart in the buffer and
+// back to back in the packed message
+template <size_t Bytes, bool Pack>
+static inline void NdCopyPackRows(char *buf, char *packed, size_t rows,
+                                  size_t stride, size_t blockSize) {
+  for (size_t r = 0; r < rows; r++) {
+    if (Bytes != 0) {
+      if (Pack)
+        std::memcpy(packed, buf, Bytes);
+      else
+        std::memcpy(buf, packed, Bytes);
+    } else {
+      if (Pack)
+        NdCopyBlock(packed, buf, blockSize);
+      else
+        NdCopyBlock(buf, packed, blockSize);
+    }
+    buf += stride;
+    packed += blockSize;
+  }
+}
+
+// NdCopyPackRangeT(): helper function
+// packs/unpacks indices [lo, hi) of the outermost loop. buf points to the
+// start of the buffer, packed to the start of the message.
+template <size_t Bytes, bool Pack>
+static void NdCopyPackRangeT(const NdCopyPackType &type, char *buf,
+                             char *packed, size_t lo, size_t hi) {
+  const size_t n = type.GetNumOuter();
+  const size_t blockSize = type.GetBlockSize();
+  if (lo >= hi)
+    return;
+  buf += type.GetBaseOffset();
+  if (n == 0) {
+    // a single contiguous block, split by bytes
+    if (Pack)
+      std::memcpy(packed + lo, buf + lo, hi - lo);
+    else
+      std::memcpy(buf + lo, packed + lo, hi - lo);
+    return;
+  }
+  size_t inner = blockSize;
+  for (size_t i = 1; i < n; i++)
+    inner *= type.GetOuterCount(i);
+  buf += lo * type.GetOuterStride(0);
+  packed += lo * inner;
+  if (n == 1) {
+    NdCopyPackRows<Bytes, Pack>(buf, packed, hi - lo, type.GetOuterStride(0),
+                                blockSize);
+    return;
+  }
+  // odometer over the loops above the innermost one
+  const size_t last = n - 1;
+  const size_t rows = type.GetOuterCount(last);
+  const size_t rowStride = type.GetOuterStride(last);
+  size_t pos[NdCopyPackMaxDims] = {0};
+  pos[0] = lo;
+  char *base[NdCopyPackMaxDims];
+  base[0] = buf;
+  for (size_t i = 1; i < last; i++)
+    base[i] = base[i - 1];
+  while (true) {
+    NdCopyPackRows<Bytes, Pack>(base[last - 1], packed, rows, rowStride,
+                                blockSize);
+    packed += rows * blockSize;
+    size_t d = last - 1;
+    while (true) {
+      base[d] += type.GetOuterStride(d);
+      if (++pos[d] < (d == 0 ? hi : type.GetOuterCount(d)))
+        break;
+      if (d == 0)
+        return;
+      pos[d] = 0;
+      d--;
+    }
+    for (size_t i = d + 1; i < last; i++)
+      base[i] = base[d];
+  }
+}
+
+// NdCopyPackRange(): helper function
+// picks the kernel for the block size
+template <bool Pack>
+static void NdCopyPackRange(const NdCopyPackType &type, char *buf,
+                            char *packed, size_t lo, size_t hi) {
+  switch (type.GetNumOuter() == 0 ? 0 : type.GetBlockSize()) {
+  case 1:
+    NdCopyPackRangeT<1, Pack>(type, buf, packed, lo, hi);
+    break;
+  case 2:
+    NdCopyPackRangeT<2, Pack>(type, buf, packed, lo, hi);
+    break;
+  case 4:
+    NdCopyPackRangeT<4, Pack>(type, buf, packed, lo, hi);
+    break;
+  case 8:
+    NdCopyPackRangeT<8, Pack>(type, buf, packed, lo, hi);
+    break;
+  case 16:
+    NdCopyPackRangeT<16, Pack>(type, buf, packed, lo, hi);
+    break;
+  case 32:
+    NdCopyPackRangeT<32, Pack>(type, buf, packed, lo, hi);
+    break;
+  case 64:
+    NdCopyPackRangeT<64, Pack>(type, buf, packed, lo, hi);
+    break;
+  default:
+    NdCopyPackRangeT<0, Pack>(type, buf, packed, lo, hi);
+  }
+}
+
+// NdCopyPackRuns(): helper function
+// calls fn(run, numElms) for the contiguous runs of buf that hold elements
+// [lo, hi) of the packed message, in order; for the kernels that gather a
+// part of the message before converting it (NDCopyQuant.hpp,
+// NDCopyShuffle.hpp)
+template <class Fn>
+static void NdCopyPackRuns(const NdCopyPackType &type, char *buf,
+                           size_t elmSize, size_t lo, size_t hi, Fn &&fn) {
+  const size_t n = type.GetNumOuter();
+  const size_t runElms = type.GetBlockSize() / elmSize;
+  // odometer position of the run holding element lo, innermost loop last
+  size_t pos[NdCopyPackMaxDims];
+  size_t run = lo / runElms;
+  size_t skip = lo % runElms;
+  char *base = buf + type.GetBaseOffset();
+  for (size_t i = n; i-- > 0;) {
+    pos[i] = run % type.GetOuterCount(i);
+    run /= type.GetOuterCount(i);
+    base += pos[i] * type.GetOuterStride(i);
+  }
+  for (size_t left = hi - lo; left > 0;) {
+    const size_t take = std::min(runElms - skip, left);
+    fn(base + skip * elmSize, take);
+    left -= take;
+    skip = 0;
+    for (size_t d = n; d-- > 0;) {
+      base += type.GetOuterStride(d);
+      if (++pos[d] < type.GetOuterCount(d))
+        break;
+      base -= pos[d] * type.GetOuterStride(d);
+      pos[d] = 0;
+    }
+  }
+}
+
+// NdCopyParallelFor(): helper function
+// calls fn(lo, hi) for the parts of [0, total) over numThreads threads, the
+// parts ending at split(t, numThreads) for t = 1 .. numThreads; the calling
+// thread takes the first part. numThreads 0 picks one thread if bytes is
+// below the tuned packParallelMinBytes and up to packMaxThreads otherwise.
+// shared by the kernels that pack or unpack a message in parallel.
+template <class Fn, class Split>
+static void NdCopyParallelFor(size_t total, size_t bytes, size_t numThreads,
+                              Fn fn, Split split) {
+  if (numThreads == 0) {
+    const NdCopyTuning &tuning = NdCopyGetTuning();
+    numThreads = 1;
+    if (bytes >= tuning.packParallelMinBytes)
+      numThreads = std::min<size_t>(
+          std::max(1u, std::thread::hardware_concurrency()),
+          tuning.packMaxThreads);
+  }
+  numThreads = std::min(numThreads, total);
+  if (numThreads <= 1) {
+    fn(size_t(0), total);
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads - 1);
+  for (size_t t = 1; t < numThreads; t++)
+    threads.emplace_back(fn, split(t, numThreads), split(t + 1, numThreads));
+  fn(size_t(0), split(1, numThreads));
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+// NdCopyParallelFor(): helper function
+// the same in even parts
+template <class Fn>
+static void NdCopyParallelFor(size_t total, size_t bytes, size_t numThreads,
+                              Fn fn) {
+  NdCopyParallelFor(total, bytes, numThreads, fn,
+                    [total](size_t t, size_t n) { return total * t / n; });
+}
+
+// NdCopyPackRun(): helper function
+// runs NdCopyPackRange() over the outermost loop (or the single block)
+template <bool Pack>
+static int NdCopyPackRun(const NdCopyPackType &type, char *buf, char *packed,
+                         size_t numThreads) {
+  if (!type.IsValid())
+    return -1;
+  const size_t total = type.GetNumOuter() == 0 ? type.GetPackedBytes()
+                                                : type.GetOuterCount(0);
+  NdCopyParallelFor(total, type.GetPackedBytes(), numThreads,
+                    [&](size_t lo, size_t hi) {
+                      NdCopyPackRange<Pack>(type, buf, packed, lo, hi);
+                    });
+  return 0;
+}
+
+// NdCopyPack()
+// copies the box described by type out of buf into the contiguous message
+// packed (type.GetPackedBytes() bytes). numThreads 0 picks one thread for
+// small messages and several for big ones. returns 0, or -1 for an invalid
+// type.
+inline int NdCopyPack(const NdCopyPackType &type, const char *buf,
+                      char *packed, size_t numThreads) {
+  return NdCopyPackRun<true>(type, const_cast<char *>(buf), packed,
+                             numThreads);
+}
+
+// NdCopyUnpack()
+// the reverse of NdCopyPack(): scatters the contiguous message packed into
+// the box described by type in buf
+inline int NdCopyUnpack(const NdCopyPackType &type, const char *packed,
+                        char *buf, size_t numThreads) {
+  return NdCopyPackRun<false>(type, buf, const_cast<char *>(packed),
+                              numThreads);
+}
+//*************** End of NdCopyPack(), NdCopyUnpack() and their helpers *****
+
+#endif
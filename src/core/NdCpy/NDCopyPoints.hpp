@@ -0,0 +1,281 @@
+//
+//  NDCopyPoints.hpp
+//  src
+//
+
+#ifndef NDCOPYPOINTS_HPP
+#define NDCOPYPOINTS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyPack.hpp"
+#include "core/NdCpy/NDCopySimd.hpp"
+#include "core/NdCpy/NDCopyTuning.hpp"
+
+// NdCopyPointOffsetsT(): helper function
+// offsets[i] of point i. with NumDims known at compile time (0 for any other
+// number of dimensions) the loop over the dimensions is unrolled and the loop
+// over the points is a chain of multiply-adds over whole coordinate tuples,
+// which the compiler vectorizes. out of range coordinates are collected
+// branch free: one below the start wraps around and fails the same test as
+// one past the end.
+template <size_t NumDims>
+static bool NdCopyPointOffsetsT(const size_t *__restrict coords,
+                                size_t numPoints, size_t numDimsRT,
+                                const Dims &bufStart, const Dims &bufCount,
+                                const Dims &stride,
+                                size_t *__restrict offsets) {
+  const size_t numDims = NumDims ? NumDims : numDimsRT;
+  const size_t *__restrict start = bufStart.data();
+  const size_t *__restrict count = bufCount.data();
+  const size_t *__restrict s = stride.data();
+  size_t outside = 0;
+  for (size_t i = 0; i < numPoints; i++) {
+    size_t offset = 0;
+    for (size_t d = 0; d < numDims; d++) {
+      const size_t rel = coords[i * numDims + d] - start[d];
+      outside |= static_cast<size_t>(rel >= count[d]);
+      offset += rel * s[d];
+    }
+    offsets[i] = offset;
+  }
+  return outside == 0;
+}
+
+// NdCopyPointOffsets(): helper function
+// NdCopyPointOffsetsT() for the number of dimensions, through the selected
+// ISA level's build in the library build (NDCopySimd.hpp)
+static bool NdCopyPointOffsets(const size_t *coords, size_t numPoints,
+                               size_t numDims, const Dims &bufStart,
+                               const Dims &bufCount, const Dims &stride,
+                               size_t *offsets) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  return NdCopySimd().pointOffsets(coords, numPoints, numDims, bufStart,
+                                   bufCount, stride, offsets);
+#else
+  switch (numDims) {
+  case 1:
+    return NdCopyPointOffsetsT<1>(coords, numPoints, 1, bufStart, bufCount,
+                                  stride, offsets);
+  case 2:
+    return NdCopyPointOffsetsT<2>(coords, numPoints, 2, bufStart, bufCount,
+                                  stride, offsets);
+  case 3:
+    return NdCopyPointOffsetsT<3>(coords, numPoints, 3, bufStart, bufCount,
+                                  stride, offsets);
+  case 4:
+    return NdCopyPointOffsetsT<4>(coords, numPoints, 4, bufStart, bufCount,
+                                  stride, offsets);
+  default:
+    return NdCopyPointOffsetsT<0>(coords, numPoints, numDims, bufStart,
+                                  bufCount, stride, offsets);
+  }
+#endif
+}
+
+// NdCopyPointSelection
+// a list of scattered points of a buffer (probe locations, particle
+// positions), built once and reused for any number of NdCopyGatherPoints()/
+// NdCopyScatterPoints() calls. the buffer holds the box bufStart/bufCount,
+// coords holds numPoints coordinate tuples of bufCount.size() logical
+// coordinates each, point after point. the packed message holds the points
+// densely in the order they were given.
+// construction turns every point into a byte offset and sorts the offsets,
+// so the buffer is walked forward and points sharing a cache line or a page
+// are visited together. the selection is invalid if a point lies outside
+// the buffer.
+class NdCopyPointSelection {
+public:
+  NdCopyPointSelection(const Dims &bufStart, const Dims &bufCount,
+                       const size_t *coords, size_t numPoints, size_t elmSize,
+                       bool isRowMajor = true)
+      : m_ElmSize(elmSize) {
+    const size_t numDims = bufCount.size();
+    if (numDims == 0 || bufStart.size() != numDims || elmSize == 0 ||
+        (coords == nullptr && numPoints > 0))
+      return;
+    // byte stride of every logical dimension
+    Dims stride(numDims);
+    size_t s = elmSize;
+    for (size_t k = 0; k < numDims; k++) {
+      const size_t d = isRowMajor ? numDims - 1 - k : k;
+      stride[d] = s;
+      s *= bufCount[d];
+    }
+    m_Offsets.assign(numPoints, 0);
+    if (!NdCopyPointOffsets(coords, numPoints, numDims, bufStart, bufCount,
+                            stride, m_Offsets.data()))
+      return;
+    m_Index.resize(numPoints);
+    for (size_t i = 0; i < numPoints; i++)
+      m_Index[i] = i;
+    if (!std::is_sorted(m_Offsets.begin(), m_Offsets.end()))
+      Sort();
+    m_Valid = true;
+  }
+
+  bool IsValid() const { return m_Valid; }
+  size_t GetNumPoints() const { return m_Offsets.size(); }
+  size_t GetElmSize() const { return m_ElmSize; }
+  size_t GetPackedBytes() const { return m_Offsets.size() * m_ElmSize; }
+
+  // sorted form, used by the point kernels: the k-th point in buffer order
+  // lies at byte GetOffset(k) of the buffer and at element GetIndex(k) of
+  // the packed message
+  size_t GetOffset(size_t k) const { return m_Offsets[k]; }
+  size_t GetIndex(size_t k) const { return m_Index[k]; }
+  const size_t *GetOffsets() const { return m_Offsets.data(); }
+  const size_t *GetIndices() const { return m_Index.data(); }
+
+private:
+  // Sort(): sorts the points by offset with an LSD radix sort, 16 bits of
+  // the offsets per pass and only as many passes as the largest offset
+  // needs. stable, so points at the same offset keep the order they were
+  // given in (the last one wins a scatter).
+  void Sort() {
+    const size_t n = m_Offsets.size();
+    const size_t maxOffset =
+        *std::max_element(m_Offsets.begin(), m_Offsets.end());
+    std::vector<size_t> offsets(n), index(n);
+    std::vector<size_t> bucket(size_t(1) << 16);
+    for (size_t shift = 0; shift < 64 && (maxOffset >> shift) != 0;
+         shift += 16) {
+      std::fill(bucket.begin(), bucket.end(), 0);
+      for (size_t k = 0; k < n; k++)
+        bucket[(m_Offsets[k] >> shift) & 0xffff]++;
+      size_t pos = 0;
+      for (size_t &b : bucket) {
+        const size_t count = b;
+        b = pos;
+        pos += count;
+      }
+      for (size_t k = 0; k < n; k++) {
+        const size_t to = bucket[(m_Offsets[k] >> shift) & 0xffff]++;
+        offsets[to] = m_Offsets[k];
+        index[to] = m_Index[k];
+      }
+      m_Offsets.swap(offsets);
+      m_Index.swap(index);
+    }
+  }
+
+  bool m_Valid = false;
+  size_t m_ElmSize;
+  std::vector<size_t> m_Offsets;
+  std::vector<size_t> m_Index;
+};
+
+int NdCopyGatherPoints(const NdCopyPointSelection &sel, const char *buf,
+                       char *packed, size_t numThreads = 0);
+int NdCopyScatterPoints(const NdCopyPointSelection &sel, const char *packed,
+                        char *buf, size_t numThreads = 0);
+
+//***************Start of the point gather/scatter and their helpers *********
+// Both walk the sorted points of an NdCopyPointSelection and move one element
+// per point with a fixed size copy, without planning anything per point.
+// selections of NdCopyTuning::packParallelMinBytes and more are split over
+// several threads like NdCopyPack(), at boundaries between distinct offsets
+// so that a scatter never writes one element from two threads.
+
+// NdCopyPointRangeT(): helper function
+// gathers/scatters the sorted points [lo, hi)
+template <size_t Bytes, bool Gather>
+static void NdCopyPointRangeT(const NdCopyPointSelection &sel, char *buf,
+                              char *packed, size_t lo, size_t hi) {
+  const size_t elmSize = Bytes ? Bytes : sel.GetElmSize();
+  const size_t *offsets = sel.GetOffsets();
+  const size_t *index = sel.GetIndices();
+  for (size_t k = lo; k < hi; k++) {
+    char *b = buf + offsets[k];
+    char *p = packed + index[k] * elmSize;
+    if (Gather)
+      std::memcpy(p, b, elmSize);
+    else
+      std::memcpy(b, p, elmSize);
+  }
+}
+
+// NdCopyPointRange(): helper function
+// picks the kernel for the element size
+template <bool Gather>
+static void NdCopyPointRange(const NdCopyPointSelection &sel, char *buf,
+                             char *packed, size_t lo, size_t hi) {
+  switch (sel.GetElmSize()) {
+  case 1:
+    NdCopyPointRangeT<1, Gather>(sel, buf, packed, lo, hi);
+    break;
+  case 2:
+    NdCopyPointRangeT<2, Gather>(sel, buf, packed, lo, hi);
+    break;
+  case 4:
+    NdCopyPointRangeT<4, Gather>(sel, buf, packed, lo, hi);
+    break;
+  case 8:
+    NdCopyPointRangeT<8, Gather>(sel, buf, packed, lo, hi);
+    break;
+  case 16:
+    NdCopyPointRangeT<16, Gather>(sel, buf, packed, lo, hi);
+    break;
+  default:
+    NdCopyPointRangeT<0, Gather>(sel, buf, packed, lo, hi);
+  }
+}
+
+// NdCopyPointSplit(): helper function
+// the t-th of numThreads split points of the sorted points, moved forward
+// past points that share the offset before it
+static size_t NdCopyPointSplit(const NdCopyPointSelection &sel, size_t t,
+                               size_t numThreads) {
+  const size_t n = sel.GetNumPoints();
+  size_t k = n * t / numThreads;
+  while (k > 0 && k < n && sel.GetOffset(k) == sel.GetOffset(k - 1))
+    k++;
+  return k;
+}
+
+// NdCopyPointRun(): helper function
+// runs NdCopyPointRange() over the sorted points, split where the offset
+// changes (NdCopyPointSplit())
+template <bool Gather>
+static int NdCopyPointRun(const NdCopyPointSelection &sel, char *buf,
+                          char *packed, size_t numThreads) {
+  if (!sel.IsValid())
+    return -1;
+  NdCopyParallelFor(
+      sel.GetNumPoints(), sel.GetPackedBytes(), numThreads,
+      [&](size_t lo, size_t hi) {
+        NdCopyPointRange<Gather>(sel, buf, packed, lo, hi);
+      },
+      [&](size_t t, size_t n) { return NdCopyPointSplit(sel, t, n); });
+  return 0;
+}
+
+// NdCopyGatherPoints()
+// copies the points of sel out of buf into the contiguous message packed
+// (sel.GetPackedBytes() bytes), element i being the i-th point given.
+// numThreads 0 picks one thread for small selections and several for big
+// ones. returns 0, or -1 for an invalid selection.
+inline int NdCopyGatherPoints(const NdCopyPointSelection &sel,
+                              const char *buf, char *packed,
+                              size_t numThreads) {
+  return NdCopyPointRun<true>(sel, const_cast<char *>(buf), packed,
+                              numThreads);
+}
+
+// NdCopyScatterPoints()
+// the reverse of NdCopyGatherPoints(): writes element i of packed to the
+// i-th point of sel in buf. of points given more than once, the last one
+// wins.
+inline int NdCopyScatterPoints(const NdCopyPointSelection &sel,
+                               const char *packed, char *buf,
+                               size_t numThreads) {
+  return NdCopyPointRun<false>(sel, buf, const_cast<char *>(packed),
+                               numThreads);
+}
+//*************** End of the point gather/scatter and their helpers *********
+
+#endif
@@ -0,0 +1,418 @@
+//
+//  NDCopyQuant.hpp
+//  src
+//
+
+#ifndef NDCOPYQUANT_HPP
+#define NDCOPYQUANT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include "core/NdCpy/NDCopyPack.hpp"
+#include "core/NdCpy/NDCopySimd.hpp"
+#include "core/NdCpy/NDCopyTuning.hpp"
+
+// NdCopyQuantFormat
+// the 16 bit formats NdCopyQuantize() reduces float/double elements to
+enum NdCopyQuantFormat : int {
+  // IEEE half precision, rounded to nearest even
+  NdCopyQuantFp16,
+  // the upper half of a float, rounded to nearest even
+  NdCopyQuantBf16,
+  // unsigned 16 bit steps between the minimum and the maximum of every
+  // NdCopyQuantBlockElms elements, stored as int16 (-32768 is the minimum)
+  NdCopyQuantInt16
+};
+
+// elements per quantization block: the granularity of the int16 scales and
+// the unit the gather into the conversion kernels and the threads work in
+const size_t NdCopyQuantBlockElms = 4096;
+
+//***************Start of the 16 bit conversions ***************
+// Scalar conversions of single elements: the software fallback of the block
+// kernels and the reference for the vector paths. double elements are
+// rounded to float first, so a double that lies very close to the midpoint
+// of two halfs (bfloat16s) may round the other way than in one step.
+
+// NdCopyFloatToHalf(): helper function
+static inline uint16_t NdCopyFloatToHalf(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, 4);
+  const uint32_t sign = (x >> 16) & 0x8000;
+  x &= 0x7fffffff;
+  // inf and nan, nans stay quiet
+  if (x >= 0x7f800000)
+    return static_cast<uint16_t>(sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0));
+  // 65520 and up round to inf
+  if (x >= 0x477ff000)
+    return static_cast<uint16_t>(sign | 0x7c00);
+  // below 2^-14: subnormal halfs, in units of 2^-24
+  if (x < 0x38800000) {
+    if (x < 0x33000000)
+      return static_cast<uint16_t>(sign);
+    const uint32_t m = (x & 0x7fffff) | 0x800000;
+    const uint32_t shift = 126 - (x >> 23);
+    uint32_t h = m >> shift;
+    const uint32_t rem = m & ((1u << shift) - 1);
+    const uint32_t half = 1u << (shift - 1);
+    if (rem > half || (rem == half && (h & 1)))
+      h++;
+    return static_cast<uint16_t>(sign | h);
+  }
+  // normal: rebias the exponent, round away the 13 low mantissa bits (a
+  // carry moves on into the exponent)
+  uint32_t h = (x >> 13) - (112 << 10);
+  const uint32_t rem = x & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+    h++;
+  return static_cast<uint16_t>(sign | h);
+}
+
+// NdCopyHalfToFloat(): helper function
+static inline float NdCopyHalfToFloat(uint16_t h) {
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  const uint32_t e = (h >> 10) & 0x1f;
+  const uint32_t m = h & 0x3ff;
+  uint32_t x;
+  if (e == 0x1f)
+    x = sign | 0x7f800000 | (m << 13);
+  else if (e != 0)
+    x = sign | ((e + 112) << 23) | (m << 13);
+  else {
+    // zero and subnormals, exact in float
+    float f = static_cast<float>(m) * 5.9604644775390625e-8f;
+    std::memcpy(&x, &f, 4);
+    x |= sign;
+  }
+  float f;
+  std::memcpy(&f, &x, 4);
+  return f;
+}
+
+// NdCopyFloatToBf16(): helper function
+static inline uint16_t NdCopyFloatToBf16(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, 4);
+  if ((x & 0x7fffffff) > 0x7f800000)
+    return static_cast<uint16_t>((x >> 16) | 0x40);
+  return static_cast<uint16_t>((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+// NdCopyBf16ToFloat(): helper function
+static inline float NdCopyBf16ToFloat(uint16_t b) {
+  const uint32_t x = static_cast<uint32_t>(b) << 16;
+  float f;
+  std::memcpy(&f, &x, 4);
+  return f;
+}
+//*************** End of the 16 bit conversions ***************
+
+//***************Start of the quantization block kernels ***************
+// One quantization block of n <= NdCopyQuantBlockElms contiguous elements to
+// and from n 16 bit values, written unaligned in host byte order. they are
+// plain loops the compiler vectorizes, plus F16C for the half conversions
+// where the build targets it; the library build calls the selected ISA
+// level's build (NDCopySimd.hpp). param holds the int16 minimum and step.
+
+// NdCopyHalfRow(): helper function
+static void NdCopyHalfRow(const float *in, char *out, size_t n) {
+  size_t i = 0;
+#if defined(__F16C__)
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(out + 2 * i),
+        _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+  for (; i < n; i++) {
+    const uint16_t h = NdCopyFloatToHalf(in[i]);
+    std::memcpy(out + 2 * i, &h, 2);
+  }
+}
+
+// NdCopyHalfRowToFloat(): helper function
+static void NdCopyHalfRowToFloat(const char *in, float *out, size_t n) {
+  size_t i = 0;
+#if defined(__F16C__)
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(out + i,
+                     _mm256_cvtph_ps(_mm_loadu_si128(
+                         reinterpret_cast<const __m128i *>(in + 2 * i))));
+#endif
+  for (; i < n; i++) {
+    uint16_t h;
+    std::memcpy(&h, in + 2 * i, 2);
+    out[i] = NdCopyHalfToFloat(h);
+  }
+}
+
+// NdCopyQuantInt16Elm(): helper function
+// stores the element steps steps above the block minimum. steps is clamped
+// to [0, 65535] before the conversion, which is undefined out of range (and
+// for the NaN of a NaN element, stored as the maximum).
+template <class T>
+static inline void NdCopyQuantInt16Elm(T steps, char *out) {
+  T x = steps + T(0.5);
+  x = x < T(65535) ? x : T(65535);
+  x = x > T(0) ? x : T(0);
+  const int16_t v = static_cast<int16_t>(static_cast<int32_t>(x) - 32768);
+  std::memcpy(out, &v, 2);
+}
+
+// NdCopyQuantBlockT(): helper function
+template <class T>
+static void NdCopyQuantBlockT(const T *in, char *out, size_t n,
+                              NdCopyQuantFormat format, T *param) {
+  if (format == NdCopyQuantFp16) {
+    if (std::is_same<T, float>::value) {
+      NdCopyHalfRow(reinterpret_cast<const float *>(in), out, n);
+      return;
+    }
+    float f[NdCopyQuantBlockElms];
+    for (size_t i = 0; i < n; i++)
+      f[i] = static_cast<float>(in[i]);
+    NdCopyHalfRow(f, out, n);
+  } else if (format == NdCopyQuantBf16) {
+    for (size_t i = 0; i < n; i++) {
+      const uint16_t b = NdCopyFloatToBf16(static_cast<float>(in[i]));
+      std::memcpy(out + 2 * i, &b, 2);
+    }
+  } else {
+    // the minimum and the maximum in 8 lanes, which the compiler keeps in
+    // vector registers (a plain reduction it may not reorder)
+    T lanesLo[8], lanesHi[8];
+    for (size_t l = 0; l < 8; l++)
+      lanesLo[l] = lanesHi[l] = in[0];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+      for (size_t l = 0; l < 8; l++) {
+        lanesLo[l] = in[i + l] < lanesLo[l] ? in[i + l] : lanesLo[l];
+        lanesHi[l] = in[i + l] > lanesHi[l] ? in[i + l] : lanesHi[l];
+      }
+    for (; i < n; i++) {
+      lanesLo[0] = in[i] < lanesLo[0] ? in[i] : lanesLo[0];
+      lanesHi[0] = in[i] > lanesHi[0] ? in[i] : lanesHi[0];
+    }
+    T lo = lanesLo[0], hi = lanesHi[0];
+    for (size_t l = 1; l < 8; l++) {
+      lo = lanesLo[l] < lo ? lanesLo[l] : lo;
+      hi = lanesHi[l] > hi ? lanesHi[l] : hi;
+    }
+    const T step = (hi - lo) / T(65535);
+    const T inv = step > T(0) ? T(1) / step : T(0);
+    if (std::isfinite(inv)) {
+      for (size_t i = 0; i < n; i++)
+        NdCopyQuantInt16Elm((in[i] - lo) * inv, out + 2 * i);
+    } else {
+      // a subnormal step (a nearly constant block) has no finite inverse.
+      // the step is stored rounded, so such blocks come back with an error
+      // of up to 65535 times half the smallest subnormal on top
+      for (size_t i = 0; i < n; i++)
+        NdCopyQuantInt16Elm((in[i] - lo) / step, out + 2 * i);
+    }
+    param[0] = lo;
+    param[1] = step;
+  }
+}
+
+// NdCopyDequantBlockT(): helper function
+template <class T>
+static void NdCopyDequantBlockT(const char *in, T *out, size_t n,
+                                NdCopyQuantFormat format, const T *param) {
+  if (format == NdCopyQuantFp16) {
+    if (std::is_same<T, float>::value) {
+      NdCopyHalfRowToFloat(in, reinterpret_cast<float *>(out), n);
+      return;
+    }
+    float f[NdCopyQuantBlockElms];
+    NdCopyHalfRowToFloat(in, f, n);
+    for (size_t i = 0; i < n; i++)
+      out[i] = f[i];
+  } else if (format == NdCopyQuantBf16) {
+    for (size_t i = 0; i < n; i++) {
+      uint16_t b;
+      std::memcpy(&b, in + 2 * i, 2);
+      out[i] = NdCopyBf16ToFloat(b);
+    }
+  } else {
+    const T lo = param[0], step = param[1];
+    for (size_t i = 0; i < n; i++) {
+      int16_t v;
+      std::memcpy(&v, in + 2 * i, 2);
+      out[i] = lo + T(int32_t(v) + 32768) * step;
+    }
+  }
+}
+
+// NdCopyQuantBlock(): helper function
+static inline void NdCopyQuantBlock(const float *in, char *out, size_t n,
+                                    NdCopyQuantFormat format, float *param) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  NdCopySimd().quantFloat(in, out, n, format, param);
+#else
+  NdCopyQuantBlockT<float>(in, out, n, format, param);
+#endif
+}
+
+static inline void NdCopyQuantBlock(const double *in, char *out, size_t n,
+                                    NdCopyQuantFormat format, double *param) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  NdCopySimd().quantDouble(in, out, n, format, param);
+#else
+  NdCopyQuantBlockT<double>(in, out, n, format, param);
+#endif
+}
+
+// NdCopyDequantBlock(): helper function
+static inline void NdCopyDequantBlock(const char *in, float *out, size_t n,
+                                      NdCopyQuantFormat format,
+                                      const float *param) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  NdCopySimd().dequantFloat(in, out, n, format, param);
+#else
+  NdCopyDequantBlockT<float>(in, out, n, format, param);
+#endif
+}
+
+static inline void NdCopyDequantBlock(const char *in, double *out, size_t n,
+                                      NdCopyQuantFormat format,
+                                      const double *param) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  NdCopySimd().dequantDouble(in, out, n, format, param);
+#else
+  NdCopyDequantBlockT<double>(in, out, n, format, param);
+#endif
+}
+//*************** End of the quantization block kernels ***************
+
+template <class T>
+size_t NdCopyQuantizedBytes(const NdCopyPackType &type,
+                            NdCopyQuantFormat format);
+template <class T>
+int NdCopyQuantize(const NdCopyPackType &type, const char *buf,
+                   char *quantized, NdCopyQuantFormat format,
+                   size_t numThreads = 0);
+template <class T>
+int NdCopyDequantize(const NdCopyPackType &type, const char *quantized,
+                     char *buf, NdCopyQuantFormat format,
+                     size_t numThreads = 0);
+
+//***************Start of NdCopyQuantize(), NdCopyDequantize() and helpers ***
+// NdCopyPack()/NdCopyUnpack() of float or double elements with the packed
+// message in a 16 bit format. the box is walked in quantization blocks: the
+// runs of a block are gathered into a stack buffer and converted in one go
+// into the message (scattered out of one for the inverse), so the source is
+// read once and no full size temporary is needed. the quantized message
+// holds one 16 bit value per element in the order of the packed message,
+// followed for NdCopyQuantInt16 by the minimum and the step of every block,
+// two elements of type T each; everything in host byte order.
+
+// NdCopyQuantRange(): helper function
+// quantizes/dequantizes quantization blocks [lo, hi)
+template <class T, bool Quant>
+static void NdCopyQuantRange(const NdCopyPackType &type, char *buf,
+                             char *quantized, NdCopyQuantFormat format,
+                             size_t lo, size_t hi) {
+  const size_t numElms = type.GetPackedBytes() / sizeof(T);
+  char *params = quantized + 2 * numElms;
+  T stage[NdCopyQuantBlockElms];
+  for (size_t b = lo; b < hi; b++) {
+    const size_t first = b * NdCopyQuantBlockElms;
+    const size_t n = std::min(NdCopyQuantBlockElms, numElms - first);
+    T param[2] = {T(0), T(0)};
+    char *q = quantized + 2 * first;
+    char *s = reinterpret_cast<char *>(stage);
+    if (Quant) {
+      NdCopyPackRuns(type, buf, sizeof(T), first, first + n,
+                     [&s](char *run, size_t elms) {
+                       std::memcpy(s, run, elms * sizeof(T));
+                       s += elms * sizeof(T);
+                     });
+      NdCopyQuantBlock(stage, q, n, format, param);
+      if (format == NdCopyQuantInt16)
+        std::memcpy(params + b * sizeof(param), param, sizeof(param));
+    } else {
+      if (format == NdCopyQuantInt16)
+        std::memcpy(param, params + b * sizeof(param), sizeof(param));
+      NdCopyDequantBlock(q, stage, n, format, param);
+      NdCopyPackRuns(type, buf, sizeof(T), first, first + n,
+                     [&s](char *run, size_t elms) {
+                       std::memcpy(run, s, elms * sizeof(T));
+                       s += elms * sizeof(T);
+                     });
+    }
+  }
+}
+
+// NdCopyQuantRun(): helper function
+// runs NdCopyQuantRange() over the quantization blocks
+template <class T, bool Quant>
+static int NdCopyQuantRun(const NdCopyPackType &type, char *buf,
+                          char *quantized, NdCopyQuantFormat format,
+                          size_t numThreads) {
+  static_assert(std::is_same<T, float>::value ||
+                    std::is_same<T, double>::value,
+                "quantization is for float and double elements");
+  if (!type.IsValid() || type.GetBlockSize() % sizeof(T) != 0 ||
+      format < NdCopyQuantFp16 || format > NdCopyQuantInt16)
+    return -1;
+  const size_t numElms = type.GetPackedBytes() / sizeof(T);
+  const size_t total =
+      (numElms + NdCopyQuantBlockElms - 1) / NdCopyQuantBlockElms;
+  NdCopyParallelFor(total, type.GetPackedBytes(), numThreads,
+                    [&](size_t lo, size_t hi) {
+                      NdCopyQuantRange<T, Quant>(type, buf, quantized, format,
+                                                 lo, hi);
+                    });
+  return 0;
+}
+
+// NdCopyQuantizedBytes()
+// size of the quantized message of the box described by type
+template <class T>
+size_t NdCopyQuantizedBytes(const NdCopyPackType &type,
+                            NdCopyQuantFormat format) {
+  const size_t numElms = type.GetPackedBytes() / sizeof(T);
+  size_t bytes = 2 * numElms;
+  if (format == NdCopyQuantInt16)
+    bytes += (numElms + NdCopyQuantBlockElms - 1) / NdCopyQuantBlockElms * 2 *
+             sizeof(T);
+  return bytes;
+}
+
+// NdCopyQuantize()
+// copies the float or double elements of the box described by type out of
+// buf into the message quantized (NdCopyQuantizedBytes() bytes), converted
+// to format in the same pass. NdCopyQuantInt16 needs finite elements; its
+// error is at most half a step, (max - min) / 131070 of the block.
+// numThreads 0 picks one thread for small messages and several for big
+// ones. returns 0, or -1 for an invalid type or format.
+template <class T>
+int NdCopyQuantize(const NdCopyPackType &type, const char *buf,
+                   char *quantized, NdCopyQuantFormat format,
+                   size_t numThreads) {
+  return NdCopyQuantRun<T, true>(type, const_cast<char *>(buf), quantized,
+                                 format, numThreads);
+}
+
+// NdCopyDequantize()
+// the reverse of NdCopyQuantize(): converts the message quantized back to
+// T and scatters it into the box described by type in buf
+template <class T>
+int NdCopyDequantize(const NdCopyPackType &type, const char *quantized,
+                     char *buf, NdCopyQuantFormat format,
+                     size_t numThreads) {
+  return NdCopyQuantRun<T, false>(type, buf, const_cast<char *>(quantized),
+                                  format, numThreads);
+}
+//*************** End of NdCopyQuantize(), NdCopyDequantize() and helpers ***
+
+#endif
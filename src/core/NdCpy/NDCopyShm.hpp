@@ -0,0 +1,361 @@
+//
+//  NDCopyShm.hpp
+//  src
+//
+
+#ifndef NDCOPYSHM_HPP
+#define NDCOPYSHM_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/NdCpy/NDCopy.hpp"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "the shared memory ring needs lock free 64 bit atomics");
+
+//***************Start of NdCopyShmRing and its helpers ***************
+// Moves sub-arrays between two processes on the same node through POSIX
+// shared memory, with one copy on each side and no kernel copy:
+// the producer NdCopy()s its selection straight into a ring slot, in its own
+// major/endianess, next to a small geometry header; the consumer NdCopy()s
+// from the slot into its own layout. single producer, single consumer;
+// head and tail are lock free counters on separate cache lines. a side that
+// waits for the other gives up when its timeout passes or the other process
+// has exited, so that a crashed peer does not leave it hanging.
+
+// NdCopyShmSlotHeader
+// geometry of the box held in a slot, followed by the payload
+struct NdCopyShmSlotHeader {
+  static const size_t MaxDims = 8;
+  uint32_t numDims;
+  uint32_t elmSize;
+  uint8_t isRowMajor;
+  uint8_t isLittleEndian;
+  uint64_t payloadBytes;
+  uint64_t start[MaxDims];
+  uint64_t count[MaxDims];
+};
+
+// NdCopyShmRing
+// the ring itself: Create() on one side, Open() on the other (in any order
+// as long as Create() comes first). the creator unlinks the name when it is
+// destroyed; the mapping stays valid for the other side until it closes.
+// both record their pid in the ring, so that each can tell when the other
+// is gone (a child that has exited but is not reaped yet still counts as
+// alive; the timeout covers that).
+class NdCopyShmRing {
+public:
+  NdCopyShmRing() = default;
+  NdCopyShmRing(const NdCopyShmRing &) = delete;
+  NdCopyShmRing &operator=(const NdCopyShmRing &) = delete;
+  ~NdCopyShmRing() { Detach(); }
+
+  // returns 0 on success, -1 on failure
+  int Create(const char *name, size_t numSlots, size_t maxPayloadBytes) {
+    Detach();
+    if (numSlots == 0)
+      return -1;
+    const size_t slotBytes =
+        RoundUp(sizeof(NdCopyShmSlotHeader) + maxPayloadBytes, 64);
+    const size_t bytes = RoundUp(sizeof(Control), 64) + numSlots * slotBytes;
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+      return -1;
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0 ||
+        Map(fd, bytes) != 0) {
+      close(fd);
+      shm_unlink(name);
+      return -1;
+    }
+    close(fd);
+    m_Name = name;
+    m_Owner = true;
+    m_Control = new (m_Base) Control();
+    m_Control->numSlots = numSlots;
+    m_Control->slotBytes = slotBytes;
+    m_Control->closed.store(0, std::memory_order_relaxed);
+    m_Control->pids[0].store(getpid(), std::memory_order_relaxed);
+    m_Control->pids[1].store(0, std::memory_order_relaxed);
+    m_Control->head.store(0, std::memory_order_relaxed);
+    m_Control->tail.store(0, std::memory_order_relaxed);
+    m_Control->magic.store(Magic, std::memory_order_release);
+    return 0;
+  }
+
+  // returns 0 on success, -1 if there is no ring of that name or its
+  // control block does not describe a ring that fits the segment (a stale
+  // segment, or one of another layout)
+  int Open(const char *name) {
+    Detach();
+    const int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0)
+      return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(Control) ||
+        Map(fd, static_cast<size_t>(st.st_size)) != 0) {
+      close(fd);
+      return -1;
+    }
+    close(fd);
+    m_Control = reinterpret_cast<Control *>(m_Base);
+    if (m_Control->magic.load(std::memory_order_acquire) != Magic ||
+        !FitsSegment(m_Control->numSlots, m_Control->slotBytes, m_Bytes)) {
+      Detach();
+      return -1;
+    }
+    m_Control->pids[1].store(getpid(), std::memory_order_release);
+    return 0;
+  }
+
+  // milliseconds AcquireSlot() and PeekSlot() wait at most, -1 (the
+  // default) for no limit
+  void SetTimeout(int64_t timeoutMs) { m_TimeoutMs = timeoutMs; }
+
+  // the producer has closed the ring and every slot has been consumed
+  bool IsDrained() const {
+    return m_Control->closed.load(std::memory_order_acquire) &&
+           m_Control->head.load(std::memory_order_acquire) ==
+               m_Control->tail.load(std::memory_order_acquire);
+  }
+
+  size_t GetMaxPayloadBytes() const {
+    return m_Control->slotBytes - sizeof(NdCopyShmSlotHeader);
+  }
+
+  // producer side: the next free slot, waiting for one if the ring is full;
+  // null if none frees up before the timeout or the consumer is gone
+  NdCopyShmSlotHeader *AcquireSlot() {
+    const uint64_t head = m_Control->head.load(std::memory_order_relaxed);
+    if (!Wait([&]() {
+          return head - m_Control->tail.load(std::memory_order_acquire) <
+                 m_Control->numSlots;
+        }))
+      return nullptr;
+    return Slot(head);
+  }
+  // publishes the slot returned by AcquireSlot()
+  void CommitSlot() {
+    m_Control->head.fetch_add(1, std::memory_order_release);
+  }
+  // no more slots will be committed
+  void CloseProducer() {
+    m_Control->closed.store(1, std::memory_order_release);
+  }
+
+  // consumer side: the oldest committed slot, waiting for one; null once
+  // the producer has closed and everything has been consumed (IsDrained()),
+  // or if nothing arrives before the timeout or the producer is gone
+  const NdCopyShmSlotHeader *PeekSlot() {
+    const uint64_t tail = m_Control->tail.load(std::memory_order_relaxed);
+    bool ready = false;
+    if (!Wait([&]() {
+          ready = m_Control->head.load(std::memory_order_acquire) != tail;
+          return ready || m_Control->closed.load(std::memory_order_acquire);
+        }))
+      return nullptr;
+    // the producer may have committed right before closing
+    if (!ready && m_Control->head.load(std::memory_order_acquire) == tail)
+      return nullptr;
+    return Slot(tail);
+  }
+  // hands the slot returned by PeekSlot() back to the producer
+  void ReleaseSlot() {
+    m_Control->tail.fetch_add(1, std::memory_order_release);
+  }
+
+private:
+  static const uint64_t Magic = 0x4e64437079526e32ull; // "NdCpyRn2"
+
+  struct Control {
+    std::atomic<uint64_t> magic;
+    uint64_t numSlots;
+    uint64_t slotBytes;
+    std::atomic<uint32_t> closed;
+    // creator, opener; 0 until that side is attached
+    std::atomic<int32_t> pids[2];
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+  };
+
+  static size_t RoundUp(size_t n, size_t a) { return (n + a - 1) / a * a; }
+
+  // FitsSegment(): whether numSlots slots of slotBytes each, after the
+  // control block, fit a segment of bytes (without overflowing)
+  static bool FitsSegment(uint64_t numSlots, uint64_t slotBytes,
+                          size_t bytes) {
+    const size_t slotsBase = RoundUp(sizeof(Control), 64);
+    return numSlots > 0 && slotBytes > sizeof(NdCopyShmSlotHeader) &&
+           bytes >= slotsBase && numSlots <= (bytes - slotsBase) / slotBytes;
+  }
+
+  int Map(int fd, size_t bytes) {
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      return -1;
+    m_Base = static_cast<char *>(p);
+    m_Bytes = bytes;
+    return 0;
+  }
+
+  void Detach() {
+    if (m_Base)
+      munmap(m_Base, m_Bytes);
+    if (m_Owner)
+      shm_unlink(m_Name.c_str());
+    m_Base = nullptr;
+    m_Control = nullptr;
+    m_Owner = false;
+  }
+
+  NdCopyShmSlotHeader *Slot(uint64_t index) {
+    return reinterpret_cast<NdCopyShmSlotHeader *>(
+        m_Base + RoundUp(sizeof(Control), 64) +
+        (index % m_Control->numSlots) * m_Control->slotBytes);
+  }
+
+  // PeerGone(): whether the process on the other side has exited
+  bool PeerGone() const {
+    const pid_t pid = m_Control->pids[m_Owner ? 1 : 0].load(
+        std::memory_order_acquire);
+    return pid > 0 && pid != getpid() && kill(pid, 0) != 0 && errno == ESRCH;
+  }
+
+  // Wait(): spins for a short while, then yields between polls, looking at
+  // the clock and the peer every 1024 polls. false if ready() still does
+  // not hold when the timeout passes or the peer is gone
+  template <class Pred>
+  bool Wait(Pred ready) const {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t spin = 0; !ready(); spin++) {
+      if (spin < 1024)
+        continue;
+      std::this_thread::yield();
+      if (spin % 1024 != 0)
+        continue;
+      const bool expired =
+          m_TimeoutMs >= 0 && std::chrono::steady_clock::now() - start >=
+                                  std::chrono::milliseconds(m_TimeoutMs);
+      if (expired || PeerGone())
+        return ready();
+    }
+    return true;
+  }
+
+  char *m_Base = nullptr;
+  size_t m_Bytes = 0;
+  Control *m_Control = nullptr;
+  std::string m_Name;
+  bool m_Owner = false;
+  int64_t m_TimeoutMs = -1;
+};
+
+// NdCopyShmPayload(): helper function
+inline char *NdCopyShmPayload(NdCopyShmSlotHeader *slot) {
+  return reinterpret_cast<char *>(slot + 1);
+}
+inline const char *NdCopyShmPayload(const NdCopyShmSlotHeader *slot) {
+  return reinterpret_cast<const char *>(slot + 1);
+}
+
+// NdCopyShmPut()
+// sends the part of the input box in within the selection selStart/selCount
+// as one message. the overlap is NdCopy()ed straight into the slot, keeping
+// the producer's major and endianess. dims are logical, whatever the major.
+// returns 0 on success, 1 if the
+// selection does not overlap the input (nothing is sent), 2 if no slot
+// frees up before the ring's timeout or the consumer is gone, -1 if the
+// overlap does not fit a slot or has too many dimensions.
+template <class T>
+int NdCopyShmPut(NdCopyShmRing &ring, const char *in, const Dims &inStart,
+                 const Dims &inCount, const bool inIsRowMajor,
+                 const bool inIsLittleEndian, const Dims &selStart,
+                 const Dims &selCount) {
+  const size_t numDims = inStart.size();
+  if (numDims == 0 || numDims > NdCopyShmSlotHeader::MaxDims)
+    return -1;
+  Dims ovlpStart(numDims), ovlpCount(numDims);
+  size_t payloadBytes = sizeof(T);
+  for (size_t i = 0; i < numDims; i++) {
+    ovlpStart[i] = std::max(inStart[i], selStart[i]);
+    const size_t end =
+        std::min(inStart[i] + inCount[i], selStart[i] + selCount[i]);
+    if (end <= ovlpStart[i])
+      return 1; // no overlap found
+    ovlpCount[i] = end - ovlpStart[i];
+    payloadBytes *= ovlpCount[i];
+  }
+  if (payloadBytes > ring.GetMaxPayloadBytes())
+    return -1;
+  NdCopyShmSlotHeader *slot = ring.AcquireSlot();
+  if (slot == nullptr)
+    return 2;
+  slot->numDims = static_cast<uint32_t>(numDims);
+  slot->elmSize = sizeof(T);
+  slot->isRowMajor = inIsRowMajor;
+  slot->isLittleEndian = inIsLittleEndian;
+  slot->payloadBytes = payloadBytes;
+  for (size_t i = 0; i < numDims; i++) {
+    slot->start[i] = ovlpStart[i];
+    slot->count[i] = ovlpCount[i];
+  }
+  NdCopy<T>(in, NdCopyMemOrder(inStart, inIsRowMajor),
+            NdCopyMemOrder(inCount, inIsRowMajor), true, inIsLittleEndian,
+            NdCopyShmPayload(slot), NdCopyMemOrder(ovlpStart, inIsRowMajor),
+            NdCopyMemOrder(ovlpCount, inIsRowMajor), true,
+            inIsLittleEndian);
+  ring.CommitSlot();
+  return 0;
+}
+
+// NdCopyShmGet()
+// receives the next message into the output box, converting to the
+// consumer's major and endianess on the way. dims are logical, whatever the
+// major. returns 0 on success, 1 if
+// the message does not overlap the output box (it is consumed anyway), 2
+// once the producer has closed the ring and it is empty, 3 if no message
+// arrives before the ring's timeout or the producer is gone, -1 if the
+// message holds a different element type.
+template <class T>
+int NdCopyShmGet(NdCopyShmRing &ring, char *out, const Dims &outStart,
+                 const Dims &outCount, const bool outIsRowMajor,
+                 const bool outIsLittleEndian) {
+  const NdCopyShmSlotHeader *slot = ring.PeekSlot();
+  if (slot == nullptr)
+    return ring.IsDrained() ? 2 : 3;
+  int res = -1;
+  if (slot->elmSize == sizeof(T) && slot->numDims == outStart.size()) {
+    Dims start(slot->start, slot->start + slot->numDims);
+    Dims count(slot->count, slot->count + slot->numDims);
+    if (!slot->isRowMajor && !outIsRowMajor)
+      res = NdCopy<T>(NdCopyShmPayload(slot), NdCopyMemOrder(start, false),
+                      NdCopyMemOrder(count, false), true,
+                      slot->isLittleEndian, out,
+                      NdCopyMemOrder(outStart, false),
+                      NdCopyMemOrder(outCount, false), true,
+                      outIsLittleEndian);
+    else
+      res = NdCopy<T>(NdCopyShmPayload(slot), start, count, slot->isRowMajor,
+                      slot->isLittleEndian, out, outStart, outCount,
+                      outIsRowMajor, outIsLittleEndian);
+  }
+  ring.ReleaseSlot();
+  return res;
+}
+//*************** End of NdCopyShmRing and its helpers ***************
+
+#endif
@@ -0,0 +1,345 @@
+//
+//  NDCopyShuffle.hpp
+//  src
+//
+
+#ifndef NDCOPYSHUFFLE_HPP
+#define NDCOPYSHUFFLE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "core/NdCpy/NDCopyPack.hpp"
+#include "core/NdCpy/NDCopySimd.hpp"
+#include "core/NdCpy/NDCopyTuning.hpp"
+
+// bytes of the stack buffer NdCopyPackShuffled()/NdCopyUnpackShuffled()
+// gather a part of the message in, the largest element size they take
+const size_t NdCopyShuffleBlockBytes = 32768;
+
+//***************Start of the byte shuffle kernels ***************
+// Shuffling n contiguous elements of elmSize bytes writes byte p of element i
+// to out[p * planeStride + i]: all bytes 0, then all bytes 1 and so on, as
+// Blosc's shuffle filter does (the byte planes of floats are far smoother
+// than the floats). unshuffling is the reverse.
+// elements of 2, 4 and 8 bytes go through a network of byte interleaves over
+// 16 elements at a time, one 16 byte vector per byte plane: every stage
+// interleaves the registers that differ in one bit of their index, which
+// rotates the bits of the byte addresses by one, until element index and
+// byte index have traded places. SSE2 vectors take 16 elements at a time,
+// AVX2 ones two groups of 16 side by side. other sizes, and the tails, are
+// moved byte by byte.
+
+// NdCopyShuffleTail(): helper function
+// elements [first, n) byte by byte
+template <bool Shuffle>
+static void NdCopyShuffleTail(const char *in, char *out, size_t first,
+                              size_t n, size_t elmSize, size_t planeStride) {
+  for (size_t i = first; i < n; i++)
+    for (size_t p = 0; p < elmSize; p++)
+      if (Shuffle)
+        out[p * planeStride + i] = in[i * elmSize + p];
+      else
+        out[i * elmSize + p] = in[p * planeStride + i];
+}
+
+#if defined(__SSE2__)
+// NdCopyShuffleUnpack(): helper function
+// interleaves the W bit units of the low (Hi false) or high halves of a and
+// b, per 128 bit lane
+template <size_t W, bool Hi>
+static inline __m128i NdCopyShuffleUnpack(__m128i a, __m128i b) {
+  return W == 8    ? (Hi ? _mm_unpackhi_epi8(a, b) : _mm_unpacklo_epi8(a, b))
+         : W == 16 ? (Hi ? _mm_unpackhi_epi16(a, b) : _mm_unpacklo_epi16(a, b))
+                   : (Hi ? _mm_unpackhi_epi32(a, b) : _mm_unpacklo_epi32(a, b));
+}
+
+#if defined(__AVX2__)
+template <size_t W, bool Hi>
+static inline __m256i NdCopyShuffleUnpack(__m256i a, __m256i b) {
+  return W == 8
+             ? (Hi ? _mm256_unpackhi_epi8(a, b) : _mm256_unpacklo_epi8(a, b))
+         : W == 16
+             ? (Hi ? _mm256_unpackhi_epi16(a, b) : _mm256_unpacklo_epi16(a, b))
+             : (Hi ? _mm256_unpackhi_epi32(a, b)
+                   : _mm256_unpacklo_epi32(a, b));
+}
+#endif
+
+// NdCopyShuffleStage(): helper function
+// interleaves the W bit units of every pair of the E registers that differ
+// in bit s of their index; the low halves' interleave replaces the register
+// with bit s clear, the high halves' the other one
+template <size_t E, size_t W, class V>
+static inline void NdCopyShuffleStage(V *x, size_t s) {
+  for (size_t i = 0; i < E; i++)
+    if (((i >> s) & 1) == 0) {
+      const size_t j = i | (size_t(1) << s);
+      const V lo = NdCopyShuffleUnpack<W, false>(x[i], x[j]);
+      const V hi = NdCopyShuffleUnpack<W, true>(x[i], x[j]);
+      x[i] = lo;
+      x[j] = hi;
+    }
+}
+
+// NdCopyShuffleNet(): helper function
+// shuffles the E registers of 16 elements of E bytes in place: afterwards
+// register NdCopyShufflePlaneReg<E>(p) holds byte plane p. the stages make
+// element bits e3..e0 enter the byte index in that order while the byte
+// plane bits leave it for the register index.
+template <size_t E, class V>
+static inline void NdCopyShuffleNet(V *x) {
+  if (E == 2) {
+    for (size_t k = 0; k < 4; k++)
+      NdCopyShuffleStage<E, 8>(x, 0);
+  } else if (E == 4) {
+    NdCopyShuffleStage<E, 8>(x, 1);
+    NdCopyShuffleStage<E, 8>(x, 0);
+    NdCopyShuffleStage<E, 8>(x, 1);
+    NdCopyShuffleStage<E, 8>(x, 0);
+  } else {
+    NdCopyShuffleStage<E, 8>(x, 2);
+    NdCopyShuffleStage<E, 8>(x, 1);
+    NdCopyShuffleStage<E, 8>(x, 0);
+    NdCopyShuffleStage<E, 8>(x, 2);
+  }
+}
+
+// NdCopyShufflePlaneReg(): helper function
+template <size_t E>
+static inline size_t NdCopyShufflePlaneReg(size_t p) {
+  return E == 8 ? ((p & 1) << 2) | ((p >> 2) << 1) | ((p >> 1) & 1) : p;
+}
+
+// NdCopyUnshuffleNet(): helper function
+// the reverse, register p holding byte plane p of 16 elements: widening
+// interleaves bring the byte planes back together, afterwards register
+// NdCopyUnshuffleChunkReg<E>(k) holds bytes [16k, 16k + 16) of the elements
+template <size_t E, class V>
+static inline void NdCopyUnshuffleNet(V *x) {
+  NdCopyShuffleStage<E, 8>(x, 0);
+  if (E >= 4)
+    NdCopyShuffleStage<E, 16>(x, 1);
+  if (E == 8)
+    NdCopyShuffleStage<E, 32>(x, 2);
+}
+
+// NdCopyUnshuffleChunkReg(): helper function
+// the index bits of k reversed
+template <size_t E>
+static inline size_t NdCopyUnshuffleChunkReg(size_t k) {
+  return E == 8 ? ((k & 1) << 2) | (k & 2) | (k >> 2)
+                : E == 4 ? ((k & 1) << 1) | (k >> 1) : k;
+}
+
+// NdCopyShuffleVec(): helper function
+// elements [0, n - n % 16) of E bytes; returns where the tail starts
+template <size_t E>
+static size_t NdCopyShuffleVec(const char *in, char *out, size_t n,
+                               size_t planeStride) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= n; i += 32) {
+    __m256i x[E];
+    for (size_t r = 0; r < E; r++)
+      x[r] = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(_mm_loadu_si128(
+              reinterpret_cast<const __m128i *>(in + i * E + 16 * r))),
+          _mm_loadu_si128(
+              reinterpret_cast<const __m128i *>(in + (i + 16) * E + 16 * r)),
+          1);
+    NdCopyShuffleNet<E>(x);
+    for (size_t p = 0; p < E; p++)
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i *>(out + p * planeStride + i),
+          x[NdCopyShufflePlaneReg<E>(p)]);
+  }
+#endif
+  for (; i + 16 <= n; i += 16) {
+    __m128i x[E];
+    for (size_t r = 0; r < E; r++)
+      x[r] = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(in + i * E + 16 * r));
+    NdCopyShuffleNet<E>(x);
+    for (size_t p = 0; p < E; p++)
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + p * planeStride + i),
+                       x[NdCopyShufflePlaneReg<E>(p)]);
+  }
+  return i;
+}
+
+// NdCopyUnshuffleVec(): helper function
+template <size_t E>
+static size_t NdCopyUnshuffleVec(const char *in, char *out, size_t n,
+                                 size_t planeStride) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= n; i += 32) {
+    __m256i x[E];
+    for (size_t p = 0; p < E; p++)
+      x[p] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(in + p * planeStride + i));
+    NdCopyUnshuffleNet<E>(x);
+    for (size_t k = 0; k < E; k++) {
+      const __m256i v = x[NdCopyUnshuffleChunkReg<E>(k)];
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * E + 16 * k),
+                       _mm256_castsi256_si128(v));
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(out + (i + 16) * E + 16 * k),
+          _mm256_extracti128_si256(v, 1));
+    }
+  }
+#endif
+  for (; i + 16 <= n; i += 16) {
+    __m128i x[E];
+    for (size_t p = 0; p < E; p++)
+      x[p] = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(in + p * planeStride + i));
+    NdCopyUnshuffleNet<E>(x);
+    for (size_t k = 0; k < E; k++)
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * E + 16 * k),
+                       x[NdCopyUnshuffleChunkReg<E>(k)]);
+  }
+  return i;
+}
+#endif
+
+// NdCopyShuffleBlockT(): helper function
+// shuffles (Shuffle true) or unshuffles n contiguous elements
+template <bool Shuffle>
+static void NdCopyShuffleBlockT(const char *in, char *out, size_t n,
+                                size_t elmSize, size_t planeStride) {
+  size_t first = 0;
+#if defined(__SSE2__)
+  switch (elmSize) {
+  case 2:
+    first = Shuffle ? NdCopyShuffleVec<2>(in, out, n, planeStride)
+                    : NdCopyUnshuffleVec<2>(in, out, n, planeStride);
+    break;
+  case 4:
+    first = Shuffle ? NdCopyShuffleVec<4>(in, out, n, planeStride)
+                    : NdCopyUnshuffleVec<4>(in, out, n, planeStride);
+    break;
+  case 8:
+    first = Shuffle ? NdCopyShuffleVec<8>(in, out, n, planeStride)
+                    : NdCopyUnshuffleVec<8>(in, out, n, planeStride);
+    break;
+  }
+#endif
+  NdCopyShuffleTail<Shuffle>(in, out, first, n, elmSize, planeStride);
+}
+
+// NdCopyShuffleBlock(): helper function
+// NdCopyShuffleBlockT(), through the selected ISA level's build in the
+// library build (NDCopySimd.hpp)
+template <bool Shuffle>
+static inline void NdCopyShuffleBlock(const char *in, char *out, size_t n,
+                                      size_t elmSize, size_t planeStride) {
+#if defined(NDCOPY_SIMD_DISPATCH)
+  if (Shuffle)
+    NdCopySimd().shuffle(in, out, n, elmSize, planeStride);
+  else
+    NdCopySimd().unshuffle(in, out, n, elmSize, planeStride);
+#else
+  NdCopyShuffleBlockT<Shuffle>(in, out, n, elmSize, planeStride);
+#endif
+}
+//*************** End of the byte shuffle kernels ***************
+
+int NdCopyPackShuffled(const NdCopyPackType &type, const char *buf,
+                       char *shuffled, size_t elmSize, size_t numThreads = 0);
+int NdCopyUnpackShuffled(const NdCopyPackType &type, const char *shuffled,
+                         char *buf, size_t elmSize, size_t numThreads = 0);
+
+//***************Start of NdCopyPackShuffled(), NdCopyUnpackShuffled() ******
+// NdCopyPack()/NdCopyUnpack() with the packed message byte shuffled: the
+// box is walked in parts of NdCopyShuffleBlockBytes, whose runs are
+// gathered into a stack buffer and shuffled from there straight into the
+// byte planes of the message (the reverse for unpacking), so layout change
+// and shuffle take one pass over the data.
+
+// NdCopyShuffleRange(): helper function
+// shuffles/unshuffles the parts [lo, hi) of partElms elements each
+template <bool Shuffle>
+static void NdCopyShuffleRange(const NdCopyPackType &type, char *buf,
+                               char *shuffled, size_t elmSize,
+                               size_t partElms, size_t lo, size_t hi) {
+  const size_t numElms = type.GetPackedBytes() / elmSize;
+  char stage[NdCopyShuffleBlockBytes];
+  for (size_t b = lo; b < hi; b++) {
+    const size_t first = b * partElms;
+    const size_t n = std::min(partElms, numElms - first);
+    char *s = stage;
+    if (Shuffle) {
+      NdCopyPackRuns(type, buf, elmSize, first, first + n,
+                     [&s, elmSize](char *run, size_t elms) {
+                       std::memcpy(s, run, elms * elmSize);
+                       s += elms * elmSize;
+                     });
+      NdCopyShuffleBlock<true>(stage, shuffled + first, n, elmSize, numElms);
+    } else {
+      NdCopyShuffleBlock<false>(shuffled + first, stage, n, elmSize, numElms);
+      NdCopyPackRuns(type, buf, elmSize, first, first + n,
+                     [&s, elmSize](char *run, size_t elms) {
+                       std::memcpy(run, s, elms * elmSize);
+                       s += elms * elmSize;
+                     });
+    }
+  }
+}
+
+// NdCopyShuffleRun(): helper function
+// runs NdCopyShuffleRange() over parts of partElms elements
+template <bool Shuffle>
+static int NdCopyShuffleRun(const NdCopyPackType &type, char *buf,
+                            char *shuffled, size_t elmSize,
+                            size_t numThreads) {
+  if (!type.IsValid() || elmSize == 0 || elmSize > NdCopyShuffleBlockBytes ||
+      type.GetBlockSize() % elmSize != 0)
+    return -1;
+  // a multiple of 32 elements where the element size allows, so that only
+  // the last part has a tail the vector kernels leave over
+  size_t partElms = NdCopyShuffleBlockBytes / elmSize;
+  if (partElms >= 32)
+    partElms -= partElms % 32;
+  const size_t numElms = type.GetPackedBytes() / elmSize;
+  const size_t total = (numElms + partElms - 1) / partElms;
+  NdCopyParallelFor(total, type.GetPackedBytes(), numThreads,
+                    [&](size_t lo, size_t hi) {
+                      NdCopyShuffleRange<Shuffle>(type, buf, shuffled, elmSize,
+                                                  partElms, lo, hi);
+                    });
+  return 0;
+}
+
+// NdCopyPackShuffled()
+// copies the box described by type out of buf into shuffled
+// (type.GetPackedBytes() bytes) byte shuffled: the elements of elmSize bytes
+// in packed order, byte 0 of every element first, then byte 1 and so on.
+// numThreads 0 picks one thread for small messages and several for big
+// ones. returns 0, or -1 for an invalid type or an element size the type
+// does not fit or of more than NdCopyShuffleBlockBytes.
+inline int NdCopyPackShuffled(const NdCopyPackType &type, const char *buf,
+                              char *shuffled, size_t elmSize,
+                              size_t numThreads) {
+  return NdCopyShuffleRun<true>(type, const_cast<char *>(buf), shuffled,
+                                elmSize, numThreads);
+}
+
+// NdCopyUnpackShuffled()
+// the reverse of NdCopyPackShuffled(): unshuffles the message shuffled and
+// scatters it into the box described by type in buf
+inline int NdCopyUnpackShuffled(const NdCopyPackType &type,
+                                const char *shuffled, char *buf,
+                                size_t elmSize, size_t numThreads) {
+  return NdCopyShuffleRun<false>(type, buf, const_cast<char *>(shuffled),
+                                 elmSize, numThreads);
+}
+//*************** End of NdCopyPackShuffled(), NdCopyUnpackShuffled() ******
+
+#endif
@@ -0,0 +1,119 @@
+//
+//  NDCopySimd.cpp
+//  src
+//
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "core/NdCpy/NDCopySimd.hpp"
+
+// the tables, one per NDCopySimdKernels.cpp build (see CMakeLists.txt)
+extern const NdCopySimdKernels NdCopySimdKernelsGeneric;
+#if defined(NDCOPY_SIMD_HAVE_AVX2)
+extern const NdCopySimdKernels NdCopySimdKernelsAvx2;
+#endif
+#if defined(NDCOPY_SIMD_HAVE_AVX512)
+extern const NdCopySimdKernels NdCopySimdKernelsAvx512;
+#endif
+
+// constant initialized, so copies made by constructors that run before the
+// selection below get the generic kernels rather than a null table
+const NdCopySimdKernels *NdCopySimdSelected = &NdCopySimdKernelsGeneric;
+
+// NdCopySimdTable(): helper function
+// the table of level, null if it is not compiled in
+static const NdCopySimdKernels *NdCopySimdTable(NdCopySimdLevel level) {
+  switch (level) {
+  case NdCopySimdGeneric:
+    return &NdCopySimdKernelsGeneric;
+#if defined(NDCOPY_SIMD_HAVE_AVX2)
+  case NdCopySimdAvx2:
+    return &NdCopySimdKernelsAvx2;
+#endif
+#if defined(NDCOPY_SIMD_HAVE_AVX512)
+  case NdCopySimdAvx512:
+    return &NdCopySimdKernelsAvx512;
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+// NdCopySimdCpuHas(): helper function
+// whether the cpu and the OS support level: the instruction sets from cpuid
+// and, since the kernels use ymm/zmm registers, the OS saving those on
+// context switches (OSXSAVE and the XCR0 state bits)
+static bool NdCopySimdCpuHas(NdCopySimdLevel level) {
+  if (level == NdCopySimdGeneric)
+    return true;
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  const bool osxsave = (ecx & (1u << 27)) != 0;
+  const bool avx = (ecx & (1u << 28)) != 0;
+  // the half conversions of the avx2 and avx512 builds use F16C
+  const bool f16c = (ecx & (1u << 29)) != 0;
+  if (!osxsave || !avx || !f16c)
+    return false;
+  unsigned int xcr0Lo, xcr0Hi;
+  __asm__ volatile("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+  // SSE and AVX state
+  if ((xcr0Lo & 0x6u) != 0x6u)
+    return false;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+  const bool avx2 = (ebx & (1u << 5)) != 0;
+  if (level == NdCopySimdAvx2)
+    return avx2;
+  const bool avx512f = (ebx & (1u << 16)) != 0;
+  const bool avx512bw = (ebx & (1u << 30)) != 0;
+  // opmask and the upper zmm state
+  return avx2 && avx512f && avx512bw && (xcr0Lo & 0xe0u) == 0xe0u;
+#else
+  return false;
+#endif
+}
+
+bool NdCopySimdSupported(NdCopySimdLevel level) {
+  return NdCopySimdTable(level) != nullptr && NdCopySimdCpuHas(level);
+}
+
+int NdCopySimdSetLevel(NdCopySimdLevel level) {
+  if (!NdCopySimdSupported(level))
+    return -1;
+  NdCopySimdSelected = NdCopySimdTable(level);
+  return 0;
+}
+
+const char *NdCopySimdLevelName(NdCopySimdLevel level) {
+  switch (level) {
+  case NdCopySimdAvx2:
+    return "avx2";
+  case NdCopySimdAvx512:
+    return "avx512";
+  default:
+    return "generic";
+  }
+}
+
+// NdCopySimdInit(): helper function
+// runs when the library is loaded: the best supported level, capped by
+// NDCOPY_SIMD
+__attribute__((constructor)) static void NdCopySimdInit() {
+  NdCopySimdLevel cap = NdCopySimdAvx512;
+  const char *env = std::getenv("NDCOPY_SIMD");
+  if (env != nullptr)
+    for (int l = NdCopySimdGeneric; l <= NdCopySimdAvx512; l++)
+      if (std::strcmp(env, NdCopySimdLevelName(NdCopySimdLevel(l))) == 0)
+        cap = NdCopySimdLevel(l);
+  for (int l = cap; l > NdCopySimdGeneric; l--)
+    if (NdCopySimdSetLevel(NdCopySimdLevel(l)) == 0)
+      return;
+  NdCopySimdSetLevel(NdCopySimdGeneric);
+}
@@ -0,0 +1,92 @@
+//
+//  NDCopySimd.hpp
+//  src
+//
+
+#ifndef NDCOPYSIMD_HPP
+#define NDCOPYSIMD_HPP
+
+#include <cstddef>
+#include <vector>
+
+struct NdCopyElmDesc;
+struct NdCopyTuning;
+enum NdCopyQuantFormat : int;
+
+//***************Start of the ISA level dispatch ***************
+// The library build (target ndcopy in CMakeLists.txt) compiles the vectorized
+// kernels once per ISA level and defines NDCOPY_SIMD_DISPATCH for everything
+// that links it. the headers then call the kernels below through the table of
+// the best level the cpu supports, selected once when the library is loaded
+// (cpuid for the instruction sets, xgetbv for the OS saving their registers).
+// without NDCOPY_SIMD_DISPATCH the headers compile the kernels inline for
+// whatever the compiler targets, as before.
+// the environment variable NDCOPY_SIMD=generic|avx2|avx512 caps the level,
+// e.g. to compare levels or to rule out a kernel.
+
+enum NdCopySimdLevel { NdCopySimdGeneric, NdCopySimdAvx2, NdCopySimdAvx512 };
+
+// NdCopySimdKernels
+// one ISA level's build of the vectorized kernels
+struct NdCopySimdKernels {
+  NdCopySimdLevel level;
+  // NdCopyRevUnits<2/4/8>(): the byte swap of NdCopyRevEndianElms()
+  void (*revUnits2)(char *out, const char *in, size_t numUnits);
+  void (*revUnits4)(char *out, const char *in, size_t numUnits);
+  void (*revUnits8)(char *out, const char *in, size_t numUnits);
+  // NdCopyAlignedBlock(), null where memcpy wins (16 byte vectors)
+  void (*alignedBlock)(char *out, const char *in, size_t size);
+  // NdCopyIterDFSeqPaddingSmallDispatch(): the small-block kernel
+  void (*seqPaddingSmall)(const char *inOvlpBase, char *outOvlpBase,
+                          const std::vector<size_t> &inOvlpGapSize,
+                          const std::vector<size_t> &outOvlpGapSize,
+                          const std::vector<size_t> &ovlpCount,
+                          size_t minContDim, size_t blockSize);
+  // NdCopyStridedExec(): the tiled transposition and its neighbours
+  void (*stridedExec)(const char *in, char *out,
+                      const std::vector<size_t> &count,
+                      const std::vector<std::ptrdiff_t> &inStride,
+                      const std::vector<std::ptrdiff_t> &outStride,
+                      size_t elmSize, const NdCopyElmDesc *revEndian,
+                      const NdCopyTuning &tuning);
+  // NdCopyPointOffsets(): the offsets of an NdCopyPointSelection
+  bool (*pointOffsets)(const size_t *coords, size_t numPoints, size_t numDims,
+                       const std::vector<size_t> &bufStart,
+                       const std::vector<size_t> &bufCount,
+                       const std::vector<size_t> &stride, size_t *offsets);
+  // NdCopyQuantBlockT()/NdCopyDequantBlockT(): one quantization block
+  void (*quantFloat)(const float *in, char *out, size_t n,
+                     NdCopyQuantFormat format, float *param);
+  void (*quantDouble)(const double *in, char *out, size_t n,
+                      NdCopyQuantFormat format, double *param);
+  void (*dequantFloat)(const char *in, float *out, size_t n,
+                       NdCopyQuantFormat format, const float *param);
+  void (*dequantDouble)(const char *in, double *out, size_t n,
+                        NdCopyQuantFormat format, const double *param);
+  // NdCopyShuffleBlockT<true/false>(): byte (un)shuffling
+  void (*shuffle)(const char *in, char *out, size_t n, size_t elmSize,
+                  size_t planeStride);
+  void (*unshuffle)(const char *in, char *out, size_t n, size_t elmSize,
+                    size_t planeStride);
+};
+
+// the selected table, defined in NDCopySimd.cpp
+extern const NdCopySimdKernels *NdCopySimdSelected;
+
+// NdCopySimd()
+inline const NdCopySimdKernels &NdCopySimd() { return *NdCopySimdSelected; }
+
+// NdCopySimdSupported()
+// whether level is compiled into the library and runs on this cpu
+bool NdCopySimdSupported(NdCopySimdLevel level);
+
+// NdCopySimdSetLevel()
+// switches to another level, like NdCopySetTuning() to be called before
+// copies start. returns 0, or -1 if the level is not supported.
+int NdCopySimdSetLevel(NdCopySimdLevel level);
+
+// NdCopySimdLevelName()
+const char *NdCopySimdLevelName(NdCopySimdLevel level);
+//*************** End of the ISA level dispatch ***************
+
+#endif
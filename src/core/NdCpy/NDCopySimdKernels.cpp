@@ -0,0 +1,54 @@
+//
+//  NDCopySimdKernels.cpp
+//  src
+//
+// compiled once per ISA level with that level's compiler flags into a
+// library of its own that exports only the table (see CMakeLists.txt and
+// NDCopySimdKernels.map), NDCOPY_SIMD_TABLE and NDCOPY_SIMD_LEVEL naming the
+// table and the level. the kernels are the header ones, so this file only
+// collects them; it must not use the dispatch it implements.
+
+#undef NDCOPY_SIMD_DISPATCH
+
+#include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyLayout.hpp"
+#include "core/NdCpy/NDCopyPoints.hpp"
+#include "core/NdCpy/NDCopyQuant.hpp"
+#include "core/NdCpy/NDCopyShuffle.hpp"
+#include "core/NdCpy/NDCopySimd.hpp"
+
+#if !defined(NDCOPY_SIMD_TABLE) || !defined(NDCOPY_SIMD_LEVEL)
+#error "NDCOPY_SIMD_TABLE and NDCOPY_SIMD_LEVEL have to be defined"
+#endif
+
+static void NdCopySimdRevUnits2(char *out, const char *in, size_t numUnits) {
+  NdCopyRevUnits<2>(out, in, numUnits);
+}
+
+static void NdCopySimdRevUnits4(char *out, const char *in, size_t numUnits) {
+  NdCopyRevUnits<4>(out, in, numUnits);
+}
+
+static void NdCopySimdRevUnits8(char *out, const char *in, size_t numUnits) {
+  NdCopyRevUnits<8>(out, in, numUnits);
+}
+
+extern const NdCopySimdKernels NDCOPY_SIMD_TABLE = {
+    NDCOPY_SIMD_LEVEL,
+    NdCopySimdRevUnits2,
+    NdCopySimdRevUnits4,
+    NdCopySimdRevUnits8,
+#if defined(__AVX__)
+    NdCopyAlignedBlock,
+#else
+    nullptr,
+#endif
+    NdCopyIterDFSeqPaddingSmallDispatch,
+    NdCopyStridedExec,
+    NdCopyPointOffsets,
+    NdCopyQuantBlockT<float>,
+    NdCopyQuantBlockT<double>,
+    NdCopyDequantBlockT<float>,
+    NdCopyDequantBlockT<double>,
+    NdCopyShuffleBlockT<true>,
+    NdCopyShuffleBlockT<false>};
@@ -0,0 +1,307 @@
+//
+//  NDCopyStream.hpp
+//  src
+//
+
+#ifndef NDCOPYSTREAM_HPP
+#define NDCOPYSTREAM_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyBuffer.hpp"
+
+// NdCopyFileSource
+// a raw global array stored in a file: no header, elements at offset
+// onwards. shape follows the same convention as the dims passed to NdCopy()
+// together with the output dims.
+struct NdCopyFileSource {
+  int fd = -1;
+  off_t offset = 0;
+  Dims shape;
+  bool isRowMajor = true;
+  bool isLittleEndian = true;
+};
+
+// NdCopyStreamConfig
+// stagingBytes: size of each of the two staging buffers, i.e. the memory
+//   used besides the output is 2 * stagingBytes whatever the file size.
+// seekCostBytes: what one extra read costs, in bytes that could have been
+//   read sequentially instead. the planner reads through gaps smaller than
+//   this rather than splitting a range.
+struct NdCopyStreamConfig {
+  size_t stagingBytes = size_t(8) << 20;
+  size_t seekCostBytes = size_t(256) << 10;
+};
+
+template <class T>
+int NdCopyFromFile(const NdCopyFileSource &src, char *out,
+                   const Dims &outStart, const Dims &outCount,
+                   const bool outIsRowMajor, const bool outIsLittleEndian,
+                   const NdCopyStreamConfig &config = NdCopyStreamConfig());
+
+//***************Start of NdCopyFromFile() and its helpers ***************
+// NdCopyFromFile() copies the part of a file backed global array that
+// overlaps the output box, without mapping or reading the whole file:
+// 1. the overlap is planned into large sequential read ranges, each one a
+//    slab of the file along one dimension that fits in a staging buffer.
+//    the slab dimension is picked to minimize bytes read + reads * seek cost,
+//    so narrow selections do not read whole rows and wide ones do not turn
+//    into many small reads,
+// 2. a reader thread pread()s the next range into one staging buffer while
+//    the current one is copied out with NdCopy() (double buffering),
+// 3. memory stays bounded by 2 * stagingBytes.
+// returns 0 on success, 1 if there is no overlap, -1 on a read error or on
+// invalid arguments.
+
+// NdCopyStreamRange
+// one planned read: the bytes [fileOffset, fileOffset + readBytes) land at
+// stagingOffset in the staging buffer, which then holds the box
+// boxStart/boxCount (in file memory order) of the global array
+struct NdCopyStreamRange {
+  off_t fileOffset;
+  size_t readBytes;
+  size_t stagingOffset;
+  Dims boxStart;
+  Dims boxCount;
+};
+
+// NdCopyStreamPlan: helper class
+// splits the overlap into slabs along dimension m_SlabDim. ranges are
+// generated one at a time, so the plan takes O(dims) memory however many
+// ranges there are.
+class NdCopyStreamPlan {
+public:
+  // shape, ovlpStart, ovlpCount in file memory order, slowest first
+  NdCopyStreamPlan(const Dims &shape, const Dims &ovlpStart,
+                   const Dims &ovlpCount, size_t elmSize, off_t offset,
+                   const NdCopyStreamConfig &config)
+      : m_Shape(shape), m_OvlpStart(ovlpStart), m_OvlpCount(ovlpCount),
+        m_Offset(offset), m_Stride(shape.size()), m_Pos(shape.size(), 0) {
+    const size_t numDims = shape.size();
+    m_Stride[numDims - 1] = elmSize;
+    for (size_t k = numDims - 1; k-- > 0;)
+      m_Stride[k] = m_Stride[k + 1] * shape[k + 1];
+    const size_t staging = std::max(config.stagingBytes, elmSize);
+    // cost of slabbing along each dimension whose single index fits
+    double bestCost = 0;
+    for (size_t d = 0; d < numDims; d++) {
+      if (m_Stride[d] > staging)
+        continue;
+      const size_t slabLen = std::min(ovlpCount[d], staging / m_Stride[d]);
+      double outer = 1;
+      for (size_t k = 0; k < d; k++)
+        outer *= static_cast<double>(ovlpCount[k]);
+      const double numReads =
+          outer * static_cast<double>((ovlpCount[d] + slabLen - 1) / slabLen);
+      const double bytes =
+          outer * static_cast<double>((ovlpCount[d] - 1) * m_Stride[d] +
+                                      InnerSpan(d));
+      const double cost =
+          bytes + numReads * static_cast<double>(config.seekCostBytes);
+      if (d == 0 || m_Stride[d - 1] > staging || cost < bestCost) {
+        bestCost = cost;
+        m_SlabDim = d;
+        m_SlabLen = slabLen;
+      }
+    }
+    for (size_t k = 0; k < numDims; k++)
+      m_Pos[k] = ovlpStart[k];
+  }
+
+  // bytes of staging buffer one range needs
+  size_t GetStagingBytes() const { return m_SlabLen * m_Stride[m_SlabDim]; }
+
+  // the next range, false when the plan is exhausted
+  bool Next(NdCopyStreamRange &range) {
+    if (m_Done)
+      return false;
+    const size_t numDims = m_Shape.size();
+    const size_t d = m_SlabDim;
+    const size_t len =
+        std::min(m_SlabLen, m_OvlpStart[d] + m_OvlpCount[d] - m_Pos[d]);
+    size_t boxBase = 0;
+    for (size_t k = 0; k <= d; k++)
+      boxBase += m_Pos[k] * m_Stride[k];
+    size_t lead = 0, innerEnd = 0;
+    for (size_t k = d + 1; k < numDims; k++) {
+      lead += m_OvlpStart[k] * m_Stride[k];
+      innerEnd += (m_OvlpStart[k] + m_OvlpCount[k] - 1) * m_Stride[k];
+    }
+    innerEnd += m_Stride[numDims - 1];
+    range.stagingOffset = lead;
+    range.fileOffset = m_Offset + static_cast<off_t>(boxBase + lead);
+    range.readBytes = (len - 1) * m_Stride[d] + innerEnd - lead;
+    range.boxStart.assign(numDims, 0);
+    range.boxCount.assign(m_Shape.begin(), m_Shape.end());
+    for (size_t k = 0; k < d; k++) {
+      range.boxStart[k] = m_Pos[k];
+      range.boxCount[k] = 1;
+    }
+    range.boxStart[d] = m_Pos[d];
+    range.boxCount[d] = len;
+    // advance: along the slab dimension first, then the outer dimensions
+    m_Pos[d] += len;
+    size_t k = d;
+    while (m_Pos[k] == m_OvlpStart[k] + m_OvlpCount[k]) {
+      if (k == 0) {
+        m_Done = true;
+        break;
+      }
+      m_Pos[k] = m_OvlpStart[k];
+      m_Pos[--k]++;
+    }
+    return true;
+  }
+
+private:
+  // InnerSpan(): bytes from the first to the last overlap element under one
+  // index of dimension d
+  size_t InnerSpan(size_t d) const {
+    size_t span = m_Stride[m_Shape.size() - 1];
+    for (size_t k = d + 1; k < m_Shape.size(); k++)
+      span += (m_OvlpCount[k] - 1) * m_Stride[k];
+    return span;
+  }
+
+  const Dims m_Shape;
+  const Dims m_OvlpStart;
+  const Dims m_OvlpCount;
+  const off_t m_Offset;
+  Dims m_Stride;
+  Dims m_Pos;
+  size_t m_SlabDim = 0;
+  size_t m_SlabLen = 1;
+  bool m_Done = false;
+};
+
+// NdCopyPReadAll(): helper function
+// pread() until all bytes are in, retrying short reads and EINTR. false on
+// error or end of file.
+static inline bool NdCopyPReadAll(int fd, char *buf, size_t bytes,
+                                  off_t offset) {
+  while (bytes > 0) {
+    const ssize_t n = pread(fd, buf, bytes, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    buf += n;
+    bytes -= static_cast<size_t>(n);
+    offset += n;
+  }
+  return true;
+}
+
+template <class T>
+int NdCopyFromFile(const NdCopyFileSource &src, char *out,
+                   const Dims &outStart, const Dims &outCount,
+                   const bool outIsRowMajor, const bool outIsLittleEndian,
+                   const NdCopyStreamConfig &config) {
+  const size_t numDims = src.shape.size();
+  if (src.fd < 0 || numDims == 0 || outStart.size() != numDims ||
+      outCount.size() != numDims)
+    return -1;
+  // dims the way NdCopy() takes them: in memory order for col-major ==>
+  // col-major, in logical order otherwise. the plan works in the file's
+  // memory order.
+  const bool revDims = !src.isRowMajor && outIsRowMajor;
+  Dims shape(src.shape), start(outStart), count(outCount);
+  if (revDims) {
+    std::reverse(shape.begin(), shape.end());
+    std::reverse(start.begin(), start.end());
+    std::reverse(count.begin(), count.end());
+  }
+  Dims ovlpStart(numDims), ovlpCount(numDims);
+  for (size_t k = 0; k < numDims; k++) {
+    const size_t end = std::min(shape[k], start[k] + count[k]);
+    if (start[k] >= end)
+      return 1; // no overlap found
+    ovlpStart[k] = start[k];
+    ovlpCount[k] = end - start[k];
+  }
+
+  NdCopyStreamPlan plan(shape, ovlpStart, ovlpCount, sizeof(T), src.offset,
+                        config);
+  // double buffering: the reader fills one slot while the other is copied
+  struct Slot {
+    HugeBuffer buffer;
+    NdCopyStreamRange range;
+    bool full = false;
+  };
+  Slot slots[2];
+  for (Slot &slot : slots)
+    slot.buffer.resize(plan.GetStagingBytes());
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool readerDone = false, readError = false, stop = false;
+
+  std::thread reader([&]() {
+    for (size_t k = 0;; k++) {
+      Slot &slot = slots[k % 2];
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return !slot.full || stop; });
+        if (stop)
+          break;
+      }
+      NdCopyStreamRange range;
+      if (!plan.Next(range))
+        break;
+      const bool ok =
+          NdCopyPReadAll(src.fd, slot.buffer.data() + range.stagingOffset,
+                         range.readBytes, range.fileOffset);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!ok) {
+        readError = true;
+        break;
+      }
+      slot.range = std::move(range);
+      slot.full = true;
+      cond.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    readerDone = true;
+    cond.notify_all();
+  });
+
+  for (size_t k = 0;; k++) {
+    Slot &slot = slots[k % 2];
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&]() { return slot.full || readerDone; });
+      if (!slot.full)
+        break;
+    }
+    NdCopyStreamRange &range = slot.range;
+    if (revDims) {
+      std::reverse(range.boxStart.begin(), range.boxStart.end());
+      std::reverse(range.boxCount.begin(), range.boxCount.end());
+    }
+    NdCopy<T>(slot.buffer.data(), range.boxStart, range.boxCount,
+              src.isRowMajor, src.isLittleEndian, out, outStart, outCount,
+              outIsRowMajor, outIsLittleEndian);
+    std::lock_guard<std::mutex> lock(mutex);
+    slot.full = false;
+    cond.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+    cond.notify_all();
+  }
+  reader.join();
+  return readError ? -1 : 0;
+}
+//*************** End of NdCopyFromFile() and its helpers ***************
+
+#endif
@@ -0,0 +1,378 @@
+//
+//  NDCopyTiled.hpp
+//  src
+//
+
+#ifndef NDCOPYTILED_HPP
+#define NDCOPYTILED_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyLayout.hpp"
+
+// NdCopyTiledLayout
+// how the dense buffer holding a box is laid out, for NdCopyTiled():
+// Dense: the dimensions one after the other in axisOrder (see
+//   NdCopyPermute(), empty for row major),
+// Bricks: the box cut into bricks of brick[d] elements per dimension, stored
+//   one after the other in row major order of the bricks, every brick row
+//   major and complete (the bricks at the upper edges are padded),
+// Morton: Z-order, the bits of the coordinates interleaved from the lowest
+//   up with the last (fastest) dimension lowest. a dimension of count c
+//   takes ceil(log2(c)) bits and drops out of the interleave above them, so
+//   each dimension is padded to a power of two separately.
+// NdCopyTiledBytes() gives the buffer size.
+struct NdCopyTiledLayout {
+  enum Kind { Dense, Bricks, Morton };
+  Kind kind = Dense;
+  Dims axisOrder;
+  Dims brick;
+};
+
+inline NdCopyTiledLayout NdCopyDenseLayout(const Dims &axisOrder = Dims()) {
+  NdCopyTiledLayout layout;
+  layout.axisOrder = axisOrder;
+  return layout;
+}
+
+inline NdCopyTiledLayout NdCopyBrickLayout(const Dims &brick) {
+  NdCopyTiledLayout layout;
+  layout.kind = NdCopyTiledLayout::Bricks;
+  layout.brick = brick;
+  return layout;
+}
+
+inline NdCopyTiledLayout NdCopyMortonLayout() {
+  NdCopyTiledLayout layout;
+  layout.kind = NdCopyTiledLayout::Morton;
+  return layout;
+}
+
+template <class T>
+int NdCopyTiled(const char *in, const Dims &inStart, const Dims &inCount,
+                const NdCopyTiledLayout &inLayout, const bool inIsLittleEndian,
+                char *out, const Dims &outStart, const Dims &outCount,
+                const NdCopyTiledLayout &outLayout,
+                const bool outIsLittleEndian);
+
+//***************Start of NdCopyTiled() and its helpers ***************
+// All three layouts address an element as a sum of one term per dimension:
+// stride times coordinate for Dense, brick number times brick size plus the
+// place inside the brick for Bricks, and for Morton the bits of the
+// coordinate spread out to its positions of the interleave (the
+// coordinates' bits never share a position, so their sum is the Z-order
+// index). NdCopyTiled() tabulates the term of every coordinate of the
+// overlap once per side, after which any element's offset is a few table
+// lookups, with no bit interleaving in the loops.
+// the overlap is walked tile by tile, tiles being the bricks of a bricked
+// side or, for Morton, aligned power of two cubes of about 4096 elements,
+// which are contiguous in the Morton buffer. every tile is cache resident
+// while it is moved, and along the fastest dimension the runs that are
+// contiguous on both sides (a brick row against a dense row) are moved as
+// blocks.
+
+// NdCopyMortonBits(): helper function
+// bits a coordinate below count takes
+static inline size_t NdCopyMortonBits(size_t count) {
+  size_t bits = 0;
+  while ((size_t(1) << bits) < count)
+    bits++;
+  return bits;
+}
+
+// NdCopyTiledValid(): helper function
+static bool NdCopyTiledValid(const NdCopyTiledLayout &layout,
+                             const Dims &count) {
+  const size_t numDims = count.size();
+  switch (layout.kind) {
+  case NdCopyTiledLayout::Dense:
+    return layout.axisOrder.empty() ||
+           NdCopyIsAxisOrder(layout.axisOrder, numDims);
+  case NdCopyTiledLayout::Bricks:
+    if (layout.brick.size() != numDims)
+      return false;
+    for (size_t b : layout.brick)
+      if (b == 0)
+        return false;
+    return true;
+  default: {
+    size_t bits = 0;
+    for (size_t c : count)
+      bits += NdCopyMortonBits(c);
+    return bits < 8 * sizeof(size_t);
+  }
+  }
+}
+
+// NdCopyTiledTerms(): helper function
+// term[d][k]: byte offset term of coordinate first[d] + k of dimension d in
+// a buffer holding the box start/count laid out in layout, k < len[d]
+static void NdCopyTiledTerms(std::vector<Dims> &term,
+                             const NdCopyTiledLayout &layout,
+                             const Dims &start, const Dims &count,
+                             const Dims &first, const Dims &len,
+                             size_t elmSize) {
+  const size_t numDims = count.size();
+  term.assign(numDims, Dims());
+  if (layout.kind == NdCopyTiledLayout::Dense) {
+    Strides stride;
+    NdCopyGetLayoutStrides(stride,
+                           count, layout.axisOrder.empty()
+                                      ? NdCopyRowMajorOrder(numDims)
+                                      : layout.axisOrder,
+                           elmSize);
+    for (size_t d = 0; d < numDims; d++)
+      for (size_t k = 0; k < len[d]; k++)
+        term[d].push_back((first[d] + k - start[d]) * stride[d]);
+  } else if (layout.kind == NdCopyTiledLayout::Bricks) {
+    // row major strides of the bricks and inside a brick, in elements
+    const Dims &b = layout.brick;
+    Dims gridStride(numDims), brickStride(numDims);
+    size_t brickVolume = 1, numBricks = 1;
+    for (size_t d = numDims; d-- > 0;) {
+      brickStride[d] = brickVolume;
+      gridStride[d] = numBricks;
+      brickVolume *= b[d];
+      numBricks *= (count[d] + b[d] - 1) / b[d];
+    }
+    for (size_t d = 0; d < numDims; d++)
+      for (size_t k = 0; k < len[d]; k++) {
+        const size_t c = first[d] + k - start[d];
+        term[d].push_back(((c / b[d]) * gridStride[d] * brickVolume +
+                           (c % b[d]) * brickStride[d]) *
+                          elmSize);
+      }
+  } else {
+    // bit positions of every dimension: level by level from the lowest,
+    // the last dimension first within a level
+    std::vector<Dims> pos(numDims);
+    size_t next = 0;
+    for (size_t level = 0;; level++) {
+      bool any = false;
+      for (size_t d = numDims; d-- > 0;)
+        if (level < NdCopyMortonBits(count[d])) {
+          pos[d].push_back(next++);
+          any = true;
+        }
+      if (!any)
+        break;
+    }
+    for (size_t d = 0; d < numDims; d++)
+      for (size_t k = 0; k < len[d]; k++) {
+        const size_t c = first[d] + k - start[d];
+        size_t index = 0;
+        for (size_t bit = 0; bit < pos[d].size(); bit++)
+          index |= ((c >> bit) & 1) << pos[d][bit];
+        term[d].push_back(index * elmSize);
+      }
+  }
+}
+
+// NdCopyTiledRun(): helper function
+// moves n elements that are contiguous on both sides
+template <size_t ElmBytes>
+static inline void NdCopyTiledRun(char *out, const char *in, size_t n,
+                                  size_t elmSizeRT,
+                                  const NdCopyElmDesc *revEndian) {
+  const size_t elmSize = ElmBytes ? ElmBytes : elmSizeRT;
+  if (revEndian)
+    NdCopyRevEndianElms(out, in, n, elmSize, *revEndian);
+  else if (n == 1)
+    NdCopyCopyElm(out, in, elmSize);
+  else
+    std::memcpy(out, in, n * elmSize);
+}
+
+// NdCopyTiledExecT(): helper function
+// walks the overlap (len[d] coordinates per dimension) tile by tile. tile[d]
+// is the tile edge and phase[d] the coordinate index of the first tile
+// boundary at or below the overlap, as a negative offset. runEnd[k] is the
+// end of the run of the fastest dimension that is contiguous on both sides
+// from k on.
+template <size_t ElmBytes>
+static void NdCopyTiledExecT(const char *in, char *out,
+                             const std::vector<Dims> &inTerm,
+                             const std::vector<Dims> &outTerm, const Dims &len,
+                             const Dims &tile, const Dims &phase,
+                             const Dims &runEnd, size_t elmSize,
+                             const NdCopyElmDesc *revEndian) {
+  const size_t numDims = len.size();
+  const size_t last = numDims - 1;
+  // tile [lo, hi) per dimension, odometer over the tiles
+  Dims lo(numDims), hi(numDims);
+  for (size_t d = 0; d < numDims; d++) {
+    lo[d] = 0;
+    hi[d] = std::min(len[d], tile[d] - phase[d]);
+  }
+  Dims pos(numDims);
+  while (true) {
+    // the tile: odometer over all dimensions but the fastest
+    for (size_t d = 0; d < last; d++)
+      pos[d] = lo[d];
+    while (true) {
+      const char *inRow = in;
+      char *outRow = out;
+      for (size_t d = 0; d < last; d++) {
+        inRow += inTerm[d][pos[d]];
+        outRow += outTerm[d][pos[d]];
+      }
+      const Dims &inFast = inTerm[last];
+      const Dims &outFast = outTerm[last];
+      for (size_t k = lo[last]; k < hi[last];) {
+        const size_t end = std::min(runEnd[k], hi[last]);
+        NdCopyTiledRun<ElmBytes>(outRow + outFast[k], inRow + inFast[k],
+                                 end - k, elmSize, revEndian);
+        k = end;
+      }
+      size_t d = last;
+      while (d > 0 && ++pos[d - 1] == hi[d - 1]) {
+        pos[d - 1] = lo[d - 1];
+        d--;
+      }
+      if (d == 0)
+        break;
+    }
+    // next tile
+    size_t d = numDims;
+    while (d > 0) {
+      d--;
+      lo[d] = hi[d];
+      hi[d] = std::min(len[d], hi[d] + tile[d]);
+      if (lo[d] < len[d])
+        break;
+      lo[d] = 0;
+      hi[d] = std::min(len[d], tile[d] - phase[d]);
+      if (d == 0)
+        return;
+    }
+  }
+}
+
+// NdCopyTiledExec(): helper function
+// NdCopyTiledExecT() for the element size
+static void NdCopyTiledExec(const char *in, char *out,
+                            const std::vector<Dims> &inTerm,
+                            const std::vector<Dims> &outTerm, const Dims &len,
+                            const Dims &tile, const Dims &phase,
+                            const Dims &runEnd, size_t elmSize,
+                            const NdCopyElmDesc *revEndian) {
+  switch (elmSize) {
+  case 1:
+    NdCopyTiledExecT<1>(in, out, inTerm, outTerm, len, tile, phase, runEnd,
+                        elmSize, revEndian);
+    break;
+  case 2:
+    NdCopyTiledExecT<2>(in, out, inTerm, outTerm, len, tile, phase, runEnd,
+                        elmSize, revEndian);
+    break;
+  case 4:
+    NdCopyTiledExecT<4>(in, out, inTerm, outTerm, len, tile, phase, runEnd,
+                        elmSize, revEndian);
+    break;
+  case 8:
+    NdCopyTiledExecT<8>(in, out, inTerm, outTerm, len, tile, phase, runEnd,
+                        elmSize, revEndian);
+    break;
+  default:
+    NdCopyTiledExecT<0>(in, out, inTerm, outTerm, len, tile, phase, runEnd,
+                        elmSize, revEndian);
+  }
+}
+
+// NdCopyTiledBytes()
+// size of the buffer holding a box of count elements of elmSize bytes in
+// layout
+inline size_t NdCopyTiledBytes(const Dims &count,
+                               const NdCopyTiledLayout &layout,
+                               size_t elmSize) {
+  size_t elms = 1;
+  for (size_t d = 0; d < count.size(); d++)
+    if (layout.kind == NdCopyTiledLayout::Dense)
+      elms *= count[d];
+    else if (layout.kind == NdCopyTiledLayout::Bricks)
+      elms *= (count[d] + layout.brick[d] - 1) / layout.brick[d] *
+              layout.brick[d];
+    else
+      elms *= size_t(1) << NdCopyMortonBits(count[d]);
+  return elms * elmSize;
+}
+
+// NdCopyTiled()
+// Copies n-dimensional data between two buffers of any of the layouts of
+// NdCopyTiledLayout, either can be of any endianess. in holds the box
+// inStart/inCount, out the box outStart/outCount, both in logical
+// coordinates. Return 1 if no overlap is found, -1 for an invalid layout.
+// Dense ==> Dense is NdCopyPermute().
+// Optimizations: one pass over the overlap, tile by tile, with every
+// element's offsets from per dimension tables (see above); runs that are
+// contiguous on both sides are moved as blocks.
+template <class T>
+int NdCopyTiled(const char *in, const Dims &inStart, const Dims &inCount,
+                const NdCopyTiledLayout &inLayout, const bool inIsLittleEndian,
+                char *out, const Dims &outStart, const Dims &outCount,
+                const NdCopyTiledLayout &outLayout,
+                const bool outIsLittleEndian) {
+  const size_t numDims = inStart.size();
+  if (numDims == 0 || inCount.size() != numDims ||
+      outStart.size() != numDims || outCount.size() != numDims ||
+      !NdCopyTiledValid(inLayout, inCount) ||
+      !NdCopyTiledValid(outLayout, outCount))
+    return -1;
+  if (inLayout.kind == NdCopyTiledLayout::Dense &&
+      outLayout.kind == NdCopyTiledLayout::Dense)
+    return NdCopyPermute<T>(in, inStart, inCount, inLayout.axisOrder,
+                            inIsLittleEndian, out, outStart, outCount,
+                            outLayout.axisOrder, outIsLittleEndian);
+  Dims first(numDims), len(numDims);
+  for (size_t d = 0; d < numDims; d++) {
+    first[d] = std::max(inStart[d], outStart[d]);
+    const size_t end =
+        std::min(inStart[d] + inCount[d], outStart[d] + outCount[d]);
+    if (end <= first[d])
+      return 1; // no overlap found
+    len[d] = end - first[d];
+  }
+  std::vector<Dims> inTerm, outTerm;
+  NdCopyTiledTerms(inTerm, inLayout, inStart, inCount, first, len,
+                   sizeof(T));
+  NdCopyTiledTerms(outTerm, outLayout, outStart, outCount, first, len,
+                   sizeof(T));
+
+  // tiles: the output's bricks, else the input's, else Morton cubes,
+  // anchored at the start of the buffer they come from
+  const bool outLeads = outLayout.kind != NdCopyTiledLayout::Dense &&
+                        !(outLayout.kind == NdCopyTiledLayout::Morton &&
+                          inLayout.kind == NdCopyTiledLayout::Bricks);
+  const NdCopyTiledLayout &lead = outLeads ? outLayout : inLayout;
+  const Dims &anchor = outLeads ? outStart : inStart;
+  Dims tile(numDims), phase(numDims);
+  const size_t cubeBits = std::max<size_t>(1, 12 / numDims);
+  for (size_t d = 0; d < numDims; d++) {
+    tile[d] = lead.kind == NdCopyTiledLayout::Bricks ? lead.brick[d]
+                                                     : size_t(1) << cubeBits;
+    phase[d] = (first[d] - anchor[d]) % tile[d];
+  }
+
+  // runs of the fastest dimension that are contiguous on both sides
+  const size_t last = numDims - 1;
+  Dims runEnd(len[last]);
+  runEnd[len[last] - 1] = len[last];
+  for (size_t k = len[last] - 1; k-- > 0;)
+    runEnd[k] = inTerm[last][k + 1] - inTerm[last][k] == sizeof(T) &&
+                        outTerm[last][k + 1] - outTerm[last][k] == sizeof(T)
+                    ? runEnd[k + 1]
+                    : k + 1;
+
+  const NdCopyElmDesc elmDesc = NdCopyElmTraits<T>::Desc();
+  NdCopyTiledExec(in, out, inTerm, outTerm, len, tile, phase, runEnd,
+                  sizeof(T),
+                  inIsLittleEndian != outIsLittleEndian ? &elmDesc : nullptr);
+  return 0;
+}
+//*************** End of NdCopyTiled() and its helpers ***************
+
+#endif
@@ -0,0 +1,211 @@
+//
+//  NDCopyTuning.hpp
+//  src
+//
+
+#ifndef NDCOPYTUNING_HPP
+#define NDCOPYTUNING_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// defaults of the machine dependent choices below, used until a profile is
+// loaded or NdCopyAutotune() (NDCopyAutotune.hpp) has run.
+// block sizes in bytes for which NdCopyBlock() uses NdCopyAlignedBlock().
+// smaller blocks are dominated by call overhead, larger ones are handled
+// well by the library memcpy (which switches to its own large copy tricks).
+const size_t NdCopyAlignedBlockMin = 256;
+const size_t NdCopyAlignedBlockMax = 4096;
+// messages from this size on are packed by several threads when the caller
+// leaves the number of threads to NdCopyPack()/NdCopyUnpack()
+const size_t NdCopyPackParallelMinBytes = size_t(8) << 20;
+const size_t NdCopyPackMaxThreads = 8;
+// tile of the transposition kernel of NdCopyPermute()/NdCopyStrided(): bytes
+// of a tile row (0 moves transpositions element by element, untiled) and
+// bytes a tile covers at least when the input's fast dimension is short
+const size_t NdCopyStridedTileBytes = 64;
+const size_t NdCopyStridedTileArea = 4096;
+
+// NdCopyTuning
+// the choices whose best value depends on the machine rather than on the
+// copy: which kernel NdCopy() runs when safeMode is off, the block sizes
+// that get the aligned block copy, when and how wide NdCopyPack() goes
+// parallel, and the tile of the strided transposition kernel.
+struct NdCopyTuning {
+  // iterative instead of recursive kernels for row-major ==> row-major
+  // (iterSeqPadding) and for the modes involving col-major (iterDynamic)
+  bool iterSeqPadding = false;
+  bool iterDynamic = false;
+  size_t alignedBlockMin = NdCopyAlignedBlockMin;
+  size_t alignedBlockMax = NdCopyAlignedBlockMax;
+  size_t packParallelMinBytes = NdCopyPackParallelMinBytes;
+  size_t packMaxThreads = NdCopyPackMaxThreads;
+  size_t stridedTileBytes = NdCopyStridedTileBytes;
+  size_t stridedTileArea = NdCopyStridedTileArea;
+};
+
+// NdCopyTuningStorage: helper class
+// the process wide tuning. a class template, so the header can define it;
+// constant initialized, so reading it costs no guard.
+template <class Dummy>
+struct NdCopyTuningStorage {
+  static NdCopyTuning tuning;
+  static size_t generation;
+};
+template <class Dummy>
+NdCopyTuning NdCopyTuningStorage<Dummy>::tuning;
+template <class Dummy>
+size_t NdCopyTuningStorage<Dummy>::generation = 0;
+
+// NdCopyGetTuning()
+inline const NdCopyTuning &NdCopyGetTuning() {
+  return NdCopyTuningStorage<void>::tuning;
+}
+
+// NdCopySetTuning()
+// to be called before copies start, typically once at startup. cached
+// NdCopy() plans made under the previous tuning are not reused.
+inline void NdCopySetTuning(const NdCopyTuning &tuning) {
+  NdCopyTuningStorage<void>::tuning = tuning;
+  NdCopyTuningStorage<void>::generation++;
+}
+
+// NdCopyTuningGeneration(): helper function
+// changes with every NdCopySetTuning(), part of the NdCopy() plan key
+inline size_t NdCopyTuningGeneration() {
+  return NdCopyTuningStorage<void>::generation;
+}
+
+//***************Start of the tuning profile and its helpers ***************
+// A profile is a small text file, one "key value" per line:
+//   ndcopy-tuning 1
+//   cpu Intel(R) Xeon(R) Gold 6148 CPU @ 2.40GHz
+//   iterSeqPadding 0
+//   ...
+// a profile only applies to the cpu it was tuned on, so nodes of different
+// kinds sharing a file system can keep one profile each, or re-tune when
+// they find the other kind's.
+
+// NdCopyCpuName(): helper function
+// the cpu brand string, "unknown" where there is none
+inline std::string NdCopyCpuName() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int regs[12];
+  if (__get_cpuid(0x80000000u, &regs[0], &regs[1], &regs[2], &regs[3]) &&
+      regs[0] >= 0x80000004u) {
+    for (unsigned int i = 0; i < 3; i++)
+      __get_cpuid(0x80000002u + i, &regs[4 * i], &regs[4 * i + 1],
+                  &regs[4 * i + 2], &regs[4 * i + 3]);
+    std::string name(reinterpret_cast<const char *>(regs), sizeof(regs));
+    name = name.substr(0, name.find('\0'));
+    const size_t first = name.find_first_not_of(' ');
+    if (first != std::string::npos)
+      return name.substr(first, name.find_last_not_of(' ') - first + 1);
+  }
+#endif
+  return "unknown";
+}
+
+// NdCopySaveTuning()
+// writes tuning as the profile of this machine. returns 0 on success, -1 if
+// the file cannot be written.
+inline int NdCopySaveTuning(const char *path, const NdCopyTuning &tuning) {
+  FILE *file = std::fopen(path, "w");
+  if (file == nullptr)
+    return -1;
+  std::fprintf(file, "ndcopy-tuning 1\n");
+  std::fprintf(file, "cpu %s\n", NdCopyCpuName().c_str());
+  std::fprintf(file, "iterSeqPadding %d\n", tuning.iterSeqPadding ? 1 : 0);
+  std::fprintf(file, "iterDynamic %d\n", tuning.iterDynamic ? 1 : 0);
+  std::fprintf(file, "alignedBlockMin %zu\n", tuning.alignedBlockMin);
+  std::fprintf(file, "alignedBlockMax %zu\n", tuning.alignedBlockMax);
+  std::fprintf(file, "packParallelMinBytes %zu\n",
+               tuning.packParallelMinBytes);
+  std::fprintf(file, "packMaxThreads %zu\n", tuning.packMaxThreads);
+  std::fprintf(file, "stridedTileBytes %zu\n", tuning.stridedTileBytes);
+  std::fprintf(file, "stridedTileArea %zu\n", tuning.stridedTileArea);
+  return std::fclose(file) == 0 ? 0 : -1;
+}
+
+// NdCopyReadTuning()
+// reads a profile into tuning (keys it does not mention keep their value).
+// returns 0 on success, 1 if there is no profile or it was tuned on another
+// cpu, -1 if it is malformed.
+inline int NdCopyReadTuning(const char *path, NdCopyTuning &tuning) {
+  FILE *file = std::fopen(path, "r");
+  if (file == nullptr)
+    return 1;
+  NdCopyTuning res = tuning;
+  int status = -1;
+  char line[256];
+  for (size_t n = 0; std::fgets(line, sizeof(line), file); n++) {
+    line[std::strcspn(line, "\r\n")] = '\0';
+    char *value = std::strchr(line, ' ');
+    if (value == nullptr) {
+      status = -1;
+      break;
+    }
+    *value++ = '\0';
+    if (n == 0) {
+      if (std::strcmp(line, "ndcopy-tuning") != 0 ||
+          std::strcmp(value, "1") != 0)
+        break;
+      continue;
+    }
+    if (std::strcmp(line, "cpu") == 0) {
+      if (NdCopyCpuName() != value) {
+        status = 1;
+        break;
+      }
+      status = 0;
+      continue;
+    }
+    char *end;
+    const unsigned long long v = std::strtoull(value, &end, 10);
+    if (end == value || *end != '\0') {
+      status = -1;
+      break;
+    }
+    if (std::strcmp(line, "iterSeqPadding") == 0)
+      res.iterSeqPadding = v != 0;
+    else if (std::strcmp(line, "iterDynamic") == 0)
+      res.iterDynamic = v != 0;
+    else if (std::strcmp(line, "alignedBlockMin") == 0)
+      res.alignedBlockMin = static_cast<size_t>(v);
+    else if (std::strcmp(line, "alignedBlockMax") == 0)
+      res.alignedBlockMax = static_cast<size_t>(v);
+    else if (std::strcmp(line, "packParallelMinBytes") == 0)
+      res.packParallelMinBytes = static_cast<size_t>(v);
+    else if (std::strcmp(line, "packMaxThreads") == 0)
+      res.packMaxThreads = static_cast<size_t>(v);
+    else if (std::strcmp(line, "stridedTileBytes") == 0)
+      res.stridedTileBytes = static_cast<size_t>(v);
+    else if (std::strcmp(line, "stridedTileArea") == 0)
+      res.stridedTileArea = static_cast<size_t>(v);
+    // unknown keys are skipped, so older readers take newer profiles
+  }
+  std::fclose(file);
+  if (status == 0)
+    tuning = res;
+  return status;
+}
+
+// NdCopyLoadTuning()
+// NdCopyReadTuning() into the process wide tuning, same return values
+inline int NdCopyLoadTuning(const char *path) {
+  NdCopyTuning tuning = NdCopyGetTuning();
+  const int status = NdCopyReadTuning(path, tuning);
+  if (status == 0)
+    NdCopySetTuning(tuning);
+  return status;
+}
+//*************** End of the tuning profile and its helpers ***************
+
+#endif
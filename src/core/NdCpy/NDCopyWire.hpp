@@ -0,0 +1,239 @@
+//
+//  NDCopyWire.hpp
+//  src
+//
+
+#ifndef NDCOPYWIRE_HPP
+#define NDCOPYWIRE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "core/NdCpy/NDCopy.hpp"
+
+const size_t NdCopyWireMaxDims = 8;
+
+// NdCopyWireHeader
+// decoded header of a sub-array message. fixed size, so decoding does not
+// allocate. shape is the global shape, start/count the box carried in the
+// payload; all dims logical, whatever the major.
+struct NdCopyWireHeader {
+  size_t numDims;
+  bool isRowMajor;
+  bool isLittleEndian;
+  size_t elmSize;
+  size_t shape[NdCopyWireMaxDims];
+  size_t start[NdCopyWireMaxDims];
+  size_t count[NdCopyWireMaxDims];
+  size_t headerBytes;  // offset of the payload in the message
+  size_t payloadBytes; // elmSize * product of count
+};
+
+//***************Start of the sub-array wire format and its helpers *********
+// A message is a compact header followed by the payload:
+//   bytes 0-1  magic 'N' 'C'
+//   byte  2    version (1)
+//   byte  3    flags: bit 0 row major, bit 1 little endian
+//   byte  4    number of dims
+//   varints    element size, then shape, start, count of every dim
+//              (unsigned LEB128: 7 bits per byte, small values in one byte)
+//   padding    zeros up to the next multiple of 8
+//   payload    the box start/count, dense, in the sender's major/endianess
+// the payload starts 8 byte aligned relative to the message, so a receiver
+// with the same layout can use it in place (NdCopyWireView()).
+
+const unsigned char NdCopyWireMagic0 = 'N';
+const unsigned char NdCopyWireMagic1 = 'C';
+const unsigned char NdCopyWireVersion = 1;
+
+// NdCopyWirePutVarint(): helper function
+static inline char *NdCopyWirePutVarint(char *p, uint64_t v) {
+  while (v >= 0x80) {
+    *p++ = static_cast<char>((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  *p++ = static_cast<char>(v);
+  return p;
+}
+
+// NdCopyWireGetVarint(): helper function
+// null if the varint runs past end or does not fit 64 bits
+static inline const char *NdCopyWireGetVarint(const char *p, const char *end,
+                                              uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+    const unsigned char b = static_cast<unsigned char>(*p++);
+    v |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return p;
+  }
+  return nullptr;
+}
+
+// NdCopyWireMaxHeaderBytes()
+// upper bound of the header size, for sizing send buffers
+inline size_t NdCopyWireMaxHeaderBytes(size_t numDims) {
+  return (5 + 10 * (1 + 3 * numDims) + 7) / 8 * 8;
+}
+
+// NdCopyWireDecode()
+// parses and checks the header of a message of msgBytes bytes. returns 0 on
+// success, -1 if the message is malformed or truncated.
+inline int NdCopyWireDecode(const char *msg, size_t msgBytes,
+                            NdCopyWireHeader &header) {
+  const unsigned char *u = reinterpret_cast<const unsigned char *>(msg);
+  if (msgBytes < 5 || u[0] != NdCopyWireMagic0 || u[1] != NdCopyWireMagic1 ||
+      u[2] != NdCopyWireVersion || u[4] == 0 || u[4] > NdCopyWireMaxDims)
+    return -1;
+  header.isRowMajor = (u[3] & 1) != 0;
+  header.isLittleEndian = (u[3] & 2) != 0;
+  header.numDims = u[4];
+  const char *p = msg + 5;
+  const char *end = msg + msgBytes;
+  uint64_t v;
+  if (!(p = NdCopyWireGetVarint(p, end, v)) || v == 0)
+    return -1;
+  header.elmSize = v;
+  size_t *fields[3] = {header.shape, header.start, header.count};
+  for (size_t f = 0; f < 3; f++)
+    for (size_t i = 0; i < header.numDims; i++) {
+      if (!(p = NdCopyWireGetVarint(p, end, v)))
+        return -1;
+      fields[f][i] = v;
+    }
+  header.headerBytes = (static_cast<size_t>(p - msg) + 7) / 8 * 8;
+  header.payloadBytes = header.elmSize;
+  for (size_t i = 0; i < header.numDims; i++) {
+    if (header.count[i] == 0 || header.start[i] > header.shape[i] ||
+        header.count[i] > header.shape[i] - header.start[i] ||
+        header.payloadBytes > msgBytes / header.count[i])
+      return -1;
+    header.payloadBytes *= header.count[i];
+  }
+  if (header.headerBytes + header.payloadBytes > msgBytes)
+    return -1;
+  return 0;
+}
+
+// NdCopyWireMatches(): helper function
+// whether the payload is already laid out as the receiver's box
+template <class T>
+static bool NdCopyWireMatches(const NdCopyWireHeader &header,
+                              const Dims &start, const Dims &count,
+                              bool isRowMajor, bool isLittleEndian) {
+  if (header.elmSize != sizeof(T) || header.numDims != start.size() ||
+      header.isLittleEndian != isLittleEndian)
+    return false;
+  if (header.isRowMajor != isRowMajor && header.numDims > 1)
+    return false;
+  for (size_t i = 0; i < header.numDims; i++)
+    if (header.start[i] != start[i] || header.count[i] != count[i])
+      return false;
+  return true;
+}
+
+// NdCopyWirePack()
+// writes a message carrying the part of the input box within selStart/
+// selCount of a global array of the given shape. the overlap is NdCopy()ed
+// straight behind the header in the sender's major/endianess. dims are
+// logical. msgBytes receives the message size. returns 0 on success, 1 if
+// the selection does not overlap the input, -1 if msgCapacity is too small
+// or the arguments are invalid.
+template <class T>
+int NdCopyWirePack(char *msg, size_t msgCapacity, size_t &msgBytes,
+                   const char *in, const Dims &inStart, const Dims &inCount,
+                   const bool inIsRowMajor, const bool inIsLittleEndian,
+                   const Dims &shape, const Dims &selStart,
+                   const Dims &selCount) {
+  const size_t numDims = inStart.size();
+  if (numDims == 0 || numDims > NdCopyWireMaxDims || shape.size() != numDims)
+    return -1;
+  size_t ovlpStart[NdCopyWireMaxDims], ovlpCount[NdCopyWireMaxDims];
+  size_t payloadBytes = sizeof(T);
+  for (size_t i = 0; i < numDims; i++) {
+    ovlpStart[i] = std::max(inStart[i], selStart[i]);
+    const size_t end =
+        std::min(inStart[i] + inCount[i], selStart[i] + selCount[i]);
+    if (end <= ovlpStart[i])
+      return 1; // no overlap found
+    ovlpCount[i] = end - ovlpStart[i];
+    payloadBytes *= ovlpCount[i];
+  }
+  if (msgCapacity < NdCopyWireMaxHeaderBytes(numDims) + payloadBytes)
+    return -1;
+  unsigned char *u = reinterpret_cast<unsigned char *>(msg);
+  u[0] = NdCopyWireMagic0;
+  u[1] = NdCopyWireMagic1;
+  u[2] = NdCopyWireVersion;
+  u[3] = static_cast<unsigned char>((inIsRowMajor ? 1 : 0) |
+                                    (inIsLittleEndian ? 2 : 0));
+  u[4] = static_cast<unsigned char>(numDims);
+  char *p = NdCopyWirePutVarint(msg + 5, sizeof(T));
+  for (size_t i = 0; i < numDims; i++)
+    p = NdCopyWirePutVarint(p, shape[i]);
+  for (size_t i = 0; i < numDims; i++)
+    p = NdCopyWirePutVarint(p, ovlpStart[i]);
+  for (size_t i = 0; i < numDims; i++)
+    p = NdCopyWirePutVarint(p, ovlpCount[i]);
+  while ((p - msg) % 8 != 0)
+    *p++ = 0;
+  NdCopy<T>(in, NdCopyMemOrder(inStart, inIsRowMajor),
+            NdCopyMemOrder(inCount, inIsRowMajor), true, inIsLittleEndian, p,
+            NdCopyMemOrder(ovlpStart, numDims, inIsRowMajor),
+            NdCopyMemOrder(ovlpCount, numDims, inIsRowMajor), true,
+            inIsLittleEndian);
+  msgBytes = static_cast<size_t>(p - msg) + payloadBytes;
+  return 0;
+}
+
+// NdCopyWireView()
+// fast path: the payload itself when it is laid out exactly as the box
+// start/count the receiver wants (same box, major, endianess and element
+// size), so the message is consumed in place; null otherwise.
+template <class T>
+const char *NdCopyWireView(const char *msg, const NdCopyWireHeader &header,
+                           const Dims &start, const Dims &count,
+                           const bool isRowMajor, const bool isLittleEndian) {
+  if (!NdCopyWireMatches<T>(header, start, count, isRowMajor, isLittleEndian))
+    return nullptr;
+  return msg + header.headerBytes;
+}
+
+// NdCopyWireUnpack()
+// copies the payload of a message into the output box, converting major and
+// endianess as needed. a payload that already matches the output box is
+// copied as one block without planning. returns 0 on success, 1 if the
+// message does not overlap the output box, -1 if the message is malformed or
+// holds a different element type.
+template <class T>
+int NdCopyWireUnpack(const char *msg, size_t msgBytes, char *out,
+                     const Dims &outStart, const Dims &outCount,
+                     const bool outIsRowMajor, const bool outIsLittleEndian) {
+  NdCopyWireHeader header;
+  if (NdCopyWireDecode(msg, msgBytes, header) != 0 ||
+      header.elmSize != sizeof(T) || header.numDims != outStart.size())
+    return -1;
+  const char *payload = msg + header.headerBytes;
+  if (NdCopyWireMatches<T>(header, outStart, outCount, outIsRowMajor,
+                           outIsLittleEndian)) {
+    std::memcpy(out, payload, header.payloadBytes);
+    return 0;
+  }
+  const size_t n = header.numDims;
+  if (!header.isRowMajor && !outIsRowMajor)
+    return NdCopy<T>(payload, NdCopyMemOrder(header.start, n, false),
+                     NdCopyMemOrder(header.count, n, false), true,
+                     header.isLittleEndian, out,
+                     NdCopyMemOrder(outStart, false),
+                     NdCopyMemOrder(outCount, false), true,
+                     outIsLittleEndian);
+  return NdCopy<T>(payload, Dims(header.start, header.start + n),
+                   Dims(header.count, header.count + n), header.isRowMajor,
+                   header.isLittleEndian, out, outStart, outCount,
+                   outIsRowMajor, outIsLittleEndian);
+}
+//*************** End of the sub-array wire format and its helpers *********
+
+#endif
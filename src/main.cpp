@@ -3,9 +3,33 @@
 #include <numeric>
 #include <chrono>
 #include "core/NdCpy/NDCopy.hpp"
+#include "core/NdCpy/NDCopyLayout.hpp"
+#include "core/NdCpy/NDCopyBuffer.hpp"
+#include "core/NdCpy/NDCopyStream.hpp"
+#include "core/NdCpy/NDCopyShm.hpp"
+#include "core/NdCpy/NDCopyWire.hpp"
+#include "core/NdCpy/NDCopyPack.hpp"
+#include "core/NdCpy/NDCopyAutotune.hpp"
+#include "core/NdCpy/NDCopyPoints.hpp"
+#include "core/NdCpy/NDCopyLazy.hpp"
+#include "core/NdCpy/NDCopyDelta.hpp"
+#include "core/NdCpy/NDCopyQuant.hpp"
+#include "core/NdCpy/NDCopyShuffle.hpp"
+#include "core/NdCpy/NDCopyTiled.hpp"
+#include "core/NdCpy/NDCopyHalo.hpp"
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 #include "core/previous/NDCopy2.tcc"
 #include "core/previous/NDCopy2.h"
 #include "tests/test.h"
+#include "tests/perf_counters.h"
+#include "tests/roofline.h"
 
 
 void PrintDims(const Dims &dims, const std::string &name){
@@ -31,8 +55,8 @@ void PrintData(const Buffer &buffer, const Dims &count){
     std::cout << std::endl;
 }
 
-template<class T>
-void MakeData(Buffer &buffer, const Dims &count, bool zero){
+template<class T, class B>
+void MakeData(B &buffer, const Dims &count, bool zero){
     size_t size = std::accumulate(count.begin(), count.end(), 1, std::multiplies<size_t>());
     for(size_t i=0; i<size; ++i){
         if(zero){
@@ -294,6 +318,139 @@ void performance_test_max_cont_block_optimization(int iters){
     RunTest<int>(input_start, input_count, output_start, output_count, iters);
 }
 
+void performance_test_block_copy_alignment(int iters){
+    // medium sized blocks, copied at every relative alignment class of
+    // source and destination: memcpy against NdCopyAlignedBlock
+    std::cout<<"block copy performance test by alignment class."<<std::endl;
+    const NdCopyBlockFn wide = NdCopyWideBlock();
+    if(wide == nullptr){
+        std::cout<<"no 32/64 byte vectors, blocks are copied with memcpy"<<std::endl;
+        return;
+    }
+    std::cout<<"(nsec per block, offsets from a 64 byte boundary)"<<std::endl;
+    const size_t sizes[] = {256, 1024, 4096};
+    const size_t offsets[][2] = {{0,0}, {8,8}, {0,13}, {13,0}, {3,13}};
+    const char *classes[] = {"both aligned", "same misalignment",
+                             "src misaligned", "dst misaligned", "both misaligned"};
+    const size_t reps = 100000 * static_cast<size_t>(iters);
+    Buffer input_buffer(8192 + 64), output_buffer(8192 + 64);
+    char *in_base = input_buffer.data() + (64 - reinterpret_cast<uintptr_t>(input_buffer.data()) % 64);
+    char *out_base = output_buffer.data() + (64 - reinterpret_cast<uintptr_t>(output_buffer.data()) % 64);
+    for(size_t size : sizes){
+        for(size_t c=0; c<5; ++c){
+            const char *in = in_base + offsets[c][0];
+            char *out = out_base + offsets[c][1];
+            auto start = std::chrono::system_clock::now();
+            for(size_t i=0; i<reps; ++i){
+                std::memcpy(out, in, size);
+                asm volatile("" : : "r"(out) : "memory");
+            }
+            auto end = std::chrono::system_clock::now();
+            auto start2 = std::chrono::system_clock::now();
+            for(size_t i=0; i<reps; ++i){
+                wide(out, in, size);
+                asm volatile("" : : "r"(out) : "memory");
+            }
+            auto end2 = std::chrono::system_clock::now();
+            double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count() / double(reps);
+            double ns2 = std::chrono::duration_cast<std::chrono::nanoseconds>(end2-start2).count() / double(reps);
+            std::cout << size << " bytes, " << classes[c] << ": memcpy " << ns
+                      << ", NdCopyAlignedBlock " << ns2 << std::endl;
+        }
+    }
+}
+
+void performance_test_huge_buffer(int iters){
+    // allocating a large copy destination and filling it, over and over:
+    // Buffer zero-fills fresh pages on every resize, HugeBuffer skips the
+    // zero fill and hands the freed huge page backed block out again
+    std::cout<<"allocate and copy into a large destination, 3d data:"<<std::endl;
+    Dims input_start = {0,0,0};
+    Dims input_count = {72,264,264};
+    Dims output_start = {4,4,4};
+    Dims output_count = {64,256,256};
+    const size_t output_bytes = 64*256*256*sizeof(float);
+    Buffer input_buffer;
+    input_buffer.resize(72*264*264*sizeof(float));
+    MakeData<float>(input_buffer, input_count, false);
+    const int rounds = 8 * iters;
+
+    Buffer last;
+    auto start = std::chrono::system_clock::now();
+    for(int i=0; i<rounds; ++i){
+        Buffer output_buffer;
+        output_buffer.resize(output_bytes);
+        NdCopy<float>(input_buffer, input_start, input_count, true, true,
+                      output_buffer, output_start, output_count, true, true);
+        if(i == rounds - 1)
+            last.swap(output_buffer);
+    }
+    auto end = std::chrono::system_clock::now();
+    auto buffer_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    bool correct = true;
+    start = std::chrono::system_clock::now();
+    for(int i=0; i<rounds; ++i){
+        // the overlap covers the whole output, so nothing is left unwritten
+        HugeBuffer output_buffer;
+        output_buffer.resize(output_bytes);
+        NdCopy<float>(input_buffer, input_start, input_count, true, true,
+                      output_buffer, output_start, output_count, true, true);
+        if(i == rounds - 1)
+            correct = std::equal(last.begin(), last.end(), output_buffer.begin());
+    }
+    end = std::chrono::system_clock::now();
+    auto huge_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    std::cout<<"Buffer:     "<<buffer_usec<<" usec"<<std::endl;
+    std::cout<<"HugeBuffer: "<<huge_usec<<" usec"<<std::endl;
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void demo_small_block_copy(){
+    // row-major copies of thin slabs (4 to 64 byte blocks) run the small
+    // block kernel; checked against the generic iterative kernel, once with
+    // the rows in the outermost dimension and once with padding on both
+    // sides
+    std::cout<<"small block kernel against the generic kernel:"<<std::endl;
+    for(size_t bytes : {4, 8, 16, 32, 64}){
+        for(size_t c=0; c<2; ++c){
+            Dims in_start = {0,0}, in_count = {37,100};
+            Dims out_start = {0,10}, out_count = {37,bytes};
+            Dims out_mem_start, out_mem_count;
+            if(c == 1){
+                in_start = {0,0,0};
+                in_count = {9,11,90};
+                out_start = {1,2,20};
+                out_count = {7,8,bytes};
+                out_mem_start = {0,1,17};
+                out_mem_count = {9,10,bytes + 6};
+            }
+            const Dims &out_mem = c == 1 ? out_mem_count : out_count;
+            Buffer input_buffer(std::accumulate(in_count.begin(), in_count.end(), size_t(1), std::multiplies<size_t>()));
+            Buffer output_buffer(std::accumulate(out_mem.begin(), out_mem.end(), size_t(1), std::multiplies<size_t>()), 0);
+            Buffer generic_buffer(output_buffer);
+            for(size_t i=0; i<input_buffer.size(); ++i)
+                input_buffer[i] = static_cast<char>(i * 7 + 1);
+            NdCopyPlan plan;
+            NdCopyMakePlan(plan, in_start, in_count, true, true, out_start, out_count, true, true,
+                           Dims(), Dims(), out_mem_start, out_mem_count, false, 1);
+            NdCopy<char>(input_buffer.data(), in_start, in_count, true, true,
+                         output_buffer.data(), out_start, out_count, true, true,
+                         Dims(), Dims(), out_mem_start, out_mem_count);
+            const char *in = input_buffer.data() + plan.inOvlpOffset;
+            char *out = generic_buffer.data() + plan.outOvlpOffset;
+            NdCopyIterDFSeqPadding(in, out, plan.inOvlpGapSize, plan.outOvlpGapSize,
+                                   plan.ovlpCount, plan.minContDim, plan.blockSize);
+            const bool correct = plan.kernel == NdCopyPlan::IterSeqPaddingSmall &&
+                                 plan.minContDim - 1 == (c == 1 ? 1 : 0) &&
+                                 output_buffer == generic_buffer;
+            std::cout<<bytes<<" byte blocks, "<<(c == 1 ? "padded 3d" : "2d")<<": "
+                     <<(correct ? "data correct" : "Data not correct!")<<std::endl;
+        }
+    }
+}
+
 void demo_reversed_major_copy(){
     // input:row major, output:col major, same-endian demo
     std::cout<<"copy from row major to col major, 2d data:"<<std::endl;
@@ -323,6 +480,42 @@ void demo_reversed_major_copy_col2row() {
     Dims output_count = {10, 10};
     RunTestDiffMajorMode<int>(input_start, input_count, output_start, output_count, false, true, false);
 }
+void demo_reversed_major_copy_ovlp_offsets(){
+    // row-major <==> col-major with the overlap at a different offset in
+    // every dimension of both buffers, checked element by element
+    std::cout<<"copy between row major and col major, overlap offset differing per dim, 3d data:"<<std::endl;
+    Dims row_start = {1,2,3};
+    Dims row_count = {4,5,6};
+    Dims col_start = {0,3,1};
+    Dims col_count = {7,3,9};
+    const size_t row_size = 4*5*6, col_size = 7*3*9;
+    std::vector<int> row(row_size), col(col_size), row2(row_size, -1), col2(col_size, -1);
+    std::iota(row.begin(), row.end(), 0);
+    std::iota(col.begin(), col.end(), 1000);
+    NdCopy<int>(reinterpret_cast<const char*>(row.data()), row_start, row_count, true, true,
+                reinterpret_cast<char*>(col2.data()), col_start, col_count, false, true);
+    NdCopy<int>(reinterpret_cast<const char*>(col.data()), col_start, col_count, false, true,
+                reinterpret_cast<char*>(row2.data()), row_start, row_count, true, true);
+    bool correct = true;
+    for(size_t z=0; z<4; ++z)
+        for(size_t y=0; y<5; ++y)
+            for(size_t x=0; x<6; ++x){
+                const size_t g[3] = {row_start[0] + z, row_start[1] + y, row_start[2] + x};
+                const size_t r = (z*5 + y)*6 + x;
+                bool inside = true;
+                size_t c = 0;
+                for(size_t d=3; d-- > 0;){
+                    inside = inside && g[d] >= col_start[d] && g[d] < col_start[d] + col_count[d];
+                    c = c*col_count[d] + (g[d] - col_start[d]);
+                }
+                if(inside)
+                    correct = correct && col2[c] == row[r] && row2[r] == col[c];
+                else
+                    correct = correct && row2[r] == -1;
+            }
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
 void demo_copy_between_any_majors(){
     std::cout<<"customized copy between any majors, 2d data:"<<std::endl;
     bool inIsRowMaj=false;
@@ -360,7 +553,1235 @@ void demo_copy_between_reversed_endians(){
                                 outIsBigEnd,safeMode);
 }
 
+// a record with fields of mixed widths and bytes that are not numbers, for
+// demo_copy_structured_elements_between_endians()
+struct DemoRecord {
+    float x;
+    int16_t id;
+    char tag[2];
+    double weight;
+};
+
+template <> struct NdCopyElmTraits<DemoRecord> {
+    static NdCopyElmDesc Desc() {
+        return NdCopyElmDesc({{offsetof(DemoRecord, x), 4},
+                              {offsetof(DemoRecord, id), 2},
+                              {offsetof(DemoRecord, weight), 8}});
+    }
+};
+
+// DemoBytesReversed(): true if b holds the bytes of a in reverse order
+static bool DemoBytesReversed(const char *a, const char *b, size_t width){
+    for(size_t j=0; j<width; ++j)
+        if(a[j] != b[width - 1 - j])
+            return false;
+    return true;
+}
+
+void demo_copy_structured_elements_between_endians(){
+    // std::complex<double> swaps its real and imaginary parts separately,
+    // DemoRecord every numeric field on its own and leaves tag as it is
+    std::cout<<"copy std::complex<double> and a mixed field struct between reversed endians:"<<std::endl;
+    Dims start = {0,0};
+    Dims count = {6,5};
+    Dims sub_start = {1,1};
+    Dims sub_count = {4,3};
+    const size_t n = 6*5;
+
+    std::vector<std::complex<double>> cplx_in(n), cplx_out(4*3);
+    std::vector<DemoRecord> rec_in(n), rec_out(4*3);
+    for(size_t i=0; i<n; ++i){
+        cplx_in[i] = std::complex<double>(1.5 + i, -0.25 * i);
+        rec_in[i].x = 0.5f * i;
+        rec_in[i].id = static_cast<int16_t>(1000 + i);
+        rec_in[i].tag[0] = 'a' + i % 26;
+        rec_in[i].tag[1] = 'A' + i % 26;
+        rec_in[i].weight = 1.0 / (i + 1);
+    }
+    NdCopy<std::complex<double>>(reinterpret_cast<const char*>(cplx_in.data()), start, count, true, true,
+                                 reinterpret_cast<char*>(cplx_out.data()), sub_start, sub_count, true, false);
+    NdCopy<DemoRecord>(reinterpret_cast<const char*>(rec_in.data()), start, count, true, true,
+                       reinterpret_cast<char*>(rec_out.data()), sub_start, sub_count, true, false);
+
+    bool correct = true;
+    for(size_t y=0; y<4; ++y)
+        for(size_t x=0; x<3; ++x){
+            const size_t i = (y + 1) * 5 + x + 1, o = y * 3 + x;
+            const char *ci = reinterpret_cast<const char*>(&cplx_in[i]);
+            const char *co = reinterpret_cast<const char*>(&cplx_out[o]);
+            correct = correct && DemoBytesReversed(ci, co, 8) &&
+                      DemoBytesReversed(ci + 8, co + 8, 8);
+            const DemoRecord &a = rec_in[i], &b = rec_out[o];
+            correct = correct &&
+                      DemoBytesReversed(reinterpret_cast<const char*>(&a.x), reinterpret_cast<const char*>(&b.x), 4) &&
+                      DemoBytesReversed(reinterpret_cast<const char*>(&a.id), reinterpret_cast<const char*>(&b.id), 2) &&
+                      a.tag[0] == b.tag[0] && a.tag[1] == b.tag[1] &&
+                      DemoBytesReversed(reinterpret_cast<const char*>(&a.weight), reinterpret_cast<const char*>(&b.weight), 8);
+        }
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void demo_axis_permutation_copy(int iters){
+    // NHWC ==> NCHW, compared against the plain nested loop it replaces
+    std::cout<<"copy from NHWC to NCHW, 4d data:"<<std::endl;
+    Dims start = {0,0,0,0};
+    Dims count = {4,128,128,3}; // logical N,H,W,C
+    Dims nhwc = {0,1,2,3};
+    Dims nchw = {0,3,1,2};
+    size_t N=count[0], H=count[1], W=count[2], C=count[3];
+
+    Buffer input_buffer, output_buffer, output_buffer2;
+    input_buffer.resize(N*H*W*C*sizeof(float));
+    output_buffer.resize(input_buffer.size());
+    output_buffer2.resize(input_buffer.size());
+    MakeData<float>(input_buffer, count, false);
+    const float *in = reinterpret_cast<const float*>(input_buffer.data());
+    float *out2 = reinterpret_cast<float*>(output_buffer2.data());
+
+    auto start1 = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i){
+        NdCopyPermute<float>(input_buffer.data(), start, count, nhwc, true,
+                             output_buffer.data(), start, count, nchw, true);
+    }
+    auto end1 = std::chrono::system_clock::now();
+
+    auto start2 = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i){
+        for(size_t n=0; n<N; ++n)
+            for(size_t h=0; h<H; ++h)
+                for(size_t w=0; w<W; ++w)
+                    for(size_t c=0; c<C; ++c)
+                        out2[((n*C+c)*H+h)*W+w] = in[((n*H+h)*W+w)*C+c];
+    }
+    auto end2 = std::chrono::system_clock::now();
+
+    if(output_buffer != output_buffer2){
+        std::cout << "Data not correct!" << std::endl;
+    }
+    std::cout << "NdCopyPermute spent: "
+    << std::chrono::duration_cast<std::chrono::microseconds>(end1-start1).count()
+    << " usec; nested loop spent: "
+    << std::chrono::duration_cast<std::chrono::microseconds>(end2-start2).count()
+    << " usec" << std::endl;
+}
+
+void demo_strided_view_copy(){
+    // input: 4x5 ints in rows padded to an 8 int pitch, read through a view
+    // that flips the column axis. output: densely packed row major.
+    std::cout<<"copy from a padded, column flipped view, 2d data:"<<std::endl;
+    Dims start = {0,0};
+    Dims count = {4,5};
+    Dims pitched_count = {4,8};
+    Buffer input_buffer, output_buffer;
+    input_buffer.resize(4*8*sizeof(int));
+    output_buffer.resize(4*5*sizeof(int));
+    MakeData<int>(input_buffer, pitched_count, false);
+    Strides in_stride = {8*sizeof(int), -static_cast<std::ptrdiff_t>(sizeof(int))};
+    if(NdCopyStrided<int>(input_buffer.data() + 4*sizeof(int), start, count,
+                          in_stride, true, output_buffer.data(), start, count,
+                          Strides(), true))
+    {
+        std::cout<<"no overlap found"<<std::endl;
+    }
+    std::cout << "*************** input_buffer ****************" << std::endl;
+    PrintData<int>(input_buffer, pitched_count);
+    std::cout << "*************** output_buffer ****************" << std::endl;
+    PrintData<int>(output_buffer, count);
+    // a stride list with one stride too few is rejected, nothing is copied
+    const Buffer before = output_buffer;
+    const int res = NdCopyStrided<int>(input_buffer.data(), start, count,
+                                       Strides{8*sizeof(int)}, true, output_buffer.data(),
+                                       start, count, Strides(), true);
+    std::cout<<"wrong sized stride list: "<<(res == -1 && output_buffer == before
+                                             ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void demo_copy_with_fused_stats(){
+    // per-block min/max/sum computed while copying, no second pass
+    std::cout<<"copy with fused statistics, 2d data:"<<std::endl;
+    Dims input_start = {2,4};
+    Dims input_count = {3,3};
+    Dims output_start = {0,0};
+    Dims output_count = {10,10};
+    Buffer input_buffer, output_buffer;
+    input_buffer.resize(3*3*sizeof(double));
+    output_buffer.resize(10*10*sizeof(double));
+    MakeData<double>(input_buffer, input_count, false);
+    NdCopyStats<double> stats;
+    NdCopyOptions<double> options;
+    options.stats = &stats;
+    if(NdCopy<double>(input_buffer, input_start, input_count, true, true,
+                      output_buffer, output_start, output_count, true, true,
+                      Dims(), Dims(), Dims(), Dims(), false, options))
+    {
+        std::cout<<"no overlap found"<<std::endl;
+    }
+    std::cout << "count: " << stats.count << ", min: " << stats.min
+              << ", max: " << stats.max << ", sum: " << stats.sum
+              << ", NaNs: " << stats.nanCount << std::endl;
+}
+
+void demo_copy_with_checksum(){
+    // CRC32C of the written overlap computed while copying, then checked
+    // against the output the way a receiver would
+    std::cout<<"copy with fused checksum, 3d data:"<<std::endl;
+    Dims input_start = {1,2,0};
+    Dims input_count = {40,50,300};
+    Dims output_start = {0,0,1};
+    Dims output_count = {60,80,200};
+    Buffer input_buffer;
+    HugeBuffer output_buffer;
+    input_buffer.resize(40*50*300*sizeof(float));
+    output_buffer.resize(60*80*200*sizeof(float));
+    MakeData<float>(input_buffer, input_count, false);
+    uint32_t crc = 0;
+    NdCopyOptions<float> options;
+    options.crc32c = &crc;
+    if(NdCopy<float>(input_buffer, input_start, input_count, true, true,
+                     output_buffer, output_start, output_count, true, true,
+                     Dims(), Dims(), Dims(), Dims(), false, options))
+    {
+        std::cout<<"no overlap found"<<std::endl;
+    }
+    Dims ovlp_start = {1,2,1};
+    Dims ovlp_count = {40,50,200};
+    uint32_t check = NdCopyChecksumBox<float>(output_buffer.data(),
+            output_start, output_count, ovlp_start, ovlp_count);
+    std::cout << std::hex << "crc32c: 0x" << crc << ", receiver: 0x" << check
+              << std::dec << (crc == check ? " (match)" : " (MISMATCH)")
+              << std::endl;
+}
+
+void demo_copy_with_fill(){
+    // the overlap is copied and the rest of the output set to -1 in one
+    // pass, instead of filling the whole output first
+    std::cout<<"copy with fill of the uncovered part, 2d data:"<<std::endl;
+    Dims input_start = {2,4};
+    Dims input_count = {3,3};
+    Dims output_start = {0,0};
+    Dims output_count = {6,8};
+    Buffer input_buffer, output_buffer;
+    input_buffer.resize(3*3*sizeof(int));
+    output_buffer.resize(6*8*sizeof(int));
+    MakeData<int>(input_buffer, input_count, false);
+    const int fill = -1;
+    NdCopyOptions<int> options;
+    options.fill = &fill;
+    if(NdCopy<int>(input_buffer, input_start, input_count, true, true,
+                   output_buffer, output_start, output_count, true, true,
+                   Dims(), Dims(), Dims(), Dims(), false, options))
+    {
+        std::cout<<"no overlap found"<<std::endl;
+    }
+    PrintData<int>(output_buffer, output_count);
+}
+
+void demo_stream_copy_from_file(){
+    // a sub-box of a file backed global array, read in large sequential
+    // ranges through two staging buffers instead of mapping the file
+    std::cout<<"streaming copy from a file, 3d data:"<<std::endl;
+    Dims shape = {64,256,512};
+    Buffer global_buffer;
+    global_buffer.resize(64*256*512*sizeof(float));
+    MakeData<float>(global_buffer, shape, false);
+    const char *path = "ndcopy_stream_demo.bin";
+    FILE *file = std::fopen(path, "wb");
+    if(file == nullptr){
+        std::cout<<"cannot create "<<path<<std::endl;
+        return;
+    }
+    std::fwrite(global_buffer.data(), 1, global_buffer.size(), file);
+    std::fclose(file);
+
+    NdCopyFileSource source;
+    source.fd = open(path, O_RDONLY);
+    source.shape = shape;
+    Dims output_start = {8,32,100};
+    Dims output_count = {48,192,300};
+    HugeBuffer output_buffer, output_buffer2;
+    output_buffer.resize(48*192*300*sizeof(float));
+    output_buffer2.resize(48*192*300*sizeof(float));
+    auto start = std::chrono::system_clock::now();
+    int res = NdCopyFromFile<float>(source, output_buffer.data(), output_start,
+                                    output_count, true, true);
+    auto end = std::chrono::system_clock::now();
+    close(source.fd);
+    std::remove(path);
+    NdCopy<float>(global_buffer, Dims(3,0), shape, true, true, output_buffer2,
+                  output_start, output_count, true, true);
+    std::cout << "result: " << res << ", time spent: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                         end - start).count()
+              << " usec, "
+              << (output_buffer == output_buffer2 ? "data correct"
+                                                  : "Data not correct!")
+              << std::endl;
+}
+
+// SocketSendAll()/SocketRecvAll(): helpers of the socket baseline below
+static bool SocketSendAll(int fd, const char *data, size_t size){
+    while(size > 0){
+        ssize_t n = write(fd, data, size);
+        if(n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+static bool SocketRecvAll(int fd, char *data, size_t size){
+    while(size > 0){
+        ssize_t n = read(fd, data, size);
+        if(n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+void performance_test_shm_ring_transport(int iters){
+    // producer and consumer processes exchanging sub-arrays of a 3d global
+    // array: shared memory ring (one NdCopy on each side) against a socket
+    // pair (pack copy + kernel copy + unpack copy)
+    std::cout<<"shm ring vs socket transport between two processes:"<<std::endl;
+    Dims global_count = {64,128,256};
+    Dims sel_start = {0,8,16};
+    Dims sel_count = {16,112,224};
+    const size_t msg_bytes = 16*112*224*sizeof(float);
+    const int num_msgs = 64 * iters;
+    Buffer global_buffer;
+    global_buffer.resize(64*128*256*sizeof(float));
+    MakeData<float>(global_buffer, global_count, false);
+    Buffer consumer_buffer;
+    consumer_buffer.resize(global_buffer.size());
+
+    // shm ring
+    std::string name = "/ndcopy_demo_" + std::to_string(getpid());
+    NdCopyShmRing ring;
+    if(ring.Create(name.c_str(), 4, msg_bytes)){
+        std::cout<<"cannot create shared memory ring"<<std::endl;
+        return;
+    }
+    auto start = std::chrono::system_clock::now();
+    pid_t pid = fork();
+    if(pid == 0){
+        NdCopyShmRing producer;
+        producer.Open(name.c_str());
+        for(int i=0; i<num_msgs; ++i){
+            Dims msg_start = sel_start;
+            msg_start[0] = (i % 4) * 16;
+            NdCopyShmPut<float>(producer, global_buffer.data(), Dims(3,0),
+                                global_count, true, true, msg_start, sel_count);
+        }
+        producer.CloseProducer();
+        _exit(0);
+    }
+    int msgs = 0;
+    int res;
+    while((res = NdCopyShmGet<float>(ring, consumer_buffer.data(), Dims(3,0),
+                                     global_count, true, true)) != 2 && res != 3)
+        msgs++;
+    waitpid(pid, nullptr, 0);
+    auto end = std::chrono::system_clock::now();
+    double shm_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    // socket pair baseline
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds)){
+        std::cout<<"cannot create socket pair"<<std::endl;
+        return;
+    }
+    Buffer msg_buffer;
+    msg_buffer.resize(msg_bytes);
+    start = std::chrono::system_clock::now();
+    pid = fork();
+    if(pid == 0){
+        close(fds[0]);
+        for(int i=0; i<num_msgs; ++i){
+            Dims msg_start = sel_start;
+            msg_start[0] = (i % 4) * 16;
+            NdCopy<float>(global_buffer, Dims(3,0), global_count, true, true,
+                          msg_buffer, msg_start, sel_count, true, true);
+            SocketSendAll(fds[1], msg_buffer.data(), msg_bytes);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    int socket_msgs = 0;
+    for(int i=0; i<num_msgs; ++i){
+        Dims msg_start = sel_start;
+        msg_start[0] = (i % 4) * 16;
+        if(!SocketRecvAll(fds[0], msg_buffer.data(), msg_bytes))
+            break;
+        NdCopy<float>(msg_buffer, msg_start, sel_count, true, true,
+                      consumer_buffer, Dims(3,0), global_count, true, true);
+        socket_msgs++;
+    }
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+    end = std::chrono::system_clock::now();
+    double socket_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    std::cout<<"messages: "<<msgs<<" x "<<msg_bytes<<" bytes"<<std::endl;
+    std::cout<<"shm ring: "<<msgs*(double)msg_bytes/shm_usec/1000<<" GB/s"<<std::endl;
+    std::cout<<"socket:   "<<socket_msgs*(double)msg_bytes/socket_usec/1000<<" GB/s"<<std::endl;
+
+    // a consumer gives up on a ring that stays empty, and on one whose
+    // producer died without closing it
+    std::string idle_name = name + "_idle";
+    NdCopyShmRing idle;
+    idle.Create(idle_name.c_str(), 4, msg_bytes);
+    idle.SetTimeout(50);
+    int idle_res = NdCopyShmGet<float>(idle, consumer_buffer.data(), Dims(3,0),
+                                       global_count, true, true);
+    pid = fork();
+    if(pid == 0){
+        NdCopyShmRing producer;
+        producer.Open(idle_name.c_str());
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    idle.SetTimeout(-1);
+    int dead_res = NdCopyShmGet<float>(idle, consumer_buffer.data(), Dims(3,0),
+                                       global_count, true, true);
+    if(idle_res == 3 && dead_res == 3)
+        std::cout<<"idle and dead producer: data correct"<<std::endl;
+    else
+        std::cout<<"idle and dead producer: Data not correct!"<<std::endl;
+}
+
+void demo_wire_message(){
+    // a sub-array message with a self-describing header: consumed in place
+    // when the receiver wants exactly that box in the same layout, unpacked
+    // into a bigger box otherwise
+    std::cout<<"sub-array wire message, 2d data:"<<std::endl;
+    Dims global_count = {8,8};
+    Dims sel_start = {2,3};
+    Dims sel_count = {3,4};
+    Buffer global_buffer;
+    global_buffer.resize(8*8*sizeof(int));
+    MakeData<int>(global_buffer, global_count, false);
+    std::vector<uint64_t> msg_buffer((NdCopyWireMaxHeaderBytes(2) + 3*4*sizeof(int)) / 8 + 1);
+    char *msg = reinterpret_cast<char *>(msg_buffer.data());
+    size_t msg_bytes = 0;
+    NdCopyWirePack<int>(msg, msg_buffer.size() * 8, msg_bytes,
+                        global_buffer.data(), Dims(2,0), global_count, true,
+                        true, global_count, sel_start, sel_count);
+    NdCopyWireHeader header;
+    if(NdCopyWireDecode(msg, msg_bytes, header)){
+        std::cout<<"malformed message"<<std::endl;
+        return;
+    }
+    std::cout<<"message: "<<msg_bytes<<" bytes, header: "<<header.headerBytes
+             <<" bytes"<<std::endl;
+    const char *view = NdCopyWireView<int>(msg, header, sel_start, sel_count,
+                                           true, true);
+    std::cout<<"in place: "<<(view != nullptr ? "yes" : "no")<<std::endl;
+    Dims output_count = {6,6};
+    Buffer output_buffer;
+    output_buffer.resize(6*6*sizeof(int));
+    MakeData<int>(output_buffer, output_count, true);
+    NdCopyWireUnpack<int>(msg, msg_bytes, output_buffer.data(), Dims(2,0),
+                          output_count, false, true);
+    std::cout<<"unpacked into a col major 6x6 box:"<<std::endl;
+    PrintData<int>(output_buffer, output_count);
+}
+
+void performance_test_pack_unpack(int iters){
+    // packing a sub-box into a contiguous send buffer: NdCopy with an output
+    // box faked to the overlap, against a reusable NdCopyPackType
+    std::cout<<"pack a sub-box into a contiguous buffer, 3d data:"<<std::endl;
+    Dims buffer_start = {0,0,0};
+    Dims buffer_count = {64,256,256};
+    Dims box_start = {8,16,16};
+    Dims box_count = {48,224,56};
+    Buffer buffer, packed, packed2;
+    buffer.resize(64*256*256*sizeof(double));
+    packed.resize(48*224*56*sizeof(double));
+    packed2.resize(packed.size());
+    MakeData<double>(buffer, buffer_count, false);
+
+    auto start = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i)
+        NdCopy<double>(buffer, buffer_start, buffer_count, true, true,
+                       packed, box_start, box_count, true, true);
+    auto end = std::chrono::system_clock::now();
+    auto ndcopy_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    NdCopyPackType type(buffer_start, buffer_count, box_start, box_count,
+                        sizeof(double));
+    start = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i)
+        NdCopyPack(type, buffer.data(), packed2.data(), 1);
+    end = std::chrono::system_clock::now();
+    auto pack_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    bool correct = packed == packed2;
+
+    start = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i)
+        NdCopyPack(type, buffer.data(), packed2.data());
+    end = std::chrono::system_clock::now();
+    auto parallel_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    correct = correct && packed == packed2;
+
+    std::cout<<"NdCopy:              "<<ndcopy_usec<<" usec"<<std::endl;
+    std::cout<<"NdCopyPack:          "<<pack_usec<<" usec"<<std::endl;
+    std::cout<<"NdCopyPack parallel: "<<parallel_usec<<" usec"<<std::endl;
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void performance_test_plan_cache(int iters){
+    // many small copies whose geometries recur but differ from call to call,
+    // e.g. the faces of a 3d block: each geometry is planned once, later
+    // calls hit NdCopyPlanCache
+    std::cout<<"small copies, 6 recurring geometries, 3d data:"<<std::endl;
+    Dims buffer_start = {0,0,0};
+    Dims buffer_count = {10,10,10};
+    std::vector<Dims> face_start = {{0,0,0},{9,0,0},{0,0,0},{0,9,0},{0,0,0},{0,0,9}};
+    std::vector<Dims> face_count = {{1,10,10},{1,10,10},{10,1,10},{10,1,10},{10,10,1},{10,10,1}};
+    Buffer buffer, face;
+    buffer.resize(10*10*10*sizeof(double));
+    face.resize(10*10*sizeof(double));
+    MakeData<double>(buffer, buffer_count, false);
+    const int rounds = 20000*iters;
+    NdCopyPlanCache &cache = NdCopyPlanCache::Instance();
+
+    auto RunRounds = [&](){
+        auto start = std::chrono::system_clock::now();
+        for(int i=0; i<rounds; ++i)
+            for(size_t f=0; f<face_start.size(); ++f)
+                NdCopy<double>(buffer, buffer_start, buffer_count, true, true,
+                               face, face_start[f], face_count[f], true, true);
+        auto end = std::chrono::system_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    };
+    const size_t capacity = NdCopyPlanCache::DefaultCapacity;
+    cache.SetCapacity(0);
+    auto uncached_usec = RunRounds();
+    cache.SetCapacity(capacity);
+    cache.Clear();
+    cache.ResetStats();
+    auto cached_usec = RunRounds();
+    NdCopyPlanCache::Stats stats = cache.GetStats();
+
+    std::cout<<"planned every call: "<<uncached_usec<<" usec"<<std::endl;
+    std::cout<<"plan cache:         "<<cached_usec<<" usec"<<std::endl;
+    std::cout<<"hits "<<stats.hits<<", misses "<<stats.misses
+             <<", evictions "<<stats.evictions<<", cached plans "
+             <<stats.size<<std::endl;
+}
+
+void demo_autotune_profile(){
+    // first run on a machine: tune and write the profile; later runs load it
+    const char *path = "ndcopy_tuning_demo.prof";
+    std::remove(path);
+    auto start = std::chrono::steady_clock::now();
+    int res = NdCopyTuneAtStartup(path);
+    auto end = std::chrono::steady_clock::now();
+    auto tune_msec = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout<<"tuned and saved (res "<<res<<") in "<<tune_msec<<" msec:"<<std::endl;
+    const NdCopyTuning &tuning = NdCopyGetTuning();
+    std::cout<<"cpu "<<NdCopyCpuName()<<std::endl;
+    std::cout<<"iterative kernels: row==>row "<<tuning.iterSeqPadding
+             <<", involving col-major "<<tuning.iterDynamic<<std::endl;
+    std::cout<<"aligned block copy for "<<tuning.alignedBlockMin<<" to "
+             <<tuning.alignedBlockMax<<" bytes"<<std::endl;
+    std::cout<<"pack: up to "<<tuning.packMaxThreads<<" threads from "
+             <<tuning.packParallelMinBytes<<" bytes"<<std::endl;
+    std::cout<<"strided tile: "<<tuning.stridedTileBytes<<" byte rows, "
+             <<tuning.stridedTileArea<<" bytes at least"<<std::endl;
+
+    start = std::chrono::steady_clock::now();
+    res = NdCopyTuneAtStartup(path);
+    end = std::chrono::steady_clock::now();
+    auto load_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::cout<<"second run loaded the profile (res "<<res<<") in "<<load_usec<<" usec"<<std::endl;
+    std::remove(path);
+}
+
+// copy kernels and shapes benchmarked by demos 18 and 19 (and --bench)
+struct KernelCase {
+    std::string label;
+    Dims in_count, out_start, out_count;
+    bool in_row_major, out_row_major, out_little_endian;
+};
+
+static std::vector<KernelCase> KernelCases(){
+    return {
+        {"row>row big blocks 64^3 dbl", {64,64,64}, {1,1,1}, {62,62,62}, true, true, true},
+        {"row>row 16B blocks 256^3 dbl", {256,256,256}, {0,0,100}, {256,256,2}, true, true, true},
+        {"row>row 4B blocks 256^3 flt", {256,256,256}, {0,0,100}, {256,256,1}, true, true, true},
+        {"row>row rev endian 64^3 dbl", {64,64,64}, {1,1,1}, {62,62,62}, true, true, false},
+        {"row>col 64^3 flt", {64,64,64}, {0,0,0}, {64,64,64}, true, false, true},
+        {"col>row 1024^2 flt", {1024,1024}, {0,0}, {1024,1024}, false, true, true},
+        {"row>col rev endian 1024^2 flt", {1024,1024}, {0,0}, {1024,1024}, true, false, false},
+    };
+}
+
+// RunKernelCase(): iters copies of the case, after one warm up copy (page
+// faults, plan cache); returns the time in usec and the least bytes the
+// copies move. counters, if given, run around the timed copies. result, if
+// given, gets the output of the warm up copy of a patterned input.
+static long long RunKernelCase(const KernelCase &c, int iters, PerfCounters *counters, double &bytes,
+                               Buffer *result = nullptr){
+    const Dims in_start(c.in_count.size(), 0);
+    const bool dbl = c.label.find("dbl") != std::string::npos;
+    const size_t elm_size = dbl ? sizeof(double) : sizeof(float);
+    Buffer in, out;
+    in.resize(std::accumulate(c.in_count.begin(), c.in_count.end(), elm_size, std::multiplies<size_t>()));
+    out.resize(std::accumulate(c.out_count.begin(), c.out_count.end(), elm_size, std::multiplies<size_t>()));
+    // the overlap is read once and written once
+    bytes = 2.0 * elm_size * iters;
+    for(size_t i = 0; i < in_start.size(); ++i)
+        bytes *= std::min(in_start[i] + c.in_count[i], c.out_start[i] + c.out_count[i]) -
+                 std::max(in_start[i], c.out_start[i]);
+    auto Copy = [&](){
+        if(dbl)
+            NdCopy<double>(in, in_start, c.in_count, c.in_row_major, true,
+                           out, c.out_start, c.out_count, c.out_row_major, c.out_little_endian);
+        else
+            NdCopy<float>(in, in_start, c.in_count, c.in_row_major, true,
+                          out, c.out_start, c.out_count, c.out_row_major, c.out_little_endian);
+    };
+    if(result){
+        for(size_t i = 0; i < in.size(); ++i)
+            in[i] = static_cast<char>(i * 7 + 1);
+        Copy();
+        *result = out;
+    }else{
+        Copy();
+    }
+    if(counters)
+        counters->Start();
+    auto start = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i)
+        Copy();
+    auto end = std::chrono::system_clock::now();
+    if(counters)
+        counters->Stop();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+void performance_counters_per_kernel(int iters){
+    // wall time plus hardware counters for each copy kernel on a few shapes,
+    // to tell cache/TLB misses from branch mispredicts in the traversal
+    PerfCounters counters;
+    if(!counters.Available())
+        std::cout<<"hardware counters unavailable ("<<counters.Error()
+                 <<"), wall time only"<<std::endl;
+    std::printf("%-34s %14s", "kernel/shape", "wall");
+    for(int e = 0; e < PerfCounters::NumEvents; ++e)
+        std::printf(" %12s", PerfCounters::Name(static_cast<PerfCounters::Event>(e)));
+    std::printf("\n");
+    for(const KernelCase &c : KernelCases()){
+        double bytes;
+        const long long usec = RunKernelCase(c, iters, &counters, bytes);
+        PrintPerfCounters(c.label, usec, counters);
+    }
+}
+
+void performance_roofline(int iters, const std::string &results_path){
+    // each kernel's bandwidth as a fraction of what the machine's memory
+    // achieves on a plain STREAM copy. the time of a kernel is the median
+    // of BenchRuns runs of iters copies each
+    if(iters < 1){
+        std::cout<<"iters has to be at least 1"<<std::endl;
+        return;
+    }
+    const double peak = StreamCopyBandwidth();
+    std::printf("STREAM copy peak: %.2f GB/s\n", peak);
+    std::vector<BenchResult> results;
+    for(const KernelCase &c : KernelCases()){
+        BenchResult r;
+        r.label = c.label;
+        std::vector<double> samples;
+        for(int run=0; run<BenchRuns; ++run){
+            const long long usec = RunKernelCase(c, iters, nullptr, r.bytes);
+            samples.push_back(std::max<double>(usec, 1) / iters);
+        }
+        r.usecPerIter = MedianOf(samples);
+        r.bytes /= iters;
+        PrintRoofline(r, peak);
+        results.push_back(r);
+    }
+    if(!results_path.empty()){
+        if(WriteBenchResults(results_path, results, peak))
+            std::cout<<"results written to "<<results_path<<std::endl;
+        else
+            std::cout<<"cannot write "<<results_path<<std::endl;
+    }
+}
+
+void performance_simd_levels(int iters){
+    // the kernels of every ISA level the library build selects from, on the
+    // same shapes and inputs; the level selected at load time is marked.
+    // every level's output has to match the generic level's bit for bit
+#if defined(NDCOPY_SIMD_DISPATCH)
+    const NdCopySimdLevel selected = NdCopySimd().level;
+    std::vector<NdCopySimdLevel> levels;
+    std::printf("%-34s", "kernel/shape");
+    for(int l = NdCopySimdGeneric; l <= NdCopySimdAvx512; ++l)
+        if(NdCopySimdSupported(NdCopySimdLevel(l))){
+            levels.push_back(NdCopySimdLevel(l));
+            std::printf(" %11s%c", NdCopySimdLevelName(NdCopySimdLevel(l)),
+                        l == selected ? '*' : ' ');
+        }
+    std::printf("\n");
+    bool correct = true;
+    for(const KernelCase &c : KernelCases()){
+        std::printf("%-34s", c.label.c_str());
+        Buffer reference, result;
+        for(NdCopySimdLevel level : levels){
+            NdCopySimdSetLevel(level);
+            double bytes;
+            std::printf(" %7lld usec", RunKernelCase(c, iters, nullptr, bytes, &result));
+            if(level == NdCopySimdGeneric)
+                reference = result;
+            else if(result != reference){
+                std::printf(" (differs)");
+                correct = false;
+            }
+        }
+        std::printf("\n");
+    }
+    // Row(): times run at every level, after a warm up run whose output (out)
+    // is compared with the generic level's
+    Buffer out;
+    auto Row = [&](const char *label, const std::function<void()> &run){
+        std::printf("%-34s", label);
+        Buffer reference;
+        for(NdCopySimdLevel level : levels){
+            NdCopySimdSetLevel(level);
+            std::fill(out.begin(), out.end(), 0);
+            run();
+            if(level == NdCopySimdGeneric)
+                reference = out;
+            auto start = std::chrono::steady_clock::now();
+            for(int i=0; i<iters; ++i)
+                run();
+            auto end = std::chrono::steady_clock::now();
+            std::printf(" %7lld usec", static_cast<long long>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()));
+            if(out != reference){
+                std::printf(" (differs)");
+                correct = false;
+            }
+        }
+        std::printf("\n");
+    };
+    // 2d transposition through NdCopyPermute(), the tiled kernel
+    const size_t n = 1024;
+    std::vector<float> in(n * n);
+    std::iota(in.begin(), in.end(), 0.0f);
+    out.resize(n * n * sizeof(float));
+    Row("permute transpose 1024^2 flt", [&](){
+        NdCopyPermute<float>(reinterpret_cast<const char *>(in.data()), {0, 0}, {n, n}, {}, true,
+                             out.data(), {0, 0}, {n, n}, {1, 0}, true);
+    });
+    // quantization there and back, and byte shuffling there and back, of a
+    // sub-box of a smooth field; out holds the message, then the field
+    const size_t m = 64;
+    const Dims field_count = {m, m, m};
+    std::vector<float> field_flt(m * m * m);
+    std::vector<double> field_dbl(m * m * m);
+    for(size_t k=0; k<m*m*m; ++k){
+        field_dbl[k] = std::sin(0.05 * (k % m)) * std::cos(0.03 * (k / m % m)) + 0.01 * (k / (m * m));
+        field_flt[k] = float(field_dbl[k]);
+    }
+    const char *format_names[] = {"fp16", "bf16", "int16"};
+    for(int f=NdCopyQuantFp16; f<=NdCopyQuantInt16; ++f){
+        const NdCopyQuantFormat format = NdCopyQuantFormat(f);
+        for(size_t elm_size : {sizeof(float), sizeof(double)}){
+            const NdCopyPackType type({0,0,0}, field_count, {4,4,4}, {56,56,56}, elm_size);
+            const bool dbl = elm_size == sizeof(double);
+            const size_t message = dbl ? NdCopyQuantizedBytes<double>(type, format)
+                                       : NdCopyQuantizedBytes<float>(type, format);
+            out.resize(message + m * m * m * elm_size);
+            const std::string label = std::string("quant+dequant ") + format_names[f] + (dbl ? " dbl" : " flt");
+            Row(label.c_str(), [&](){
+                if(dbl){
+                    NdCopyQuantize<double>(type, reinterpret_cast<const char *>(field_dbl.data()), out.data(), format);
+                    NdCopyDequantize<double>(type, out.data(), out.data() + message, format);
+                }else{
+                    NdCopyQuantize<float>(type, reinterpret_cast<const char *>(field_flt.data()), out.data(), format);
+                    NdCopyDequantize<float>(type, out.data(), out.data() + message, format);
+                }
+            });
+        }
+    }
+    for(size_t elm_size : {sizeof(float), sizeof(double)}){
+        const NdCopyPackType type({0,0,0}, field_count, {4,4,4}, {56,56,56}, elm_size);
+        const bool dbl = elm_size == sizeof(double);
+        const char *field = dbl ? reinterpret_cast<const char *>(field_dbl.data())
+                                : reinterpret_cast<const char *>(field_flt.data());
+        const size_t message = type.GetPackedBytes();
+        out.resize(message + m * m * m * elm_size);
+        Row(dbl ? "shuffle+unshuffle dbl" : "shuffle+unshuffle flt", [&](){
+            NdCopyPackShuffled(type, field, out.data(), elm_size);
+            NdCopyUnpackShuffled(type, out.data(), out.data() + message, elm_size);
+        });
+    }
+    NdCopySimdSetLevel(selected);
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+#else
+    (void)iters;
+    std::cout<<"built without the ndcopy library, kernels compiled inline"<<std::endl;
+#endif
+}
+
+void performance_test_point_selection(int iters){
+    // scattered probe points: one NdCopy per point (a count-1 box, planned
+    // every call) against a reusable NdCopyPointSelection
+    std::cout<<"gather 100000 random points out of 128^3 doubles:"<<std::endl;
+    const size_t n = 128, num_points = 100000;
+    Dims buffer_start = {0,0,0};
+    Dims buffer_count = {n,n,n};
+    Buffer buffer, gathered(num_points*sizeof(double)), gathered2(gathered.size());
+    buffer.resize(n*n*n*sizeof(double));
+    MakeData<double>(buffer, buffer_count, false);
+    std::vector<size_t> coords(num_points*3);
+    unsigned int seed = 1;
+    for(size_t &c : coords){
+        seed = seed*1103515245u + 12345u;
+        c = (seed >> 8) % n;
+    }
+
+    auto start = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i)
+        for(size_t p=0; p<num_points; ++p){
+            // the output box of one element, in an output buffer of one element
+            Dims point = {coords[3*p], coords[3*p+1], coords[3*p+2]};
+            NdCopy<double>(buffer.data(), buffer_start, buffer_count, true, true,
+                           gathered.data() + p*sizeof(double), point, {1,1,1}, true, true);
+        }
+    auto end = std::chrono::system_clock::now();
+    auto ndcopy_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    start = std::chrono::system_clock::now();
+    NdCopyPointSelection selection(buffer_start, buffer_count, coords.data(),
+                                   num_points, sizeof(double));
+    end = std::chrono::system_clock::now();
+    auto build_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    start = std::chrono::system_clock::now();
+    for(int i=0; i<iters; ++i)
+        NdCopyGatherPoints(selection, buffer.data(), gathered2.data());
+    end = std::chrono::system_clock::now();
+    auto gather_usec = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    bool correct = gathered == gathered2;
+
+    // scatter the points back into an empty buffer and gather them again
+    Buffer scattered(buffer.size(), 0);
+    NdCopyScatterPoints(selection, gathered2.data(), scattered.data());
+    NdCopyGatherPoints(selection, scattered.data(), gathered2.data());
+    correct = correct && gathered == gathered2;
+
+    std::cout<<"NdCopy per point:        "<<ndcopy_usec<<" usec"<<std::endl;
+    std::cout<<"NdCopyPointSelection:    "<<build_usec<<" usec (built once)"<<std::endl;
+    std::cout<<"NdCopyGatherPoints:      "<<gather_usec<<" usec"<<std::endl;
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void performance_test_lazy_copy(int iters){
+    // a conditional pipeline: 8 selections are prepared, a filter keeps 2,
+    // one is read whole and one only in part. eager copies against lazy
+    // handles that copy on first access
+    std::cout<<"8 selections of 96^3 out of 192^3 floats, row-major ==> col-major, 2 read:"<<std::endl;
+    const size_t n = 192, m = 96;
+    Dims buffer_start = {0,0,0};
+    Dims buffer_count = {n,n,n};
+    Buffer buffer;
+    buffer.resize(n*n*n*sizeof(float));
+    MakeData<float>(buffer, buffer_count, false);
+    std::vector<Dims> sel_start;
+    for(size_t k=0; k<8; ++k)
+        sel_start.push_back({(k & 1)*m, ((k >> 1) & 1)*m, ((k >> 2) & 1)*m});
+    const Dims sel_count = {m,m,m};
+    const Dims part_start = {m+8, 8, 8};
+    const Dims part_count = {16,16,16};
+    bool correct = true;
+
+    long long eager_usec = 0, lazy_usec = 0;
+    size_t eager_bytes = 0, lazy_bytes = 0;
+    for(int i=0; i<iters; ++i){
+        auto start = std::chrono::system_clock::now();
+        std::vector<Buffer> eager(8);
+        for(size_t k=0; k<8; ++k){
+            eager[k].resize(m*m*m*sizeof(float));
+            NdCopy<float>(buffer.data(), buffer_start, buffer_count, true, true,
+                          eager[k].data(), sel_start[k], sel_count, false, true);
+        }
+        auto end = std::chrono::system_clock::now();
+        eager_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        eager_bytes = 8*eager[0].size();
+
+        start = std::chrono::system_clock::now();
+        std::vector<NdCopyLazy<float>> lazy;
+        for(size_t k=0; k<8; ++k)
+            lazy.emplace_back(buffer.data(), buffer_start, buffer_count, true, true,
+                              sel_start[k], sel_count, false, true);
+        // the filter keeps selections 0 and 1: 0 is read whole, 1 in part
+        lazy[0].Materialize();
+        const char *part;
+        lazy[1].Materialize(part_start, part_count, part);
+        end = std::chrono::system_clock::now();
+        lazy_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        lazy_bytes = 0;
+        for(const NdCopyLazy<float> &l : lazy)
+            lazy_bytes += l.GetCachedBytes();
+
+        correct = correct && std::memcmp(lazy[0].Data(), eager[0].data(), eager[0].size()) == 0;
+        Buffer part2(16*16*16*sizeof(float));
+        NdCopy<float>(buffer.data(), buffer_start, buffer_count, true, true,
+                      part2.data(), part_start, part_count, false, true);
+        correct = correct && std::memcmp(part, part2.data(), part2.size()) == 0;
+    }
+    std::cout<<"eager NdCopy:  "<<eager_usec<<" usec, "<<eager_bytes<<" bytes held"<<std::endl;
+    std::cout<<"NdCopyLazy:    "<<lazy_usec<<" usec, "<<lazy_bytes<<" bytes held"<<std::endl;
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void performance_test_delta_copy(int iters){
+    // output steps of a field where only a moving 32^3 region changes: the
+    // selection is copied in full every step against a delta copy that skips
+    // the unchanged blocks
+    std::cout<<"192^3 of 256^3 doubles into a staging area, 8 steps, a 32^3 region changing:"<<std::endl;
+    const size_t n = 256, m = 192;
+    Dims field_start = {0,0,0};
+    Dims field_count = {n,n,n};
+    Buffer field;
+    field.resize(n*n*n*sizeof(double));
+    MakeData<double>(field, field_count, false);
+    const Dims sel_start = {32,32,32};
+    const Dims sel_count = {m,m,m};
+    Buffer full(m*m*m*sizeof(double)), staging(m*m*m*sizeof(double));
+    NdCopyDelta<double> delta(field_start, field_count, true, true, sel_start,
+                              sel_count, true, true);
+    bool correct = true;
+
+    long long full_usec = 0, delta_usec = 0;
+    size_t dirty_bytes = 0;
+    for(int i=0; i<iters; ++i){
+        for(size_t step=0; step<8; ++step){
+            // the simulation advances: the region moves along the diagonal
+            double *data = reinterpret_cast<double *>(field.data());
+            const size_t c = 40 + 20*step;
+            for(size_t z=c; z<c+32; ++z)
+                for(size_t y=c; y<c+32; ++y)
+                    for(size_t x=c; x<c+32; ++x)
+                        data[(z*n + y)*n + x] += 1.0;
+
+            auto start = std::chrono::system_clock::now();
+            NdCopy<double>(field.data(), field_start, field_count, true, true,
+                           full.data(), sel_start, sel_count, true, true);
+            auto end = std::chrono::system_clock::now();
+            full_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+            start = std::chrono::system_clock::now();
+            delta.Copy(field.data(), staging.data());
+            end = std::chrono::system_clock::now();
+            // the first step of the first round copies everything
+            if(i > 0 || step > 0){
+                delta_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+                dirty_bytes += delta.GetDirtyBytes();
+            }
+            correct = correct && std::memcmp(full.data(), staging.data(), full.size()) == 0;
+        }
+    }
+    const size_t steps = 8*iters - 1;
+    std::cout<<"NdCopy, full:  "<<full_usec/(8*iters)<<" usec per step, "<<full.size()<<" bytes written"<<std::endl;
+    std::cout<<"NdCopyDelta:   "<<(steps ? delta_usec/steps : 0)<<" usec per step, "
+             <<(steps ? dirty_bytes/steps : 0)<<" bytes dirty"<<std::endl;
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void performance_test_quantized_copy(int iters){
+    // a sub-box of a simulation field sent to visualization in 16 bits: packed
+    // and then converted in a second pass over a temporary, against packed
+    // and converted in one pass
+    std::cout<<"160^3 of 192^3 floats to 16 bits, two passes vs fused:"<<std::endl;
+    const size_t n = 192, m = 160;
+    Dims field_start = {0,0,0};
+    Dims field_count = {n,n,n};
+    Buffer field;
+    field.resize(n*n*n*sizeof(float));
+    // a smooth field in the range of all three formats
+    float *values = reinterpret_cast<float *>(field.data());
+    for(size_t z=0; z<n; ++z)
+        for(size_t y=0; y<n; ++y)
+            for(size_t x=0; x<n; ++x)
+                values[(z*n + y)*n + x] = float(std::sin(0.05*x)*std::cos(0.03*y) + 0.01*z);
+    const NdCopyPackType type(field_start, field_count, {16,16,16}, {m,m,m},
+                              sizeof(float));
+    // the temporary of the two pass version, quantized as one contiguous box
+    const NdCopyPackType temp_type({0}, {m*m*m}, {0}, {m*m*m}, sizeof(float));
+    Buffer packed(type.GetPackedBytes()), back(field.size());
+    const char *names[] = {"fp16", "bf16", "int16"};
+    for(int f=NdCopyQuantFp16; f<=NdCopyQuantInt16; ++f){
+        const NdCopyQuantFormat format = NdCopyQuantFormat(f);
+        Buffer quantized(NdCopyQuantizedBytes<float>(type, format));
+        Buffer quantized2(quantized.size());
+        long long two_pass_usec = 0, fused_usec = 0, dequant_usec = 0;
+        for(int i=0; i<iters; ++i){
+            auto start = std::chrono::system_clock::now();
+            NdCopyPack(type, field.data(), packed.data());
+            NdCopyQuantize<float>(temp_type, packed.data(), quantized2.data(), format);
+            auto end = std::chrono::system_clock::now();
+            two_pass_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+            start = std::chrono::system_clock::now();
+            NdCopyQuantize<float>(type, field.data(), quantized.data(), format);
+            end = std::chrono::system_clock::now();
+            fused_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+            start = std::chrono::system_clock::now();
+            NdCopyDequantize<float>(type, quantized.data(), back.data(), format);
+            end = std::chrono::system_clock::now();
+            dequant_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        }
+        // largest error relative to the largest magnitude of the box, and
+        // every element within the documented bound of the format: half a
+        // step of its block for int16 (plus the float rounding of the
+        // conversions), half a unit in the last place for fp16 (2^-11
+        // relative, 2^-25 among the subnormal halfs) and bf16 (2^-8 relative)
+        NdCopyPack(type, field.data(), packed.data());
+        Buffer packed_back(packed.size());
+        NdCopyPack(type, back.data(), packed_back.data());
+        const float *a = reinterpret_cast<const float *>(packed.data());
+        const float *b = reinterpret_cast<const float *>(packed_back.data());
+        const float *params = reinterpret_cast<const float *>(quantized.data() + 2*m*m*m);
+        double max_err = 0, max_abs = 0;
+        bool within = true;
+        for(size_t k=0; k<m*m*m; ++k){
+            const double err = std::fabs(double(a[k]) - double(b[k]));
+            double bound;
+            if(format == NdCopyQuantInt16){
+                const float *param = params + 2 * (k / NdCopyQuantBlockElms);
+                bound = 0.5 * param[1] + 2 * std::numeric_limits<float>::epsilon() *
+                                             (std::fabs(param[0]) + std::fabs(a[k]));
+            }else if(format == NdCopyQuantFp16){
+                bound = std::max(std::ldexp(std::fabs(double(a[k])), -11), std::ldexp(1.0, -25));
+            }else{
+                bound = std::ldexp(std::fabs(double(a[k])), -8);
+            }
+            within = within && err <= bound;
+            max_err = std::max(max_err, err);
+            max_abs = std::max(max_abs, std::fabs(double(a[k])));
+        }
+        const bool same = std::memcmp(quantized.data(), quantized2.data(), quantized.size()) == 0;
+        std::cout<<names[f]<<": pack + quantize "<<two_pass_usec<<" usec, fused "
+                 <<fused_usec<<" usec, dequantize "<<dequant_usec<<" usec, "
+                 <<quantized.size()<<" of "<<packed.size()<<" bytes, max error "
+                 <<max_err/max_abs<<(same ? ", same message" : ", messages differ!")<<std::endl;
+        std::cout<<names[f]<<": "<<(within && same ? "data correct" : "Data not correct!")<<std::endl;
+    }
+    // nearly constant blocks: an int16 step that is subnormal (no finite
+    // inverse) or zero. the values have to come back finite and within a
+    // step, plus what rounding a subnormal step costs over 65535 steps
+    const float near_constant[][3] = {{0, 1e-38f, 5e-39f}, {1, 1, 1}, {-2e-39f, 0, 3e-39f}};
+    const NdCopyPackType block_type({0}, {3}, {0}, {3}, sizeof(float));
+    Buffer block_quantized(NdCopyQuantizedBytes<float>(block_type, NdCopyQuantInt16));
+    bool correct = true;
+    for(const auto &block : near_constant){
+        float block_back[3];
+        NdCopyQuantize<float>(block_type, reinterpret_cast<const char *>(block),
+                              block_quantized.data(), NdCopyQuantInt16);
+        NdCopyDequantize<float>(block_type, block_quantized.data(),
+                                reinterpret_cast<char *>(block_back), NdCopyQuantInt16);
+        const float step = (*std::max_element(block, block + 3) - *std::min_element(block, block + 3)) / 65535;
+        for(size_t k=0; k<3; ++k)
+            correct = correct && std::isfinite(block_back[k]) &&
+                      std::fabs(block_back[k] - block[k]) <= step + 32768 * std::numeric_limits<float>::denorm_min();
+    }
+    std::cout<<"nearly constant int16 blocks: "<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void performance_test_shuffled_copy(int iters){
+    // a sub-box of a simulation field byte shuffled for a compressor: packed
+    // and then shuffled in a second pass over a temporary, against packed and
+    // shuffled in one pass
+    std::cout<<"160^3 of 192^3 doubles, byte shuffled, two passes vs fused:"<<std::endl;
+    const size_t n = 192, m = 160;
+    Dims field_start = {0,0,0};
+    Dims field_count = {n,n,n};
+    Buffer field;
+    field.resize(n*n*n*sizeof(double));
+    double *values = reinterpret_cast<double *>(field.data());
+    for(size_t z=0; z<n; ++z)
+        for(size_t y=0; y<n; ++y)
+            for(size_t x=0; x<n; ++x)
+                values[(z*n + y)*n + x] = std::sin(0.05*x)*std::cos(0.03*y) + 0.01*z;
+    const NdCopyPackType type(field_start, field_count, {16,16,16}, {m,m,m},
+                              sizeof(double));
+    const NdCopyPackType temp_type({0}, {m*m*m}, {0}, {m*m*m}, sizeof(double));
+    Buffer packed(type.GetPackedBytes()), shuffled(packed.size()),
+        shuffled2(packed.size()), back(field.size());
+    long long two_pass_usec = 0, fused_usec = 0, unpack_usec = 0;
+    for(int i=0; i<iters; ++i){
+        auto start = std::chrono::system_clock::now();
+        NdCopyPack(type, field.data(), packed.data());
+        NdCopyPackShuffled(temp_type, packed.data(), shuffled2.data(), sizeof(double));
+        auto end = std::chrono::system_clock::now();
+        two_pass_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        start = std::chrono::system_clock::now();
+        NdCopyPackShuffled(type, field.data(), shuffled.data(), sizeof(double));
+        end = std::chrono::system_clock::now();
+        fused_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        start = std::chrono::system_clock::now();
+        NdCopyUnpackShuffled(type, shuffled.data(), back.data(), sizeof(double));
+        end = std::chrono::system_clock::now();
+        unpack_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    }
+    Buffer packed_back(packed.size());
+    NdCopyPack(type, back.data(), packed_back.data());
+    const bool correct = std::memcmp(shuffled.data(), shuffled2.data(), shuffled.size()) == 0 &&
+                         std::memcmp(packed.data(), packed_back.data(), packed.size()) == 0;
+    std::cout<<"pack + shuffle:       "<<two_pass_usec<<" usec"<<std::endl;
+    std::cout<<"NdCopyPackShuffled:   "<<fused_usec<<" usec"<<std::endl;
+    std::cout<<"NdCopyUnpackShuffled: "<<unpack_usec<<" usec"<<std::endl;
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
+void performance_test_tiled_copy(int iters){
+    // a sub-box of a row-major field into Morton and brick layouts: copied
+    // out into a row-major temporary and converted from there, against
+    // converted in one pass; and back to row-major
+    std::cout<<"160^3 of 192^3 doubles, row-major to Morton / 8^3 bricks, two passes vs one:"<<std::endl;
+    const size_t n = 192, m = 160;
+    Dims field_start = {0,0,0};
+    Dims field_count = {n,n,n};
+    Dims box_start = {16,16,16};
+    Dims box_count = {m,m,m};
+    Buffer field;
+    field.resize(n*n*n*sizeof(double));
+    MakeData<double>(field, field_count, false);
+    const NdCopyTiledLayout row_major = NdCopyDenseLayout();
+    const NdCopyTiledLayout layouts[] = {NdCopyMortonLayout(),
+                                         NdCopyBrickLayout({8,8,8})};
+    const char *names[] = {"Morton", "bricks"};
+    Buffer temp(m*m*m*sizeof(double)), back(temp.size());
+    for(int l=0; l<2; ++l){
+        Buffer tiled(NdCopyTiledBytes(box_count, layouts[l], sizeof(double))),
+            tiled2(tiled.size());
+        long long two_pass_usec = 0, one_pass_usec = 0, back_usec = 0;
+        for(int i=0; i<iters; ++i){
+            auto start = std::chrono::system_clock::now();
+            NdCopy<double>(field.data(), field_start, field_count, true, true,
+                           temp.data(), box_start, box_count, true, true);
+            NdCopyTiled<double>(temp.data(), box_start, box_count, row_major, true,
+                                tiled2.data(), box_start, box_count, layouts[l], true);
+            auto end = std::chrono::system_clock::now();
+            two_pass_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+            start = std::chrono::system_clock::now();
+            NdCopyTiled<double>(field.data(), field_start, field_count, row_major, true,
+                                tiled.data(), box_start, box_count, layouts[l], true);
+            end = std::chrono::system_clock::now();
+            one_pass_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+            start = std::chrono::system_clock::now();
+            NdCopyTiled<double>(tiled.data(), box_start, box_count, layouts[l], true,
+                                back.data(), box_start, box_count, row_major, true);
+            end = std::chrono::system_clock::now();
+            back_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        }
+        const bool correct = std::memcmp(tiled.data(), tiled2.data(), tiled.size()) == 0 &&
+                             std::memcmp(temp.data(), back.data(), temp.size()) == 0;
+        std::cout<<names[l]<<":"<<std::endl;
+        std::cout<<"  NdCopy + convert:         "<<two_pass_usec<<" usec"<<std::endl;
+        std::cout<<"  NdCopyTiled:              "<<one_pass_usec<<" usec"<<std::endl;
+        std::cout<<"  NdCopyTiled to row-major: "<<back_usec<<" usec"<<std::endl;
+        std::cout<<"  "<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+    }
+}
+
+void performance_test_halo_exchange(int iters){
+    // the 26 face, edge and corner messages of a 3D block with 2 ghost
+    // layers: one NdCopy() per region out of the ghosted memory box, against
+    // a reusable halo plan. unpacked as a periodic exchange with itself, so
+    // the ghost cells have to end up holding the opposite interior layers.
+    std::cout<<"128^3 doubles, 2 ghost layers, 26 neighbours, per-region NdCopy vs halo plan:"<<std::endl;
+    const size_t n = 128, g = 2, b = n + 2*g;
+    Dims count = {n,n,n};
+    Dims ghost = {g,g,g};
+    Dims mem_start = {0,0,0};
+    Dims mem_count = {b,b,b};
+    Buffer field;
+    field.resize(b*b*b*sizeof(double));
+    MakeData<double>(field, mem_count, false);
+    const std::vector<NdCopyHaloDir> neighbors = NdCopyHaloNeighbors(3, 3);
+    const NdCopyHaloPlan plan(count, ghost, neighbors, sizeof(double));
+    Buffer send(plan.GetTotalBytes()), send2(send.size()), recv(send.size());
+    long long ndcopy_usec = 0, pack_usec = 0, unpack_usec = 0;
+    for(int i=0; i<iters; ++i){
+        auto start = std::chrono::system_clock::now();
+        for(size_t k=0; k<neighbors.size(); ++k){
+            Dims region_start(3), region_count(3);
+            for(size_t d=0; d<3; ++d){
+                region_count[d] = neighbors[k][d] == 0 ? n : g;
+                region_start[d] = neighbors[k][d] > 0 ? n : g;
+            }
+            NdCopy<double>(field.data(), region_start, region_count, true, true,
+                           send2.data() + plan.GetOffset(k), region_start, region_count,
+                           true, true, mem_start, mem_count);
+        }
+        auto end = std::chrono::system_clock::now();
+        ndcopy_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        start = std::chrono::system_clock::now();
+        NdCopyHaloPack(plan, field.data(), send.data());
+        end = std::chrono::system_clock::now();
+        pack_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        // the message to direction k arrives from the opposite direction
+        for(size_t k=0; k<neighbors.size(); ++k)
+            std::memcpy(recv.data() + plan.GetOffset(neighbors.size() - 1 - k),
+                        send.data() + plan.GetOffset(k), plan.GetBytes(k));
+        start = std::chrono::system_clock::now();
+        NdCopyHaloUnpack(plan, recv.data(), field.data());
+        end = std::chrono::system_clock::now();
+        unpack_usec += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    }
+    bool correct = std::memcmp(send.data(), send2.data(), send.size()) == 0;
+    const double *values = reinterpret_cast<const double *>(field.data());
+    for(size_t z=0; z<b && correct; ++z)
+        for(size_t y=0; y<b; ++y)
+            for(size_t x=0; x<b; ++x){
+                const size_t wz = z < g ? z + n : z >= g + n ? z - n : z;
+                const size_t wy = y < g ? y + n : y >= g + n ? y - n : y;
+                const size_t wx = x < g ? x + n : x >= g + n ? x - n : x;
+                if(values[(z*b + y)*b + x] != values[(wz*b + wy)*b + wx])
+                    correct = false;
+            }
+    std::cout<<"26 x NdCopy:       "<<ndcopy_usec<<" usec"<<std::endl;
+    std::cout<<"NdCopyHaloPack:    "<<pack_usec<<" usec"<<std::endl;
+    std::cout<<"NdCopyHaloUnpack:  "<<unpack_usec<<" usec"<<std::endl;
+    std::cout<<(correct ? "data correct" : "Data not correct!")<<std::endl;
+}
+
 int main(int argc, const char * argv[]) {
+    // benchmark only: src --bench <results file> [iters]
+    // regression gate: src --compare <baseline file> <results file> [threshold %]
+    if(argc > 1 && std::string(argv[1]) == "--bench"){
+        if(argc < 3){
+            std::cout<<"usage: "<<argv[0]<<" --bench <results file> [iters]"<<std::endl;
+            return 2;
+        }
+        const int bench_iters = argc > 3 ? atoi(argv[3]) : 10;
+        if(bench_iters < 1){
+            std::cout<<"iters has to be at least 1"<<std::endl;
+            return 2;
+        }
+        performance_roofline(bench_iters, argv[2]);
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--compare"){
+        if(argc < 4){
+            std::cout<<"usage: "<<argv[0]<<" --compare <baseline file> <results file> [threshold %]"<<std::endl;
+            return 2;
+        }
+        return CompareBenchResults(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 10.0) == 0 ? 0 : 1;
+    }
     int iters = 1;
     if(argc > 1){
         iters = atoi(argv[1]);
@@ -372,6 +1793,15 @@ int main(int argc, const char * argv[]) {
   std::cout<<std::endl<<"demo 2:"<<std::endl;
   performance_test_max_cont_block_optimization(iters);
 
+  std::cout<<std::endl<<"demo 2b:"<<std::endl;
+  performance_test_block_copy_alignment(iters);
+
+  std::cout<<std::endl<<"demo 2c:"<<std::endl;
+  demo_small_block_copy();
+
+  std::cout<<std::endl<<"demo 2d:"<<std::endl;
+  performance_test_huge_buffer(iters);
+
   std::cout<<std::endl<<"demo 3:"<<std::endl;
   // copy from row-maj to col-maj, same endianess demo
 //  demo_reversed_major_copy();
@@ -380,6 +1810,10 @@ int main(int argc, const char * argv[]) {
     std::cout<<std::endl<<"demo 4:"<<std::endl;
     // copy from col-maj to row-maj, same endianess demo
     demo_reversed_major_copy_col2row();
+
+  std::cout<<std::endl<<"demo 4b:"<<std::endl;
+  // copy between row-maj and col-maj, overlap offsets differing per dim
+  demo_reversed_major_copy_ovlp_offsets();
   
   std::cout<<std::endl<<"demo 5:"<<std::endl;
   // DEMO input of any major to output of any major,with same endianess
@@ -388,6 +1822,76 @@ int main(int argc, const char * argv[]) {
   std::cout<<std::endl<<"demo 6:"<<std::endl;
   // DEMO copy between reversed endians
   demo_copy_between_reversed_endians();
+
+  std::cout<<std::endl<<"demo 6b:"<<std::endl;
+  // DEMO per field swapping of structured elements
+  demo_copy_structured_elements_between_endians();
+
+  std::cout<<std::endl<<"demo 7:"<<std::endl;
+  // DEMO copy between arbitrary axis permutations
+  demo_axis_permutation_copy(iters);
+
+  std::cout<<std::endl<<"demo 8:"<<std::endl;
+  // DEMO copy out of a strided view
+  demo_strided_view_copy();
+
+  std::cout<<std::endl<<"demo 9:"<<std::endl;
+  // DEMO statistics computed during the copy
+  demo_copy_with_fused_stats();
+
+  std::cout<<std::endl<<"demo 10:"<<std::endl;
+  demo_copy_with_checksum();
+
+  std::cout<<std::endl<<"demo 11:"<<std::endl;
+  demo_copy_with_fill();
+
+  std::cout<<std::endl<<"demo 12:"<<std::endl;
+  demo_stream_copy_from_file();
+
+  std::cout<<std::endl<<"demo 13:"<<std::endl;
+  performance_test_shm_ring_transport(iters);
+
+  std::cout<<std::endl<<"demo 14:"<<std::endl;
+  demo_wire_message();
+
+  std::cout<<std::endl<<"demo 15:"<<std::endl;
+  performance_test_pack_unpack(iters);
+
+  std::cout<<std::endl<<"demo 16:"<<std::endl;
+  performance_test_plan_cache(iters);
+
+  std::cout<<std::endl<<"demo 17:"<<std::endl;
+  demo_autotune_profile();
+
+  std::cout<<std::endl<<"demo 18:"<<std::endl;
+  performance_counters_per_kernel(iters);
+
+  std::cout<<std::endl<<"demo 19:"<<std::endl;
+  performance_roofline(iters, "");
+
+  std::cout<<std::endl<<"demo 20:"<<std::endl;
+  performance_simd_levels(iters);
+
+  std::cout<<std::endl<<"demo 21:"<<std::endl;
+  performance_test_point_selection(iters);
+
+  std::cout<<std::endl<<"demo 22:"<<std::endl;
+  performance_test_lazy_copy(iters);
+
+  std::cout<<std::endl<<"demo 23:"<<std::endl;
+  performance_test_delta_copy(iters);
+
+  std::cout<<std::endl<<"demo 24:"<<std::endl;
+  performance_test_quantized_copy(iters);
+
+  std::cout<<std::endl<<"demo 25:"<<std::endl;
+  performance_test_shuffled_copy(iters);
+
+  std::cout<<std::endl<<"demo 26:"<<std::endl;
+  performance_test_tiled_copy(iters);
+
+  std::cout<<std::endl<<"demo 27:"<<std::endl;
+  performance_test_halo_exchange(iters);
   
   
   
@@ -0,0 +1,182 @@
+//
+//  perf_counters.h
+//  src
+//
+
+#ifndef DATACOPY_PERF_COUNTERS_H
+#define DATACOPY_PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// PerfCounters
+// hardware counters around a region of the benchmark, read through
+// perf_event_open(): cycles, instructions, L1d and LLC read misses, dTLB
+// read misses and branch misses. every counter is opened on its own, so
+// one the cpu or the container does not provide only drops that column;
+// when none can be opened (no permission, no PMU in a VM or container, not
+// Linux) Available() is false and the benchmark keeps its wall times only.
+// counts are for the calling thread, user space only, scaled up when the
+// kernel had to multiplex the counters.
+class PerfCounters
+{
+public:
+    enum Event { Cycles, Instructions, L1dMisses, LlcMisses, DtlbMisses,
+                 BranchMisses, NumEvents };
+
+    PerfCounters()
+    {
+        for(int e = 0; e < NumEvents; ++e){
+            m_Fd[e] = Open(static_cast<Event>(e));
+            m_Value[e] = -1;
+        }
+    }
+    ~PerfCounters()
+    {
+#if defined(__linux__)
+        for(int e = 0; e < NumEvents; ++e)
+            if(m_Fd[e] >= 0)
+                close(m_Fd[e]);
+#endif
+    }
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool Available() const
+    {
+        for(int e = 0; e < NumEvents; ++e)
+            if(m_Fd[e] >= 0)
+                return true;
+        return false;
+    }
+    // why the first counter that failed could not be opened
+    const std::string &Error() const { return m_Error; }
+
+    void Start()
+    {
+#if defined(__linux__)
+        for(int e = 0; e < NumEvents; ++e)
+            if(m_Fd[e] >= 0){
+                ioctl(m_Fd[e], PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_Fd[e], PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+    void Stop()
+    {
+#if defined(__linux__)
+        for(int e = 0; e < NumEvents; ++e){
+            m_Value[e] = -1;
+            if(m_Fd[e] < 0)
+                continue;
+            ioctl(m_Fd[e], PERF_EVENT_IOC_DISABLE, 0);
+            // value, time enabled, time running
+            uint64_t data[3];
+            if(read(m_Fd[e], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+                continue;
+            m_Value[e] = static_cast<long long>(
+                static_cast<double>(data[0]) * data[1] / data[2]);
+        }
+#endif
+    }
+    // count of the last Start()/Stop(), -1 if the event is unavailable
+    long long Get(Event e) const { return m_Value[e]; }
+
+    static const char *Name(Event e)
+    {
+        static const char *names[NumEvents] = {"cycles", "instr", "L1d-miss",
+                                               "LLC-miss", "dTLB-miss",
+                                               "br-miss"};
+        return names[e];
+    }
+
+private:
+    int Open(Event e)
+    {
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        const uint64_t readMiss =
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch(e){
+        case Cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case Instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case L1dMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | readMiss;
+            break;
+        case LlcMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | readMiss;
+            break;
+        case DtlbMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | readMiss;
+            break;
+        default:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        }
+        const long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if(fd < 0 && m_Error.empty())
+            m_Error = std::string("perf_event_open: ") + std::strerror(errno);
+        return static_cast<int>(fd);
+#else
+        (void)e;
+        m_Error = "perf_event_open() needs Linux";
+        return -1;
+#endif
+    }
+
+    int m_Fd[NumEvents];
+    long long m_Value[NumEvents];
+    std::string m_Error;
+};
+
+// PrintPerfCounters()
+// one report line: label, wall time and the counters of the last region,
+// "n/a" for the unavailable ones
+inline void PrintPerfCounters(const std::string &label, long long usec,
+                              const PerfCounters &counters)
+{
+    std::printf("%-34s %9lld usec", label.c_str(), usec);
+    for(int e = 0; e < PerfCounters::NumEvents; ++e){
+        const long long v = counters.Get(static_cast<PerfCounters::Event>(e));
+        if(v < 0)
+            std::printf(" %12s", "n/a");
+        else
+            std::printf(" %12lld", v);
+    }
+    const long long cycles = counters.Get(PerfCounters::Cycles);
+    const long long instr = counters.Get(PerfCounters::Instructions);
+    if(cycles > 0 && instr >= 0)
+        std::printf("  IPC %.2f", static_cast<double>(instr) / cycles);
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+#endif //DATACOPY_PERF_COUNTERS_H
@@ -0,0 +1,173 @@
+//
+//  roofline.h
+//  src
+//
+
+#ifndef DATACOPY_ROOFLINE_H
+#define DATACOPY_ROOFLINE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// BenchResult
+// one benchmarked configuration. bytes is what the copy has to move at
+// least: the overlap read once and written once, per iteration.
+struct BenchResult
+{
+    std::string label;
+    double usecPerIter;
+    double bytes;
+
+    double GBPerSec() const { return bytes / usecPerIter * 1e-3; }
+};
+
+// StreamCopyBandwidth()
+// STREAM-style calibration: the best of reps runs of a[i] = b[i] over two
+// arrays of the given size each, in GB/s counting the read and the write
+// (16 bytes per double, as STREAM does). the arrays have to be well beyond
+// the last level cache. this is the memory roof the copies are measured
+// against; copies whose data stays in cache can go above it.
+inline double StreamCopyBandwidth(size_t bytes = size_t(256) << 20, int reps = 5)
+{
+    const size_t n = bytes / sizeof(double);
+    std::vector<double> a(n, 0.0), b(n, 1.0);
+    double best = 0;
+    for(int r = 0; r < reps; ++r){
+        auto start = std::chrono::steady_clock::now();
+        double *pa = a.data();
+        const double *pb = b.data();
+        for(size_t i = 0; i < n; ++i)
+            pa[i] = pb[i];
+        auto end = std::chrono::steady_clock::now();
+        const double sec = std::chrono::duration<double>(end - start).count();
+        best = std::max(best, 2.0 * n * sizeof(double) / sec * 1e-9);
+        // keep the copy from being optimized away
+        if(a[r % n] != 1.0)
+            return 0;
+    }
+    return best;
+}
+
+// BenchRuns
+// timed runs per configuration; the results file records their median, so
+// that one run disturbed by the rest of the machine does not trip the gate
+const int BenchRuns = 5;
+
+// MedianOf()
+inline double MedianOf(std::vector<double> samples)
+{
+    if(samples.empty())
+        return 0;
+    const size_t mid = samples.size() / 2;
+    std::nth_element(samples.begin(), samples.begin() + mid, samples.end());
+    if(samples.size() % 2 == 1)
+        return samples[mid];
+    const double upper = samples[mid];
+    return (upper + *std::max_element(samples.begin(), samples.begin() + mid)) / 2;
+}
+
+// PrintRoofline()
+// one report line per configuration: time, bandwidth and fraction of peak
+inline void PrintRoofline(const BenchResult &r, double peakGBPerSec)
+{
+    std::printf("%-34s %10.1f usec %8.2f GB/s %6.1f%% of peak\n",
+                r.label.c_str(), r.usecPerIter, r.GBPerSec(),
+                100.0 * r.GBPerSec() / peakGBPerSec);
+}
+
+// WriteBenchResults()
+// results file: a "peak <GB/s>" line, then one tab separated line per
+// configuration: label, usec per iteration, bytes
+inline bool WriteBenchResults(const std::string &path,
+                              const std::vector<BenchResult> &results,
+                              double peakGBPerSec)
+{
+    std::ofstream file(path);
+    if(!file)
+        return false;
+    file << "peak\t" << peakGBPerSec << "\n";
+    for(const BenchResult &r : results)
+        file << r.label << "\t" << r.usecPerIter << "\t" << r.bytes << "\n";
+    return static_cast<bool>(file);
+}
+
+inline bool ReadBenchResults(const std::string &path,
+                             std::vector<BenchResult> &results,
+                             double &peakGBPerSec)
+{
+    std::ifstream file(path);
+    if(!file)
+        return false;
+    results.clear();
+    peakGBPerSec = 0;
+    std::string line;
+    while(std::getline(file, line)){
+        if(line.empty())
+            continue;
+        std::istringstream fields(line);
+        BenchResult r;
+        std::getline(fields, r.label, '\t');
+        if(r.label == "peak"){
+            fields >> peakGBPerSec;
+            continue;
+        }
+        if(!(fields >> r.usecPerIter >> r.bytes) || r.usecPerIter <= 0)
+            return false;
+        results.push_back(r);
+    }
+    return true;
+}
+
+// CompareBenchResults()
+// the regression gate: diffs a new results file against a baseline one and
+// reports every configuration. a configuration regresses when its time
+// per iteration, the median of BenchRuns runs, grew by more than
+// thresholdPercent. both files should come
+// from the same machine; their peaks are printed to check that. returns 0
+// if nothing regressed, 1 if something did (or a baseline configuration is
+// missing), -1 if a file cannot be read.
+inline int CompareBenchResults(const std::string &basePath,
+                               const std::string &newPath,
+                               double thresholdPercent)
+{
+    std::vector<BenchResult> base, current;
+    double basePeak, newPeak;
+    if(!ReadBenchResults(basePath, base, basePeak) ||
+       !ReadBenchResults(newPath, current, newPeak)){
+        std::cout << "cannot read " << basePath << " or " << newPath << std::endl;
+        return -1;
+    }
+    std::printf("STREAM copy peak: %.2f -> %.2f GB/s\n", basePeak, newPeak);
+    std::map<std::string, const BenchResult *> byLabel;
+    for(const BenchResult &r : current)
+        byLabel[r.label] = &r;
+    int res = 0;
+    for(const BenchResult &b : base){
+        auto it = byLabel.find(b.label);
+        if(it == byLabel.end()){
+            std::printf("%-34s missing\n", b.label.c_str());
+            res = 1;
+            continue;
+        }
+        const double change =
+            100.0 * (it->second->usecPerIter / b.usecPerIter - 1.0);
+        const bool regressed = change > thresholdPercent;
+        std::printf("%-34s %10.1f -> %10.1f usec %+7.1f%%%s\n",
+                    b.label.c_str(), b.usecPerIter, it->second->usecPerIter,
+                    change, regressed ? "  REGRESSION" : "");
+        if(regressed)
+            res = 1;
+    }
+    std::cout << (res ? "regressions beyond " : "no regressions beyond ")
+              << thresholdPercent << "%" << std::endl;
+    return res;
+}
+
+#endif //DATACOPY_ROOFLINE_H